@@ -1,5 +1,15 @@
 #include "doubao_api.h"
+#include "doubao_client.h"
+#include "doubao_endpoints.h"
+#include "doubao_http.h"
+#include "doubao_json_path.h"
+#include "doubao_keys.h"
+#include "doubao_roi.h"
+#include "doubao_tls.h"
+#include "doubao_trace.h"
 #include "k10_base64.h"
+#include <atomic>
+#include <img_converters.h>
 
 // Error codes
 const String ERROR_NETWORK = "<network_error>";
@@ -8,16 +18,83 @@ const String ERROR_IMAGE_TOO_LARGE = "<image_too_large>";
 const String ERROR_INVALID_INPUT = "<invalid_input>";
 const String ERROR_JSON_PARSE = "<json_parse_error>";
 const String ERROR_TIMEOUT = "<timeout_error>";
+const String ERROR_SPOOLED = "<spooled>";
+const String ERROR_OVERLOADED = "<overloaded>";
+const String ERROR_SCHEMA = "<schema_violation>";
+const String ERROR_TOOL_ROUNDS = "<tool_rounds_exceeded>";
 
-// Global answer variable
-String answer;
+// Endpoint pool used by sendApiRequest(), nullptr for the default host; each
+// request reads it once, so swapping pools does not affect requests in flight
+static std::atomic<DoubaoEndpointPool*> activeEndpoints(nullptr);
 
-bool validateConfig(const char* apiKey, String modelId, float temp) {
-  if (apiKey == nullptr || strlen(apiKey) == 0) {
+void setEndpointPool(DoubaoEndpointPool* pool) {
+  activeEndpoints = pool;
+}
+
+// Key pool used when no API key is passed, nullptr if not installed
+static std::atomic<DoubaoKeyPool*> activeKeys(nullptr);
+
+void setKeyPool(DoubaoKeyPool* pool) {
+  activeKeys = pool;
+}
+
+// Trace recorder fed by sendApiRequest(), nullptr when not recording
+static std::atomic<DoubaoTraceRecorder*> activeRecorder(nullptr);
+
+void setTraceRecorder(DoubaoTraceRecorder* recorder) {
+  activeRecorder = recorder;
+}
+
+bool hasApiKey(const char* apiKey) {
+  DoubaoKeyPool* keys = activeKeys;
+  return (apiKey != nullptr && strlen(apiKey) > 0) || (keys != nullptr && keys->size() > 0);
+}
+
+bool isErrorResponse(const String& response) {
+  return response == ERROR_NETWORK || response == ERROR_CAMERA || response == ERROR_IMAGE_TOO_LARGE ||
+         response == ERROR_INVALID_INPUT || response == ERROR_JSON_PARSE || response == ERROR_TIMEOUT ||
+         response == ERROR_SPOOLED || response == ERROR_OVERLOADED || response == ERROR_SCHEMA ||
+         response == ERROR_TOOL_ROUNDS;
+}
+
+String jsonEscape(const String& text) {
+  String escaped;
+  escaped.reserve(text.length() + 16);
+  for (unsigned int i = 0; i < text.length(); i++) {
+    char c = text[i];
+    switch (c) {
+      case '"': escaped += "\\\""; break;
+      case '\\': escaped += "\\\\"; break;
+      case '\n': escaped += "\\n"; break;
+      case '\r': escaped += "\\r"; break;
+      case '\t': escaped += "\\t"; break;
+      default:
+        if ((uint8_t)c < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          escaped += buf;
+        } else {
+          escaped += c;
+        }
+    }
+  }
+  return escaped;
+}
+
+void generateTraceId(char* out) {
+  snprintf(out, DOUBAO_TRACE_ID_LENGTH + 1, "%08lx%08lx", (unsigned long)esp_random(), (unsigned long)esp_random());
+}
+
+bool validateConfig(const char* apiKey, DoubaoStringView modelId, float temp) {
+  if (!hasApiKey(apiKey)) {
     Serial.println("Error: API key not set");
     return false;
   }
-  if (modelId.length() == 0) {
+  return validateSettings(modelId, temp);
+}
+
+bool validateSettings(DoubaoStringView modelId, float temp) {
+  if (modelId.empty()) {
     Serial.println("Error: Model ID not set");
     return false;
   }
@@ -28,87 +105,187 @@ bool validateConfig(const char* apiKey, String modelId, float temp) {
   return true;
 }
 
-String sendHttpRequest(String payload, const char* apiKey) {
-  WiFiClientSecure client;
-  String outputText = ERROR_NETWORK;
-  client.setInsecure();
-  if (!client.connect("ark.cn-beijing.volces.com", 443)) {
-    Serial.println("Failed to connect to server");
-    return ERROR_NETWORK;
-  }
-  String request = "POST /api/v3/chat/completions HTTP/1.1\r\n";
-  request += "Host: ark.cn-beijing.volces.com\r\n";
-  request += "Content-Type: application/json\r\n";
-  request += "Authorization: Bearer " + String(apiKey) + "\r\n";
-  request += "Transfer-Encoding: chunked\r\n";
-  request += "Connection: close\r\n";
-  request += "\r\n";
-  client.print(request);
+// Templated on the connection type so reads can wait on its socket (see doubao_socket.h)
+template <class ClientT>
+static bool writeRequest(ClientT& client, const char* host, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta) {
+  generateTraceId(meta->traceId);
+  // Rendered in one pass and sent in one write
+  char head[512];
+  int length = snprintf(head, sizeof(head),
+                        "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\nAuthorization: Bearer %s\r\n"
+                        "Transfer-Encoding: chunked\r\nConnection: %s\r\nX-Client-Request-Id: %s\r\n\r\n",
+                        path.c_str(), host, apiKey, keepAlive ? "keep-alive" : "close", meta->traceId);
+  if (length <= 0 || length >= (int)sizeof(head)) {
+    Serial.println("Error: Request headers too long");
+    return false;
+  }
+  client.write((const uint8_t*)head, length);
   int chunkSize = 4096;
-  int totalLength = payload.length();
+  int totalLength = payload.length;
   int sent = 0;
   while (sent < totalLength) {
     int currentChunkSize = min(chunkSize, totalLength - sent);
-    String chunk = payload.substring(sent, sent + currentChunkSize);
     String chunkHeader = String(currentChunkSize, HEX) + "\r\n";
     client.print(chunkHeader);
-    client.print(chunk);
+    client.write((const uint8_t*)payload.data + sent, currentChunkSize);
     client.print("\r\n");
     sent += currentChunkSize;
-    delay(5);
   }
   client.print("0\r\n\r\n");
-  String response = "";
-  unsigned long timeout = millis() + 300000;
-  while (client.connected() && millis() < timeout) {
-    if (client.available()) {
-      response += client.readString();
+  return true;
+}
+
+template <class ClientT>
+static String sendOnce(ClientT& client, const char* host, uint16_t port, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta) {
+  meta->heapFreeBefore = ESP.getFreeHeap();
+  meta->heapMinFree = meta->heapFreeBefore;
+  meta->status = 0;
+  bool reused = client.connected();
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (!client.connected()) {
+      if (!client.connect(host, port)) {
+        Serial.printf("Failed to connect to %s\n", host);
+        return ERROR_NETWORK;
+      }
     }
-    delay(10);
-  }
-  client.stop();
-  if (response.length() > 0) {
-    int jsonStart = response.indexOf("\r\n\r\n");
-    if (jsonStart > 0) {
-      response = response.substring(jsonStart + 4);
+    doubaoSampleHeap(meta);
+    unsigned long start = DoubaoClock::now();
+    if (!writeRequest(client, host, path, payload, apiKey, keepAlive, meta)) {
+      client.stop();
+      return ERROR_INVALID_INPUT;
     }
-    DynamicJsonDocument jsonDoc(32768);
-    DeserializationError error = deserializeJson(jsonDoc, response);
-    if (!error) {
-      outputText = jsonDoc["choices"][0]["message"]["content"].as<String>();
-      Serial.println("JSON Parse Successful");
-    } else {
-      Serial.print("JSON Parse Error: ");
-      Serial.println(error.c_str());
-      outputText = ERROR_JSON_PARSE;
+    doubaoSampleHeap(meta);
+    bool serverKeepAlive = false;
+    String response = doubaoReadResponse(client, start, DOUBAO_RESPONSE_TIMEOUT_MS, &serverKeepAlive, meta);
+    meta->latencyMs = DoubaoClock::now() - start;
+    doubaoSampleHeap(meta);
+    if (!keepAlive || !serverKeepAlive || isErrorResponse(response)) {
+      client.stop();
     }
-  } else {
-    Serial.println("No response received");
-    outputText = ERROR_TIMEOUT;
+    // A kept-alive connection may have been closed by the server while idle; retry once on a
+    // fresh one, unless a response had started (the request reached the server)
+    if (response == ERROR_NETWORK && reused && attempt == 0 && meta->status == 0) {
+      Serial.println("Reused connection was closed, reconnecting");
+      reused = false;
+      continue;
+    }
+    return response;
   }
-  return outputText;
+  return ERROR_NETWORK;
 }
 
-String sendHttpRequestWithRetry(String payload, const char* apiKey, int maxRetries) {
-  String result;
-  for (int i = 0; i < maxRetries; i++) {
-    Serial.printf("Requesting %d/%d\n", i + 1, maxRetries);
-    result = sendHttpRequest(payload, apiKey);
-    if (result != ERROR_NETWORK && result != ERROR_TIMEOUT) {
-      return result;
+template <class ClientT>
+static String sendVia(ClientT& client, const char* host, uint16_t port, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta) {
+  DoubaoResponseMeta localMeta;
+  if (meta == nullptr) {
+    meta = &localMeta;
+  }
+  DoubaoKeyPool* keys = activeKeys;
+  if (apiKey != nullptr && strlen(apiKey) > 0) {
+    return sendOnce(client, host, port, path, payload, apiKey, keepAlive, meta);
+  }
+  if (keys == nullptr) {
+    Serial.println("Error: API key not set");
+    return ERROR_INVALID_INPUT;
+  }
+  // No key given: draw one from the pool, moving to another key when throttled
+  String response = ERROR_INVALID_INPUT;
+  for (int attempt = 0; attempt < keys->size(); attempt++) {
+    int index = keys->acquire();
+    if (index < 0) {
+      Serial.println("Error: All API keys are throttled");
+      return ERROR_OVERLOADED;
     }
-    if (i < maxRetries - 1) {
-      int delayTime = 1000 * (i + 1);
-      Serial.printf("Request failed, retrying after %d ms\n", delayTime);
-      delay(delayTime);
+    response = sendOnce(client, host, port, path, payload, keys->key(index), keepAlive, meta);
+    keys->record(index, response, *meta);
+    if (meta->status != 429) {
+      break;
     }
   }
-  return result;
+  return response;
+}
+
+String sendApiRequestVia(Client& client, const char* host, uint16_t port, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta) {
+  return sendVia(client, host, port, path, payload, apiKey, keepAlive, meta);
+}
+
+String sendApiRequestVia(WiFiClient& client, const char* host, uint16_t port, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta) {
+  return sendVia(client, host, port, path, payload, apiKey, keepAlive, meta);
+}
+
+String sendApiRequestVia(DoubaoTlsClient& client, const char* host, uint16_t port, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta) {
+  return sendVia(client, host, port, path, payload, apiKey, keepAlive, meta);
 }
 
-String buildPayload(String inputText, String modelId, String systemPrompt, float temp, String base64Image, String imageFormat) {
+String sendApiRequestOn(WiFiClientSecure& client, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta) {
+  client.setInsecure();
+  return sendApiRequestVia(client, DOUBAO_API_HOST, 443, path, payload, apiKey, keepAlive, meta);
+}
+
+static String sendUntraced(const String& path, DoubaoStringView payload, const char* apiKey, DoubaoResponseMeta* meta) {
+  DoubaoEndpointPool* endpoints = activeEndpoints;
+  if (endpoints != nullptr) {
+    return endpoints->request(path, payload, apiKey, meta);
+  }
+  // One client outlives the requests so every reconnect resumes its TLS session;
+  // only the session is kept, the connection and its buffers close after each request
+  static DoubaoTlsClient sharedClient;
+  static SemaphoreHandle_t sharedLock = xSemaphoreCreateMutex();
+  if (xSemaphoreTake(sharedLock, 0) == pdTRUE) {
+    String response = sendApiRequestVia(sharedClient, DOUBAO_API_HOST, 443, path, payload, apiKey, false, meta);
+    xSemaphoreGive(sharedLock);
+    return response;
+  }
+  // Another task is using it: a full handshake on a client of our own beats waiting
+  DoubaoTlsClient client;
+  return sendApiRequestVia(client, DOUBAO_API_HOST, 443, path, payload, apiKey, false, meta);
+}
+
+String sendApiRequest(const String& path, DoubaoStringView payload, const char* apiKey, DoubaoResponseMeta* meta) {
+  DoubaoTraceRecorder* recorder = activeRecorder;
+  if (recorder == nullptr) {
+    return sendUntraced(path, payload, apiKey, meta);
+  }
+  DoubaoResponseMeta localMeta;
+  if (meta == nullptr) {
+    meta = &localMeta;
+  }
+  unsigned long start = DoubaoClock::now();
+  String response = sendUntraced(path, payload, apiKey, meta);
+  recorder->record(payload, response, *meta, start);
+  return response;
+}
+
+String parseChatResponse(const String& response, DoubaoResponseMeta* meta) {
+  return DoubaoDefaultClient::parse(response, meta);
+}
+
+String sendHttpRequest(DoubaoStringView payload, const char* apiKey, DoubaoResponseMeta* meta) {
+  DoubaoDefaultClient client;
+  client.begin(apiKey);
+  return client.chat(payload, meta);
+}
+
+String sendHttpRequestWithRetry(DoubaoStringView payload, const char* apiKey, int maxRetries, DoubaoResponseMeta* meta) {
+  DoubaoDefaultClient client;
+  client.begin(apiKey);
+  return client.chatWithRetry(payload, maxRetries, meta);
+}
+
+String buildPayload(const String& inputText, const String& modelId, const String& systemPrompt, float temp, const String& base64Image, const String& imageFormat) {
+  if (base64Image != "" && base64Image != "NULL") {
+    return buildPayloadMultiImage(inputText, modelId, systemPrompt, temp, &base64Image, 1, imageFormat);
+  }
+  return buildPayloadMultiImage(inputText, modelId, systemPrompt, temp, nullptr, 0, imageFormat);
+}
+
+String buildPayloadMultiImage(const String& inputText, const String& modelId, const String& systemPrompt, float temp, const String* base64Images, int imageCount, const String& imageFormat) {
+  size_t imageBytes = 0;
+  for (int i = 0; i < imageCount; i++) {
+    imageBytes += base64Images[i].length() + imageFormat.length() + 64;
+  }
   String payload;
-  payload.reserve(2000);
+  payload.reserve(2000 + imageBytes);
   payload = "{";
   payload += "\"model\":\"" + modelId + "\",";
   payload += "\"messages\":[";
@@ -116,9 +293,16 @@ String buildPayload(String inputText, String modelId, String systemPrompt, float
   payload += "{";
   payload += "\"role\":\"user\",";
   payload += "\"content\":[";
-  if (base64Image != "" && base64Image != "NULL") {
+  for (int i = 0; i < imageCount; i++) {
+    if (base64Images[i].length() == 0 || base64Images[i] == "NULL") {
+      continue;
+    }
     payload += "{\"type\":\"image_url\",";
-    payload += "\"image_url\":{\"url\":\"data:image/" + imageFormat + ";base64," + base64Image + "\"}},";
+    payload += "\"image_url\":{\"url\":\"data:image/";
+    payload += imageFormat;
+    payload += ";base64,";
+    payload += base64Images[i];
+    payload += "\"}},";
   }
   payload += "{\"type\":\"text\",\"text\":\"" + inputText + "\"}";
   payload += "]";
@@ -129,8 +313,63 @@ String buildPayload(String inputText, String modelId, String systemPrompt, float
   return payload;
 }
 
-String getGPTAnswer(String inputText, const char* apiKey, String modelId, String systemPrompt, float temp) {
-  if (!validateConfig(apiKey, modelId, temp)) {
+String buildContextPrompt(const String& systemPrompt, const char* const* snippets, const size_t* lengths, int count) {
+  size_t contextBytes = 0;
+  for (int i = 0; i < count; i++) {
+    contextBytes += lengths[i] + 8;
+  }
+  String prompt;
+  prompt.reserve(systemPrompt.length() + contextBytes + 32);
+  prompt = systemPrompt;
+  if (count > 0) {
+    prompt += "\n\nReference material:";
+  }
+  for (int i = 0; i < count; i++) {
+    prompt += "\n[" + String(i + 1) + "] ";
+    prompt.concat(snippets[i], lengths[i]);
+  }
+  return prompt;
+}
+
+String getGPTAnswerWithContext(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, const char* const* snippets, const size_t* lengths, int count) {
+  // The only place the context prompt is escaped; the payload builders copy strings as they are
+  return getGPTAnswer(inputText, apiKey, modelId, jsonEscape(buildContextPrompt(systemPrompt, snippets, lengths, count)), temp);
+}
+
+bool buildPayloadInto(DoubaoBuffer& out, DoubaoStringView inputText, DoubaoStringView modelId, DoubaoStringView systemPrompt, float temp, const uint8_t* image, size_t imageLength, DoubaoStringView imageFormat) {
+  char temperature[16];
+  snprintf(temperature, sizeof(temperature), "%.2f", temp);
+  bool hasImage = image != nullptr && imageLength > 0;
+  // Same layout as buildPayloadMultiImage(); sized up front so the buffer is allocated once
+  out.clear();
+  size_t length = 160 + modelId.length + systemPrompt.length + inputText.length + strlen(temperature);
+  if (hasImage) {
+    length += 64 + imageFormat.length + doubaoBase64Length(imageLength);
+  }
+  if (!out.reserve(length)) {
+    return false;
+  }
+  out.append("{\"model\":\"");
+  out.append(modelId);
+  out.append("\",\"messages\":[{\"role\":\"system\",\"content\":\"");
+  out.append(systemPrompt);
+  out.append("\"},{\"role\":\"user\",\"content\":[");
+  if (hasImage) {
+    out.append("{\"type\":\"image_url\",\"image_url\":{\"url\":\"data:image/");
+    out.append(imageFormat);
+    out.append(";base64,");
+    out.appendBase64(image, imageLength);
+    out.append("\"}},");
+  }
+  out.append("{\"type\":\"text\",\"text\":\"");
+  out.append(inputText);
+  out.append("\"}]}],\"temperature\":");
+  return out.append(temperature) && out.append("}");
+}
+
+String getGPTAnswer(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp) {
+  DoubaoDefaultClient client;
+  if (!client.begin(apiKey, modelId) || !validateSettings(modelId, temp)) {
     return ERROR_INVALID_INPUT;
   }
   if (inputText.length() == 0) {
@@ -139,10 +378,10 @@ String getGPTAnswer(String inputText, const char* apiKey, String modelId, String
   }
   String payload = buildPayload(inputText, modelId, systemPrompt, temp);
   Serial.printf("Send text request, payload length:: %d\n", payload.length());
-  return sendHttpRequestWithRetry(payload, apiKey);
+  return client.chatWithRetry(payload);
 }
 
-String getGPTAnswer_urlimg(String inputText, String imageUrl, const char* apiKey, String modelId, String systemPrompt, float temp) {
+String getGPTAnswer_urlimg(const String& inputText, const String& imageUrl, const char* apiKey, const String& modelId, const String& systemPrompt, float temp) {
   if (inputText.length() == 0) {
     Serial.println("Error: Input text is empty");
     return ERROR_INVALID_INPUT;
@@ -165,10 +404,14 @@ String getGPTAnswer_urlimg(String inputText, String imageUrl, const char* apiKey
   payload += "\"temperature\":" + String(temp);
   payload += "}";
   Serial.printf("Send URL image request, payload length: %d\n", payload.length());
-  return sendHttpRequestWithRetry(payload, apiKey);
+  DoubaoDefaultClient client;
+  if (!client.begin(apiKey, modelId)) {
+    return ERROR_INVALID_INPUT;
+  }
+  return client.chatWithRetry(payload);
 }
 
-String getGPTAnswer_camera(String inputText, const char* apiKey, String modelId, String systemPrompt, float temp) {
+String getGPTAnswer_camera(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp) {
   if (inputText.length() == 0) {
     Serial.println("Error: Input text is empty");
     return ERROR_INVALID_INPUT;
@@ -181,21 +424,69 @@ String getGPTAnswer_camera(String inputText, const char* apiKey, String modelId,
   }
   String payload = buildPayload(inputText, modelId, systemPrompt, temp, base64Image, "jpg");
   Serial.printf("Send camera image request, payload length: %d\n", payload.length());
-  return sendHttpRequestWithRetry(payload, apiKey);
+  DoubaoDefaultClient client;
+  if (!client.begin(apiKey, modelId)) {
+    return ERROR_INVALID_INPUT;
+  }
+  return client.chatWithRetry(payload);
+}
+
+String getGPTAnswerJpeg(DoubaoStringView inputText, const uint8_t* jpg, size_t jpgLength, const char* apiKey, DoubaoStringView modelId, DoubaoStringView systemPrompt, float temp) {
+  DoubaoDefaultClient client;
+  if (!client.begin(apiKey) || !validateSettings(modelId, temp)) {
+    return ERROR_INVALID_INPUT;
+  }
+  if (inputText.empty()) {
+    Serial.println("Error: Input text is empty");
+    return ERROR_INVALID_INPUT;
+  }
+  // The payload buffer is the only image-sized allocation; it is passed down as a view
+  DoubaoBuffer payload;
+  if (!buildPayloadInto(payload, inputText, modelId, systemPrompt, temp, jpg, jpgLength, "jpg")) {
+    return ERROR_IMAGE_TOO_LARGE;
+  }
+  Serial.printf("Send image request, payload length: %u\n", (unsigned)payload.length());
+  return client.chatWithRetry(payload.view());
 }
 
-String getChoice(String msg_json, String msg_key) {
-  const char* jsonStr = msg_json.c_str();
-  ArduinoJson::DynamicJsonDocument doc(512);
-  ArduinoJson::DeserializationError error = ArduinoJson::deserializeJson(doc, jsonStr);
-  if (!error) {
-    if (doc.containsKey(msg_key)) {
-      String choice = doc[msg_key].as<String>();
-      return choice;
+String getGPTAnswerFrame(DoubaoStringView inputText, const char* apiKey, DoubaoStringView modelId, DoubaoStringView systemPrompt, float temp) {
+  camera_fb_t* fb = captureFrame();
+  if (fb == nullptr) {
+    Serial.println("Failed to capture image");
+    return ERROR_CAMERA;
+  }
+  String result;
+  if (fb->format == PIXFORMAT_JPEG) {
+    result = getGPTAnswerJpeg(inputText, fb->buf, fb->len, apiKey, modelId, systemPrompt, temp);
+  } else {
+    uint8_t* jpg = nullptr;
+    size_t jpgLength = 0;
+    if (frame2jpg(fb, 80, &jpg, &jpgLength)) {
+      result = getGPTAnswerJpeg(inputText, jpg, jpgLength, apiKey, modelId, systemPrompt, temp);
+      free(jpg);
     } else {
-      return "Parsing failed";
+      Serial.println("Failed to encode image");
+      result = ERROR_CAMERA;
     }
-  } else {
+  }
+  releaseFrame(fb);
+  return result;
+}
+
+String getChoice(const String& msg_json, const String& msg_key) {
+  // Top-level member as a one-segment JSON Pointer
+  String path = "/";
+  for (unsigned int i = 0; i < msg_key.length(); i++) {
+    char c = msg_key[i];
+    path += c == '~' ? "~0" : c == '/' ? "~1" : String(c);
+  }
+  DoubaoJsonExtractor extractor;
+  int field = extractor.add(path.c_str());
+  if (!extractor.extract(msg_json)) {
     return "JSON syntax error";
   }
+  if (!extractor.has(field)) {
+    return "Parsing failed";
+  }
+  return extractor.value(field);
 }
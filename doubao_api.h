@@ -5,6 +5,23 @@
 #include <HTTPClient.h>
 #include <ArduinoJsonK10.h>
 #include <WiFiClientSecure.h>
+#include "doubao_view.h"
+
+// API endpoint
+#define DOUBAO_API_HOST "ark.cn-beijing.volces.com"
+#define DOUBAO_CHAT_PATH "/api/v3/chat/completions"
+#define DOUBAO_EMBEDDINGS_PATH "/api/v3/embeddings"
+
+// Maximum wait for a complete response
+#define DOUBAO_RESPONSE_TIMEOUT_MS 300000
+
+// Hex digits in the X-Client-Request-Id sent with every request
+#define DOUBAO_TRACE_ID_LENGTH 16
+
+class DoubaoEndpointPool;
+class DoubaoKeyPool;
+class DoubaoTlsClient;
+class DoubaoTraceRecorder;
 
 // Error codes
 extern const String ERROR_NETWORK;
@@ -13,37 +30,158 @@ extern const String ERROR_IMAGE_TOO_LARGE;
 extern const String ERROR_INVALID_INPUT;
 extern const String ERROR_JSON_PARSE;
 extern const String ERROR_TIMEOUT;
+extern const String ERROR_SPOOLED;
+extern const String ERROR_OVERLOADED;
+extern const String ERROR_SCHEMA;
+extern const String ERROR_TOOL_ROUNDS;
 
-// Global answer variable
-extern String answer;
+// Details of one API response, filled by the request functions when requested
+struct DoubaoResponseMeta {
+  int status = 0;                  // HTTP status, 0 if no response arrived
+  unsigned long ttfbMs = 0;        // Request start to response status line
+  unsigned long latencyMs = 0;     // Request start to complete response
+  int promptTokens = 0;
+  int completionTokens = 0;
+  String finishReason;
+  long requestsRemaining = -1;     // x-ratelimit-remaining-requests, -1 if not sent
+  long tokensRemaining = -1;       // x-ratelimit-remaining-tokens, -1 if not sent
+  unsigned long retryAfterMs = 0;  // Retry-After, 0 if not sent
+  uint32_t heapFreeBefore = 0;     // Free heap when the request started
+  uint32_t heapMinFree = 0;        // Lowest free heap seen during the request
+  char traceId[DOUBAO_TRACE_ID_LENGTH + 1] = "";  // X-Client-Request-Id of the request
+};
 
 // Function declarations
 
+/**
+ * Check whether a response string is one of the library error codes
+ * @param response Value returned by one of the request functions
+ * @return true if response is an error code, false otherwise
+ */
+bool isErrorResponse(const String& response);
+
+/**
+ * Escape text for embedding in a JSON string literal
+ * @param text Raw text
+ * @return Escaped text (without surrounding quotes)
+ */
+String jsonEscape(const String& text);
+
+/**
+ * Generate a random request trace id
+ * @param out Output of DOUBAO_TRACE_ID_LENGTH hex digits plus terminator
+ */
+void generateTraceId(char* out);
+
 /**
  * Validate configuration parameters
- * @param apiKey API key to validate
+ * @param apiKey API key to validate (nullptr or "" is accepted when a key pool is installed)
  * @param modelId Model ID to validate
  * @param temp Temperature parameter to validate
  * @return true if configuration is valid, false otherwise
  */
-bool validateConfig(const char* apiKey, String modelId, float temp);
+bool validateConfig(const char* apiKey, DoubaoStringView modelId, float temp);
+
+/**
+ * Validate model ID and temperature; the API key is checked by DoubaoClient::begin()
+ * @param modelId Model ID to validate
+ * @param temp Temperature parameter to validate
+ * @return true if both are valid, false otherwise
+ */
+bool validateSettings(DoubaoStringView modelId, float temp);
+
+/**
+ * Send a POST request to an arbitrary Doubao API path
+ * @param path Request path (e.g. DOUBAO_EMBEDDINGS_PATH)
+ * @param payload JSON payload to send
+ * @param apiKey API key for authentication
+ * @param meta Optional output for status and timing
+ * @return Raw response body or error code
+ */
+String sendApiRequest(const String& path, DoubaoStringView payload, const char* apiKey, DoubaoResponseMeta* meta = nullptr);
+
+/**
+ * Send a POST request over a caller-owned connection
+ * @param client Connection to use; connected on demand and left open when keepAlive is set
+ * @param path Request path (e.g. DOUBAO_CHAT_PATH)
+ * @param payload JSON payload to send
+ * @param apiKey API key for authentication
+ * @param keepAlive Keep the connection open for the next request
+ * @param meta Optional output for status and timing
+ * @return Raw response body or error code
+ */
+String sendApiRequestOn(WiFiClientSecure& client, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta = nullptr);
+
+/**
+ * Send a POST request to any host over a caller-owned connection
+ * @param client Connection to use (TLS or plain); connected on demand and left open when keepAlive is set
+ * @param host Host to connect to, also sent as the Host header
+ * @param port Port to connect to
+ * @param path Request path
+ * @param payload JSON payload to send
+ * @param apiKey API key for authentication
+ * @param keepAlive Keep the connection open for the next request
+ * @param meta Optional output for status and timing
+ * @return Raw response body or error code
+ */
+String sendApiRequestVia(Client& client, const char* host, uint16_t port, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta = nullptr);
+
+// Same, for connections whose socket can be waited on; reads block in select()
+// instead of polling (a plain Client& is checked every DOUBAO_POLL_INTERVAL_MS)
+String sendApiRequestVia(WiFiClient& client, const char* host, uint16_t port, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta = nullptr);
+String sendApiRequestVia(DoubaoTlsClient& client, const char* host, uint16_t port, const String& path, DoubaoStringView payload, const char* apiKey, bool keepAlive, DoubaoResponseMeta* meta = nullptr);
+
+/**
+ * Route sendApiRequest() (and everything built on it) through an endpoint pool
+ * @param pool Endpoint pool, nullptr to go back to DOUBAO_API_HOST; must outlive requests already using it
+ */
+void setEndpointPool(DoubaoEndpointPool* pool);
+
+/**
+ * Use a key pool for requests made without an API key (apiKey nullptr or "")
+ * @param pool Key pool, nullptr to require explicit keys again; must outlive requests already using it
+ */
+void setKeyPool(DoubaoKeyPool* pool);
+
+/**
+ * Record the size and timing of every sendApiRequest() into a trace (see doubao_trace.h)
+ * @param recorder Started recorder, nullptr to stop recording; must outlive requests already using it
+ */
+void setTraceRecorder(DoubaoTraceRecorder* recorder);
+
+/**
+ * Check that a request can be authenticated
+ * @param apiKey API key, or nullptr/"" to use the installed key pool
+ * @return true if the key is set or a non-empty key pool is installed
+ */
+bool hasApiKey(const char* apiKey);
+
+/**
+ * Extract the answer from a chat completions response body
+ * @param response Raw response body
+ * @param meta Optional output for token usage and finish reason
+ * @return Message content or ERROR_JSON_PARSE
+ */
+String parseChatResponse(const String& response, DoubaoResponseMeta* meta = nullptr);
 
 /**
  * Send HTTP request to Doubao API
  * @param payload JSON payload to send
  * @param apiKey API key for authentication
- * @return Response text or error code
+ * @param meta Optional output for status, timing and token usage
+ * @return Response text or error code (ERROR_OVERLOADED for HTTP 429/5xx)
  */
-String sendHttpRequest(String payload, const char* apiKey);
+String sendHttpRequest(DoubaoStringView payload, const char* apiKey, DoubaoResponseMeta* meta = nullptr);
 
 /**
  * Send HTTP request with retry mechanism
  * @param payload JSON payload to send
  * @param apiKey API key for authentication
  * @param maxRetries Maximum number of retry attempts (default: 3)
+ * @param meta Optional output for the last attempt's status, timing and token usage
  * @return Response text or error code
  */
-String sendHttpRequestWithRetry(String payload, const char* apiKey, int maxRetries = 3);
+String sendHttpRequestWithRetry(DoubaoStringView payload, const char* apiKey, int maxRetries = 3, DoubaoResponseMeta* meta = nullptr);
 
 /**
  * Build JSON payload for API request
@@ -55,7 +193,59 @@ String sendHttpRequestWithRetry(String payload, const char* apiKey, int maxRetri
  * @param imageFormat Image format (e.g., "jpg", "png") (optional, default: "")
  * @return JSON payload string
  */
-String buildPayload(String inputText, String modelId, String systemPrompt, float temp, String base64Image = "", String imageFormat = "");
+String buildPayload(const String& inputText, const String& modelId, const String& systemPrompt, float temp, const String& base64Image = "", const String& imageFormat = "");
+
+/**
+ * Build JSON payload carrying several images in one user message
+ * @param inputText Text message to send
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @param base64Images Array of base64 encoded images (e.g. ROI tiles)
+ * @param imageCount Number of entries in base64Images
+ * @param imageFormat Image format shared by all images (e.g., "jpg")
+ * @return JSON payload string
+ */
+String buildPayloadMultiImage(const String& inputText, const String& modelId, const String& systemPrompt, float temp, const String* base64Images, int imageCount, const String& imageFormat);
+
+/**
+ * Append retrieved context snippets to a system prompt
+ * @param systemPrompt System prompt/role
+ * @param snippets Snippet texts (not NUL-terminated)
+ * @param lengths Byte length of each snippet
+ * @param count Number of snippets
+ * @return Plain text: the system prompt with the snippets appended as numbered references (not JSON-escaped)
+ */
+String buildContextPrompt(const String& systemPrompt, const char* const* snippets, const size_t* lengths, int count);
+
+/**
+ * Get GPT answer with retrieved snippets appended to the system prompt.
+ * The combined prompt is JSON-escaped here, so pass the system prompt as plain text.
+ * @param inputText Text message to send
+ * @param apiKey API key for authentication
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role, plain text
+ * @param temp Temperature parameter
+ * @param snippets Snippet texts (not NUL-terminated)
+ * @param lengths Byte length of each snippet
+ * @param count Number of snippets
+ * @return AI response or error code
+ */
+String getGPTAnswerWithContext(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, const char* const* snippets, const size_t* lengths, int count);
+
+/**
+ * Build a chat payload in one buffer, base64-encoding the image straight into it
+ * @param out Output buffer; cleared, then sized once for the whole payload
+ * @param inputText Text message to send
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @param image Raw image bytes (optional)
+ * @param imageLength Number of image bytes
+ * @param imageFormat Image format (default: "jpg")
+ * @return true on success, false if out of memory
+ */
+bool buildPayloadInto(DoubaoBuffer& out, DoubaoStringView inputText, DoubaoStringView modelId, DoubaoStringView systemPrompt, float temp, const uint8_t* image = nullptr, size_t imageLength = 0, DoubaoStringView imageFormat = "jpg");
 
 /**
  * Get GPT answer for text message
@@ -66,7 +256,7 @@ String buildPayload(String inputText, String modelId, String systemPrompt, float
  * @param temp Temperature parameter
  * @return AI response or error code
  */
-String getGPTAnswer(String inputText, const char* apiKey, String modelId, String systemPrompt, float temp);
+String getGPTAnswer(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp);
 
 /**
  * Get GPT answer for text message with image URL
@@ -78,7 +268,7 @@ String getGPTAnswer(String inputText, const char* apiKey, String modelId, String
  * @param temp Temperature parameter
  * @return AI response or error code
  */
-String getGPTAnswer_urlimg(String inputText, String imageUrl, const char* apiKey, String modelId, String systemPrompt, float temp);
+String getGPTAnswer_urlimg(const String& inputText, const String& imageUrl, const char* apiKey, const String& modelId, const String& systemPrompt, float temp);
 
 /**
  * Get GPT answer for text message with camera photo
@@ -89,7 +279,31 @@ String getGPTAnswer_urlimg(String inputText, String imageUrl, const char* apiKey
  * @param temp Temperature parameter
  * @return AI response or error code
  */
-String getGPTAnswer_camera(String inputText, const char* apiKey, String modelId, String systemPrompt, float temp);
+String getGPTAnswer_camera(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp);
+
+/**
+ * Get GPT answer for text message with a JPEG image held in memory
+ * @param inputText Text message to send
+ * @param jpg JPEG bytes, encoded straight into the payload
+ * @param jpgLength Number of JPEG bytes
+ * @param apiKey API key for authentication
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @return AI response or error code
+ */
+String getGPTAnswerJpeg(DoubaoStringView inputText, const uint8_t* jpg, size_t jpgLength, const char* apiKey, DoubaoStringView modelId, DoubaoStringView systemPrompt, float temp);
+
+/**
+ * Get GPT answer for text message with a frame from captureFrame()
+ * @param inputText Text message to send
+ * @param apiKey API key for authentication
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @return AI response or error code
+ */
+String getGPTAnswerFrame(DoubaoStringView inputText, const char* apiKey, DoubaoStringView modelId, DoubaoStringView systemPrompt, float temp);
 
 /**
  * Parse JSON and get value by key
@@ -97,6 +311,6 @@ String getGPTAnswer_camera(String inputText, const char* apiKey, String modelId,
  * @param msg_key Key to extract from JSON
  * @return Value of the key or error message
  */
-String getChoice(String msg_json, String msg_key);
+String getChoice(const String& msg_json, const String& msg_key);
 
 #endif // DOUBAO_API_H
@@ -0,0 +1,311 @@
+#include "doubao_batch.h"
+#include "doubao_http.h"
+#include "doubao_json_path.h"
+#include "doubao_policies.h"
+#include <HTTPClient.h>
+#include <WiFi.h>
+
+// Body sink splitting the results JSONL into lines as it arrives
+struct DoubaoBatch::ResultSink {
+  ResultSink(DoubaoBatch* owner, const DoubaoResponseMeta* meta) : batch(owner), response(meta), total(0), index(0) {
+  }
+  void reserve(size_t size) {
+  }
+  bool append(DoubaoStringView data) {
+    total += data.length;
+    for (size_t i = 0; i < data.length; i++) {
+      if (data.data[i] == '\n') {
+        finishLine();
+      } else {
+        line += data.data[i];
+      }
+    }
+    return true;
+  }
+  size_t length() const {
+    return total;
+  }
+  // Lines delivered by an earlier, interrupted download are skipped
+  void finishLine() {
+    if (line.length() > 0 && response->status == HTTP_CODE_OK) {
+      if (index >= batch->resultLines_) {
+        batch->deliverResultLine(line);
+        batch->resultLines_++;
+      }
+      index++;
+    }
+    line = "";
+  }
+  DoubaoBatch* batch;
+  const DoubaoResponseMeta* response;
+  String line;
+  size_t total;
+  int index;
+};
+
+// Splits "http://host[:port][/prefix]"
+static bool parseHttpUrl(const String& url, String& host, uint16_t& port, String& prefix) {
+  if (!url.startsWith("http://")) {
+    return false;
+  }
+  int hostStart = 7;
+  int pathStart = url.indexOf('/', hostStart);
+  String authority = pathStart < 0 ? url.substring(hostStart) : url.substring(hostStart, pathStart);
+  prefix = pathStart < 0 ? "" : url.substring(pathStart);
+  if (prefix.endsWith("/")) {
+    prefix.remove(prefix.length() - 1);
+  }
+  int colon = authority.indexOf(':');
+  host = colon < 0 ? authority : authority.substring(0, colon);
+  port = colon < 0 ? 80 : (uint16_t)authority.substring(colon + 1).toInt();
+  return host.length() > 0 && port != 0;
+}
+
+DoubaoBatch::DoubaoBatch(const char* jobPath)
+    : jobPath_(jobPath), fs_(nullptr), apiKey_(nullptr), callback_(nullptr), context_(nullptr),
+      state_(DOUBAO_BATCH_COLLECTING), count_(0), completed_(0), cursor_(0), resultLines_(0), interval_(1000), lastPoll_(0) {
+}
+
+bool DoubaoBatch::begin(const char* apiKey, DoubaoBatchCallback callback, void* context, fs::FS& fs) {
+  if (!hasApiKey(apiKey)) {
+    Serial.println("Error: API key not set");
+    return false;
+  }
+  if (baseUrl_.length() > 0 && (apiKey == nullptr || strlen(apiKey) == 0)) {
+    Serial.println("Error: Job server needs an API key; the key pool is not used");
+    return false;
+  }
+  fs_ = &fs;
+  apiKey_ = apiKey;
+  callback_ = callback;
+  context_ = context;
+  state_ = DOUBAO_BATCH_COLLECTING;
+  count_ = 0;
+  completed_ = 0;
+  cursor_ = 0;
+  resultLines_ = 0;
+  jobId_ = "";
+  fs_->remove(jobPath_.c_str());
+  return true;
+}
+
+void DoubaoBatch::useJobServer(const char* baseUrl) {
+  baseUrl_ = baseUrl != nullptr ? baseUrl : "";
+}
+
+void DoubaoBatch::setPollInterval(unsigned long intervalMs) {
+  interval_ = intervalMs;
+}
+
+int DoubaoBatch::size() const {
+  return count_;
+}
+
+int DoubaoBatch::completed() const {
+  return completed_;
+}
+
+bool DoubaoBatch::add(const String& customId, const String& inputText, const String& modelId, const String& systemPrompt, float temp, const String& base64Image) {
+  if (fs_ == nullptr || state_ != DOUBAO_BATCH_COLLECTING) {
+    Serial.println("Error: Batch job not collecting");
+    return false;
+  }
+  if (inputText.length() == 0) {
+    Serial.println("Error: Input text is empty");
+    return false;
+  }
+  File file = fs_->open(jobPath_.c_str(), FILE_APPEND);
+  if (!file) {
+    Serial.println("Error: Failed to open batch job file");
+    return false;
+  }
+  String line = "{\"custom_id\":\"" + jsonEscape(customId) + "\",\"body\":";
+  file.print(line);
+  file.print(buildPayload(inputText, modelId, systemPrompt, temp, base64Image, "jpg"));
+  file.print("}\n");
+  file.close();
+  count_++;
+  return true;
+}
+
+bool DoubaoBatch::submit() {
+  if (fs_ == nullptr || state_ != DOUBAO_BATCH_COLLECTING || count_ == 0) {
+    Serial.println("Error: Nothing to submit");
+    return false;
+  }
+  if (baseUrl_.length() > 0) {
+    // useJobServer() may have been called after begin() accepted a pooled key
+    if (apiKey_ == nullptr || strlen(apiKey_) == 0) {
+      Serial.println("Error: Job server needs an API key; the key pool is not used");
+      return false;
+    }
+    File file = fs_->open(jobPath_.c_str(), FILE_READ);
+    if (!file) {
+      return false;
+    }
+    HTTPClient http;
+    http.begin(baseUrl_ + "/v1/batches");
+    http.addHeader("Content-Type", "application/jsonl");
+    http.addHeader("Authorization", "Bearer " + String(apiKey_));
+    int code = http.sendRequest("POST", &file, file.size());
+    String response = http.getString();
+    http.end();
+    file.close();
+    if (code != HTTP_CODE_OK) {
+      Serial.printf("Batch submit failed: HTTP %d\n", code);
+      return false;
+    }
+    DynamicJsonDocument doc(256);
+    if (deserializeJson(doc, response) || !doc.containsKey("id")) {
+      Serial.println("Error: Batch job id missing");
+      return false;
+    }
+    jobId_ = doc["id"].as<String>();
+    Serial.printf("Batch job %s submitted (%d requests)\n", jobId_.c_str(), count_);
+  } else {
+    Serial.printf("Batch job submitted (%d requests)\n", count_);
+  }
+  cursor_ = 0;
+  resultLines_ = 0;
+  lastPoll_ = 0;
+  state_ = DOUBAO_BATCH_RUNNING;
+  return true;
+}
+
+DoubaoBatchState DoubaoBatch::poll() {
+  if (state_ != DOUBAO_BATCH_RUNNING || WiFi.status() != WL_CONNECTED) {
+    return state_;
+  }
+  if (lastPoll_ != 0 && DoubaoClock::now() - lastPoll_ < interval_) {
+    return state_;
+  }
+  lastPoll_ = DoubaoClock::now();
+  bool finished = baseUrl_.length() > 0 ? pollJobServer() : pollArk();
+  if (finished) {
+    client_.stop();
+    fs_->remove(jobPath_.c_str());
+    if (state_ == DOUBAO_BATCH_RUNNING) {
+      state_ = DOUBAO_BATCH_DONE;
+    }
+    Serial.printf("Batch job finished, %d/%d results\n", completed_, count_);
+  }
+  return state_;
+}
+
+// Sends the next job line; returns true once every line has been answered
+bool DoubaoBatch::pollArk() {
+  File file = fs_->open(jobPath_.c_str(), FILE_READ);
+  if (!file || !file.seek(cursor_) || cursor_ >= file.size()) {
+    return true;
+  }
+  String line = file.readStringUntil('\n');
+  file.close();
+  // custom_id is written first, so the extractor stops before scanning the body
+  DoubaoJsonExtractor extractor;
+  int idField = extractor.add("/custom_id");
+  int idEnd = line.indexOf("\",\"body\":");
+  if (!line.startsWith("{\"custom_id\":\"") || idEnd < 0 || !line.endsWith("}") ||
+      !extractor.extract(DoubaoStringView(line.c_str(), line.length())) || !extractor.has(idField)) {
+    Serial.println("Error: Malformed batch line, skipping");
+    cursor_ += line.length() + 1;
+    return false;
+  }
+  String customId = extractor.value(idField);
+  DoubaoStringView body(line.c_str() + idEnd + 9, line.length() - idEnd - 10);
+  DoubaoResponseMeta meta;
+  String response = sendApiRequestOn(client_, DOUBAO_BATCH_CHAT_PATH, body, apiKey_, true, &meta);
+  if (response == ERROR_NETWORK || response == ERROR_TIMEOUT || response == ERROR_OVERLOADED ||
+      meta.status == 429 || meta.status >= 500) {
+    // Retried on a later poll
+    return false;
+  }
+  cursor_ += line.length() + 1;
+  completed_++;
+  if (callback_ != nullptr) {
+    // Rejected requests pass the server's error body, so the caller can see why
+    callback_(customId, meta.status == 200 ? parseChatResponse(response) : response, meta.status, context_);
+  }
+  return false;
+}
+
+bool DoubaoBatch::deliverResultLine(const String& line) {
+  StaticJsonDocument<256> filter;
+  filter["custom_id"] = true;
+  filter["response"]["choices"][0]["message"]["content"] = true;
+  DynamicJsonDocument doc(line.length() + 512);
+  if (deserializeJson(doc, line, DeserializationOption::Filter(filter))) {
+    Serial.println("Error: Malformed batch result line");
+    return false;
+  }
+  completed_++;
+  if (callback_ != nullptr) {
+    JsonVariant content = doc["response"]["choices"][0]["message"]["content"];
+    if (content.isNull()) {
+      callback_(doc["custom_id"].as<String>(), ERROR_JSON_PARSE, 0, context_);
+    } else {
+      callback_(doc["custom_id"].as<String>(), content.as<String>(), 200, context_);
+    }
+  }
+  return true;
+}
+
+// Checks the job status and streams results once complete; returns true when finished
+bool DoubaoBatch::pollJobServer() {
+  HTTPClient http;
+  http.begin(baseUrl_ + "/v1/batches/" + jobId_);
+  http.addHeader("Authorization", "Bearer " + String(apiKey_));
+  int code = http.GET();
+  String response = code == HTTP_CODE_OK ? http.getString() : "";
+  http.end();
+  if (code != HTTP_CODE_OK) {
+    Serial.printf("Batch status failed: HTTP %d\n", code);
+    return false;
+  }
+  DynamicJsonDocument doc(256);
+  if (deserializeJson(doc, response)) {
+    return false;
+  }
+  String status = doc["status"].as<String>();
+  if (status == "failed") {
+    state_ = DOUBAO_BATCH_FAILED;
+    return true;
+  }
+  if (status != "completed") {
+    return false;
+  }
+  // Results go through the shared HTTP/1.1 reader, which handles chunked encoding and
+  // reports a cut-short download; lines are delivered as they arrive
+  String host;
+  String prefix;
+  uint16_t port;
+  if (!parseHttpUrl(baseUrl_, host, port, prefix)) {
+    Serial.println("Error: Job server URL must be http://host[:port][/path]");
+    state_ = DOUBAO_BATCH_FAILED;
+    return true;
+  }
+  WiFiClient client;
+  if (!client.connect(host.c_str(), port)) {
+    Serial.printf("Failed to connect to %s\n", host.c_str());
+    return false;
+  }
+  String request = "GET " + prefix + "/v1/batches/" + jobId_ + "/results HTTP/1.1\r\nHost: " + host +
+                   "\r\nAuthorization: Bearer " + String(apiKey_) + "\r\nConnection: close\r\n\r\n";
+  if (!doubaoWriteAll(client, request.c_str(), request.length())) {
+    client.stop();
+    return false;
+  }
+  DoubaoResponseMeta meta;
+  ResultSink sink(this, &meta);
+  bool keepAlive = false;
+  String error = doubaoReadResponseTo(client, DoubaoClock::now(), DOUBAO_BATCH_RESULTS_TIMEOUT_MS, &keepAlive, &meta, sink);
+  client.stop();
+  if (error.length() == 0 && meta.status == HTTP_CODE_OK) {
+    sink.finishLine();   // Last line may lack its newline
+    return true;
+  }
+  if (meta.status != HTTP_CODE_OK && meta.status != 0) {
+    Serial.printf("Batch results failed: HTTP %d\n", meta.status);
+  }
+  // Retried on a later poll, continuing after the lines already delivered
+  return false;
+}
@@ -0,0 +1,131 @@
+#ifndef DOUBAO_BATCH_H
+#define DOUBAO_BATCH_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include "doubao_api.h"
+
+#define DOUBAO_BATCH_PATH "/doubao_batch.jsonl"
+#define DOUBAO_BATCH_CHAT_PATH "/api/v3/batch/chat/completions"
+#define DOUBAO_BATCH_RESULTS_TIMEOUT_MS 120000  // Job server: time allowed to download all results
+
+/*
+ * Jobs are collected as JSONL, one request per line:
+ *   {"custom_id":"<id>","body":<chat completions payload>}
+ *
+ * Ark backend: each line is sent to the batch chat endpoint (batch inference
+ * endpoint ids, "ep-bi-..."), one request per poll() over a kept-alive
+ * connection, so bulk work trickles out at low priority.
+ *
+ * Job server backend (local stand-in for testing, plain http:// only):
+ *   POST <base>/v1/batches                 body: the JSONL job  -> {"id":"<job>"}
+ *   GET  <base>/v1/batches/<job>           -> {"status":"in_progress"|"completed"|"failed"}
+ *   GET  <base>/v1/batches/<job>/results   -> JSONL {"custom_id":"<id>","response":<chat completion>}
+ */
+
+enum DoubaoBatchState {
+  DOUBAO_BATCH_COLLECTING,
+  DOUBAO_BATCH_RUNNING,
+  DOUBAO_BATCH_DONE,
+  DOUBAO_BATCH_FAILED
+};
+
+/**
+ * Called with the answer of each request in the job
+ * @param customId Id given to add()
+ * @param result AI response when status is 200; otherwise the server's error body, or an error code
+ * @param status HTTP status of the answer, 0 if there was none
+ * @param context User pointer given to begin()
+ */
+typedef void (*DoubaoBatchCallback)(const String& customId, const String& result, int status, void* context);
+
+/**
+ * Batch inference job for non-urgent bulk requests
+ */
+class DoubaoBatch {
+public:
+  DoubaoBatch(const char* jobPath = DOUBAO_BATCH_PATH);
+
+  /**
+   * Start a new job; the filesystem must already be mounted
+   * @param apiKey API key for authentication; nullptr to use the key pool, except with a job server
+   * @param callback Receives each result
+   * @param context User pointer passed to callback
+   * @param fs Filesystem holding the job file (default: LittleFS)
+   * @return true on success, false otherwise
+   */
+  bool begin(const char* apiKey, DoubaoBatchCallback callback, void* context = nullptr, fs::FS& fs = LittleFS);
+
+  /**
+   * Submit to a job server instead of Ark; needs an explicit API key in begin(), as
+   * job server requests do not draw keys from a DoubaoKeyPool
+   * @param baseUrl Server base URL, e.g. "http://192.168.1.10:8080" (https is not supported)
+   */
+  void useJobServer(const char* baseUrl);
+
+  /**
+   * Set how often poll() talks to the server
+   * @param intervalMs Minimum time between requests (default: 1000)
+   */
+  void setPollInterval(unsigned long intervalMs);
+
+  /**
+   * Append a request to the job
+   * @param customId Caller id echoed to the callback
+   * @param inputText Text message to send
+   * @param modelId Model ID (batch endpoint id for the Ark backend)
+   * @param systemPrompt System prompt/role
+   * @param temp Temperature parameter
+   * @param base64Image Base64 encoded JPEG (optional, default: "")
+   * @return true on success, false otherwise
+   */
+  bool add(const String& customId, const String& inputText, const String& modelId, const String& systemPrompt, float temp, const String& base64Image = "");
+
+  /**
+   * Close the job and start processing it
+   * @return true on success, false otherwise
+   */
+  bool submit();
+
+  /**
+   * Advance the job and deliver finished results; call from loop()
+   * @return Current job state
+   */
+  DoubaoBatchState poll();
+
+  /**
+   * @return Number of requests added to the job
+   */
+  int size() const;
+
+  /**
+   * @return Number of results delivered so far
+   */
+  int completed() const;
+
+private:
+  struct ResultSink;
+
+  bool pollArk();
+  bool pollJobServer();
+  bool deliverResultLine(const String& line);
+
+  String jobPath_;
+  String baseUrl_;
+  String jobId_;
+  fs::FS* fs_;
+  const char* apiKey_;
+  DoubaoBatchCallback callback_;
+  void* context_;
+  DoubaoBatchState state_;
+  int count_;
+  int completed_;
+  uint32_t cursor_;
+  int resultLines_;            // Job server result lines already delivered
+  unsigned long interval_;
+  unsigned long lastPoll_;
+  WiFiClientSecure client_;
+};
+
+#endif // DOUBAO_BATCH_H
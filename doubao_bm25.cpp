@@ -0,0 +1,388 @@
+#include "doubao_bm25.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <esp_partition.h>
+#endif
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+static uint32_t fnvUpdate(uint32_t hash, const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+static uint64_t align4(uint64_t n) {
+  return (n + 3) & ~(uint64_t)3;
+}
+
+// begin() also runs in the host index builder, which has no Serial
+static void printError(const char* message) {
+#ifdef ARDUINO
+  Serial.println(message);
+#else
+  fprintf(stderr, "%s\n", message);
+#endif
+}
+
+// Decode one UTF-8 sequence; invalid bytes decode as a 1-byte separator (0)
+static uint32_t decodeUtf8(const uint8_t* p, size_t remaining, size_t* length) {
+  uint8_t c = p[0];
+  size_t n = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+  if (n == 0 || n > remaining) {
+    *length = 1;
+    return 0;
+  }
+  uint32_t cp = n == 1 ? c : c & (0x7F >> n);
+  for (size_t i = 1; i < n; i++) {
+    if ((p[i] & 0xC0) != 0x80) {
+      *length = 1;
+      return 0;
+    }
+    cp = (cp << 6) | (p[i] & 0x3F);
+  }
+  *length = n;
+  return cp;
+}
+
+static bool isCJK(uint32_t cp) {
+  return (cp >= 0x4E00 && cp <= 0x9FFF) || (cp >= 0x3400 && cp <= 0x4DBF) ||
+         (cp >= 0xF900 && cp <= 0xFAFF) || (cp >= 0x20000 && cp <= 0x2A6DF);
+}
+
+static bool isWordChar(uint32_t cp) {
+  return (cp >= '0' && cp <= '9') || (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z');
+}
+
+size_t bm25Tokenize(const char* text, size_t length, DoubaoTermCallback callback, void* context) {
+  const uint8_t* p = (const uint8_t*)text;
+  size_t terms = 0;
+  uint32_t wordHash = FNV_OFFSET;
+  size_t wordLength = 0;
+  const uint8_t* previousCJK = nullptr;
+  size_t previousLength = 0;
+  size_t runLength = 0;
+  size_t i = 0;
+  while (i <= length) {
+    size_t n = 1;
+    uint32_t cp = i < length ? decodeUtf8(p + i, length - i, &n) : 0;
+    if (isWordChar(cp)) {
+      uint8_t lower = (uint8_t)(cp >= 'A' && cp <= 'Z' ? cp + 32 : cp);
+      wordHash = fnvUpdate(wordHash, &lower, 1);
+      wordLength++;
+    } else if (wordLength > 0) {
+      callback(wordHash, context);
+      terms++;
+      wordHash = FNV_OFFSET;
+      wordLength = 0;
+    }
+    if (isCJK(cp)) {
+      if (previousCJK != nullptr) {
+        // Bigram of the previous and current character
+        uint32_t hash = fnvUpdate(FNV_OFFSET, previousCJK, previousLength);
+        callback(fnvUpdate(hash, p + i, n), context);
+        terms++;
+      }
+      previousCJK = p + i;
+      previousLength = n;
+      runLength++;
+    } else {
+      if (runLength == 1) {
+        // An isolated CJK character is indexed on its own
+        callback(fnvUpdate(FNV_OFFSET, previousCJK, previousLength), context);
+        terms++;
+      }
+      previousCJK = nullptr;
+      runLength = 0;
+    }
+    i += n;
+  }
+  return terms;
+}
+
+// Decode one varint, never reading at or past end; false if it runs off the end
+static bool readVarint(const uint8_t** p, const uint8_t* end, uint32_t* value) {
+  *value = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    if (*p >= end) {
+      return false;
+    }
+    byte = *(*p)++;
+    *value |= (uint32_t)(byte & 0x7F) << shift;
+    shift += 7;
+  } while ((byte & 0x80) != 0 && shift < 35);
+  return true;
+}
+
+DoubaoBM25Index::DoubaoBM25Index()
+    : header_(nullptr), terms_(nullptr), textOffsets_(nullptr), docLengths_(nullptr),
+      postings_(nullptr), text_(nullptr), length_(0), scores_(nullptr), k1_(1.2f), b_(0.75f),
+      mapHandle_(0), mapped_(false) {
+}
+
+DoubaoBM25Index::~DoubaoBM25Index() {
+  end();
+}
+
+bool DoubaoBM25Index::begin(const uint8_t* data, size_t length) {
+  free(scores_);
+  scores_ = nullptr;
+  header_ = nullptr;
+  if (data == nullptr || length < sizeof(DoubaoBM25Header) || ((uintptr_t)data & 3) != 0) {
+    printError("Error: Invalid BM25 index buffer");
+    return false;
+  }
+  const DoubaoBM25Header* header = (const DoubaoBM25Header*)data;
+  if (memcmp(header->magic, DOUBAO_BM25_MAGIC, 4) != 0 || header->version != DOUBAO_BM25_VERSION) {
+    printError("Error: Not a BM25 index or unsupported version");
+    return false;
+  }
+  if (header->docCount == 0) {
+    printError("Error: BM25 index has no documents");
+    return false;
+  }
+  // 64-bit sums, so huge counts in a corrupt header cannot wrap around
+  uint64_t offset = sizeof(DoubaoBM25Header);
+  uint64_t termsOffset = offset;
+  offset += (uint64_t)header->termCount * sizeof(DoubaoBM25Term);
+  uint64_t textOffsetsOffset = offset;
+  offset += ((uint64_t)header->docCount + 1) * sizeof(uint32_t);
+  uint64_t docLengthsOffset = offset;
+  offset = align4(offset + (uint64_t)header->docCount * sizeof(uint16_t));
+  uint64_t postingsOffset = offset;
+  offset = align4(offset + header->postingsBytes);
+  uint64_t textOffset = offset;
+  offset += header->textBytes;
+  if (offset > length) {
+    printError("Error: Truncated BM25 index");
+    return false;
+  }
+  // Lookup is a binary search over hashes, and each posting run must start
+  // inside the postings section with room for its docFreq pairs (2 bytes or more each)
+  const DoubaoBM25Term* terms = (const DoubaoBM25Term*)(data + termsOffset);
+  for (uint32_t i = 0; i < header->termCount; i++) {
+    if (i > 0 && terms[i].hash <= terms[i - 1].hash) {
+      printError("Error: BM25 index terms are not sorted");
+      return false;
+    }
+    if (terms[i].postingsOffset >= header->postingsBytes ||
+        (uint64_t)terms[i].docFreq * 2 > header->postingsBytes - terms[i].postingsOffset) {
+      printError("Error: Corrupt BM25 index postings");
+      return false;
+    }
+  }
+  // Every document text must lie inside the text section
+  const uint32_t* textOffsets = (const uint32_t*)(data + textOffsetsOffset);
+  for (uint32_t i = 0; i < header->docCount; i++) {
+    if (textOffsets[i] > textOffsets[i + 1]) {
+      printError("Error: Corrupt BM25 index text offsets");
+      return false;
+    }
+  }
+  if (textOffsets[header->docCount] > header->textBytes) {
+    printError("Error: Corrupt BM25 index text offsets");
+    return false;
+  }
+  scores_ = (float*)malloc(sizeof(float) * header->docCount);
+  if (scores_ == nullptr) {
+    printError("Error: Out of memory for BM25 scores");
+    return false;
+  }
+  header_ = header;
+  terms_ = terms;
+  textOffsets_ = textOffsets;
+  docLengths_ = (const uint16_t*)(data + docLengthsOffset);
+  postings_ = data + postingsOffset;
+  text_ = (const char*)(data + textOffset);
+  length_ = (size_t)offset;
+  return true;
+}
+
+void DoubaoBM25Index::end() {
+#ifdef ARDUINO
+  if (mapped_) {
+    esp_partition_munmap(mapHandle_);
+    mapped_ = false;
+  }
+#endif
+  free(scores_);
+  scores_ = nullptr;
+  header_ = nullptr;
+}
+
+void DoubaoBM25Index::setParameters(float k1, float b) {
+  k1_ = k1;
+  b_ = b;
+}
+
+int DoubaoBM25Index::size() const {
+  return header_ != nullptr ? header_->docCount : 0;
+}
+
+size_t DoubaoBM25Index::indexBytes() const {
+  return header_ != nullptr ? length_ : 0;
+}
+
+const char* DoubaoBM25Index::docText(int id, size_t* length) const {
+  if (header_ == nullptr || id < 0 || (uint32_t)id >= header_->docCount) {
+    *length = 0;
+    return nullptr;
+  }
+  *length = textOffsets_[id + 1] - textOffsets_[id];
+  return text_ + textOffsets_[id];
+}
+
+const DoubaoBM25Term* DoubaoBM25Index::findTerm(uint32_t hash) const {
+  uint32_t lo = 0;
+  uint32_t hi = header_->termCount;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (terms_[mid].hash < hash) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < header_->termCount && terms_[lo].hash == hash ? &terms_[lo] : nullptr;
+}
+
+struct QueryTerms {
+  uint32_t hashes[DOUBAO_BM25_MAX_QUERY_TERMS];
+  int count;
+};
+
+static void collectQueryTerm(uint32_t hash, void* context) {
+  QueryTerms* terms = (QueryTerms*)context;
+  for (int i = 0; i < terms->count; i++) {
+    if (terms->hashes[i] == hash) {
+      return;
+    }
+  }
+  if (terms->count < DOUBAO_BM25_MAX_QUERY_TERMS) {
+    terms->hashes[terms->count++] = hash;
+  }
+}
+
+int DoubaoBM25Index::search(const char* query, size_t queryLength, int k, int* ids, float* scores) {
+  if (header_ == nullptr || query == nullptr || k <= 0) {
+    return 0;
+  }
+  k = k < DOUBAO_BM25_MAX_K ? k : DOUBAO_BM25_MAX_K;
+  QueryTerms terms;
+  terms.count = 0;
+  bm25Tokenize(query, queryLength, collectQueryTerm, &terms);
+  uint32_t docCount = header_->docCount;
+  // The first search takes the shared score buffer; searches running at the
+  // same time on other tasks use a buffer of their own
+  bool shared = !scoresBusy_.test_and_set(std::memory_order_acquire);
+  float* docScores = shared ? scores_ : (float*)malloc(sizeof(float) * docCount);
+  if (docScores == nullptr) {
+    return 0;
+  }
+  memset(docScores, 0, sizeof(float) * docCount);
+  float avgDocLength = header_->avgDocLength > 0.0f ? header_->avgDocLength : 1.0f;
+  for (int t = 0; t < terms.count; t++) {
+    const DoubaoBM25Term* term = findTerm(terms.hashes[t]);
+    if (term == nullptr) {
+      continue;
+    }
+    float df = (float)term->docFreq;
+    float idf = logf(1.0f + (docCount - df + 0.5f) / (df + 0.5f));
+    const uint8_t* p = postings_ + term->postingsOffset;
+    const uint8_t* end = postings_ + header_->postingsBytes;
+    uint32_t doc = 0;
+    for (uint32_t j = 0; j < term->docFreq; j++) {
+      uint32_t delta;
+      uint32_t frequency;
+      if (!readVarint(&p, end, &delta) || !readVarint(&p, end, &frequency)) {
+        break;
+      }
+      doc += delta;
+      if (doc >= docCount) {
+        break;
+      }
+      float tf = (float)frequency;
+      float norm = k1_ * (1.0f - b_ + b_ * docLengths_[doc] / avgDocLength);
+      docScores[doc] += idf * tf * (k1_ + 1.0f) / (tf + norm);
+    }
+  }
+  float best[DOUBAO_BM25_MAX_K];
+  int found = 0;
+  for (uint32_t doc = 0; doc < docCount; doc++) {
+    float score = docScores[doc];
+    if (score <= 0.0f || (found == k && score <= best[k - 1])) {
+      continue;
+    }
+    int pos = found < k ? found++ : k - 1;
+    while (pos > 0 && best[pos - 1] < score) {
+      best[pos] = best[pos - 1];
+      ids[pos] = ids[pos - 1];
+      pos--;
+    }
+    best[pos] = score;
+    ids[pos] = doc;
+  }
+  if (shared) {
+    scoresBusy_.clear(std::memory_order_release);
+  } else {
+    free(docScores);
+  }
+  if (scores != nullptr) {
+    memcpy(scores, best, sizeof(float) * found);
+  }
+  return found;
+}
+
+#ifdef ARDUINO
+bool DoubaoBM25Index::beginPartition(const char* partitionLabel) {
+  end();
+  const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel);
+  if (partition == nullptr) {
+    Serial.printf("Error: Partition %s not found\n", partitionLabel);
+    return false;
+  }
+  const void* data = nullptr;
+  esp_partition_mmap_handle_t handle;
+  if (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &data, &handle) != ESP_OK) {
+    Serial.println("Error: Failed to map BM25 index partition");
+    return false;
+  }
+  mapHandle_ = handle;
+  mapped_ = true;
+  if (!begin((const uint8_t*)data, partition->size)) {
+    end();
+    return false;
+  }
+  Serial.printf("BM25 index: %u documents, %u terms, %u bytes\n", header_->docCount, header_->termCount, (unsigned)length_);
+  return true;
+}
+
+String getGPTAnswerBM25(DoubaoBM25Index& index, const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, int k) {
+  if (!validateConfig(apiKey, modelId, temp)) {
+    return ERROR_INVALID_INPUT;
+  }
+  if (inputText.length() == 0) {
+    Serial.println("Error: Input text is empty");
+    return ERROR_INVALID_INPUT;
+  }
+  int ids[DOUBAO_BM25_MAX_K];
+  unsigned long start = micros();
+  int found = index.search(inputText.c_str(), inputText.length(), k, ids);
+  Serial.printf("BM25 retrieved %d snippets in %lu us\n", found, micros() - start);
+  const char* snippets[DOUBAO_BM25_MAX_K];
+  size_t lengths[DOUBAO_BM25_MAX_K];
+  for (int i = 0; i < found; i++) {
+    snippets[i] = index.docText(ids[i], &lengths[i]);
+  }
+  return getGPTAnswerWithContext(inputText, apiKey, modelId, systemPrompt, temp, snippets, lengths, found);
+}
+#endif
@@ -0,0 +1,158 @@
+#ifndef DOUBAO_BM25_H
+#define DOUBAO_BM25_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define DOUBAO_BM25_MAGIC "DBM2"
+#define DOUBAO_BM25_VERSION 1
+#define DOUBAO_BM25_MAX_K 16
+#define DOUBAO_BM25_MAX_QUERY_TERMS 32
+
+/*
+ * BM25 index blob layout (little-endian, 4-byte aligned sections), built on the
+ * host by tools/bm25_index_builder.cpp and used in place from flash:
+ *
+ *   header        32 bytes, DoubaoBM25Header
+ *   terms         DoubaoBM25Term[termCount], sorted by hash
+ *   textOffsets   uint32[docCount + 1]
+ *   docLengths    uint16[docCount]       tokens per document
+ *   postings      per term: docFreq pairs of (varint doc id delta, varint term frequency)
+ *   text          document texts, UTF-8, not NUL-terminated
+ *
+ * Terms are FNV-1a hashes of lowercase ASCII words and of CJK character bigrams.
+ */
+struct DoubaoBM25Header {
+  char magic[4];
+  uint16_t version;
+  uint16_t reserved0;
+  uint32_t docCount;
+  uint32_t termCount;
+  float avgDocLength;
+  uint32_t postingsBytes;
+  uint32_t textBytes;
+  uint32_t reserved1;
+};
+
+struct DoubaoBM25Term {
+  uint32_t hash;
+  uint32_t postingsOffset;
+  uint32_t docFreq;
+};
+
+typedef void (*DoubaoTermCallback)(uint32_t termHash, void* context);
+
+/**
+ * Split UTF-8 text into BM25 terms (ASCII words, CJK bigrams)
+ * @param text Text to tokenize
+ * @param length Text length in bytes
+ * @param callback Called once per term occurrence
+ * @param context Passed through to callback
+ * @return Number of terms produced
+ */
+size_t bm25Tokenize(const char* text, size_t length, DoubaoTermCallback callback, void* context);
+
+/**
+ * Read-only BM25 search over an index blob
+ */
+class DoubaoBM25Index {
+public:
+  DoubaoBM25Index();
+  ~DoubaoBM25Index();
+
+  /**
+   * Use an index blob in place (flash, PROGMEM array or RAM)
+   * @param data Blob start, 4-byte aligned
+   * @param length Blob length in bytes
+   * @return true if the blob is a valid index, false otherwise
+   */
+  bool begin(const uint8_t* data, size_t length);
+
+#ifdef ARDUINO
+  /**
+   * Memory-map an index stored in a data partition
+   * @param partitionLabel Label of the data partition holding the blob
+   * @return true on success, false otherwise
+   */
+  bool beginPartition(const char* partitionLabel);
+#endif
+
+  /**
+   * Release the score buffer and any mapped partition
+   */
+  void end();
+
+  /**
+   * Set BM25 parameters
+   * @param k1 Term frequency saturation (default: 1.2)
+   * @param b Document length normalization (default: 0.75)
+   */
+  void setParameters(float k1, float b);
+
+  /**
+   * Rank documents against a query
+   * @param query UTF-8 query text
+   * @param queryLength Query length in bytes
+   * @param k Number of results wanted (max DOUBAO_BM25_MAX_K)
+   * @param ids Output document ids, best first
+   * @param scores Output BM25 scores (optional)
+   * @return Number of results written (documents with a positive score)
+   */
+  int search(const char* query, size_t queryLength, int k, int* ids, float* scores = nullptr);
+
+  /**
+   * Get the text of a document
+   * @param id Document id
+   * @param length Output text length in bytes
+   * @return Pointer into the blob, not NUL-terminated
+   */
+  const char* docText(int id, size_t* length) const;
+
+  /**
+   * @return Number of documents, 0 if no index is loaded
+   */
+  int size() const;
+
+  /**
+   * @return Size of the loaded blob in bytes
+   */
+  size_t indexBytes() const;
+
+private:
+  const DoubaoBM25Term* findTerm(uint32_t hash) const;
+
+  const DoubaoBM25Header* header_;
+  const DoubaoBM25Term* terms_;
+  const uint32_t* textOffsets_;
+  const uint16_t* docLengths_;
+  const uint8_t* postings_;
+  const char* text_;
+  size_t length_;
+  float* scores_;
+  std::atomic_flag scoresBusy_ = ATOMIC_FLAG_INIT;   // Set while a search uses scores_
+  float k1_;
+  float b_;
+  uint32_t mapHandle_;
+  bool mapped_;
+};
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "doubao_api.h"
+
+/**
+ * Get GPT answer with the top-k BM25 matches added to the system prompt
+ * @param index Loaded BM25 index
+ * @param inputText Text message to send
+ * @param apiKey API key for authentication
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role, without the reference material
+ * @param temp Temperature parameter
+ * @param k Number of snippets to include (default: 3)
+ * @return AI response or error code
+ */
+String getGPTAnswerBM25(DoubaoBM25Index& index, const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, int k = 3);
+#endif
+
+#endif // DOUBAO_BM25_H
@@ -0,0 +1,476 @@
+#ifndef DOUBAO_CLIENT_H
+#define DOUBAO_CLIENT_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+#include "doubao_config.h"
+#include "doubao_http.h"
+#include "doubao_policies.h"
+#include "doubao_schema.h"
+#include "doubao_tls.h"
+#include "doubao_tools.h"
+
+/*
+ * Transport policy: moves one request to the server and returns the raw body.
+ *
+ *   static const bool usesHeader;                    sends the config's header block, so it must be rendered
+ *   bool begin(const DoubaoClientConfig& config);   config outlives the transport's use of it
+ *   String post(const char* path, DoubaoStringView payload, DoubaoResponseMeta* meta);
+ *   template <class Sink>
+ *   String postTo(const char* path, DoubaoStringView payload, DoubaoResponseMeta* meta, Sink& body);
+ *                                                    body to a sink (see doubao_http.h); "" or error code
+ *   void stop();
+ */
+
+// Goes through sendApiRequest(), so endpoint and key pools apply; host/port are
+// taken from the endpoint pool (or DOUBAO_API_HOST) rather than the config
+class DoubaoSharedTransport {
+public:
+  // sendApiRequest() formats its own head with the key it was given
+  static const bool usesHeader = false;
+
+  bool begin(const DoubaoClientConfig& config) {
+    apiKey_ = config.apiKey();
+    return true;
+  }
+  String post(const char* path, DoubaoStringView payload, DoubaoResponseMeta* meta) {
+    return sendApiRequest(path, payload, apiKey_, meta);
+  }
+  // sendApiRequest() returns the whole body, so the sink receives it in one piece
+  template <class Sink>
+  String postTo(const char* path, DoubaoStringView payload, DoubaoResponseMeta* meta, Sink& body) {
+    String response = post(path, payload, meta);
+    if (isErrorResponse(response)) {
+      return response;
+    }
+    body.reserve(response.length());
+    body.append(response);
+    return "";
+  }
+  void stop() {
+  }
+
+private:
+  const char* apiKey_ = nullptr;
+};
+
+// Owns one kept-alive connection; each request sends the config's pre-rendered
+// header block (slots filled in) in one write, then the payload
+template <class ClientT = DoubaoTlsClient, class Clock = DoubaoClock, class Logger = DoubaoSerialLogger>
+class DoubaoKeepAliveTransport {
+public:
+  static const bool usesHeader = true;
+
+  bool begin(const DoubaoClientConfig& config) {
+    if (!config.hasHeader()) {
+      Logger::log("Error: Keep-alive transport needs an API key\n");
+      return false;
+    }
+    config_ = &config;
+    client_.stop();
+    return true;
+  }
+
+  String post(const char* path, DoubaoStringView payload, DoubaoResponseMeta* meta) {
+    String body;
+    DoubaoStringSink sink(body);
+    String error = postTo(path, payload, meta, sink);
+    return error.length() > 0 ? error : body;
+  }
+
+  // The body is passed to the sink while it is read from the socket
+  template <class Sink>
+  String postTo(const char* path, DoubaoStringView payload, DoubaoResponseMeta* meta, Sink& body) {
+    if (config_ == nullptr || strcmp(path, config_->path()) != 0) {
+      Logger::log("Error: Transport is configured for %s\n", config_ != nullptr ? config_->path() : "no path");
+      return ERROR_INVALID_INPUT;
+    }
+    bool reused = client_.connected();
+    for (int attempt = 0; attempt < 2; attempt++) {
+      if (!client_.connected() && !client_.connect(config_->host(), config_->port())) {
+        Logger::log("Failed to connect to %s\n", config_->host());
+        return ERROR_NETWORK;
+      }
+      unsigned long start = Clock::now();
+      bool keepAlive = false;
+      String error = ERROR_NETWORK;
+      if (config_->writeHead(client_, payload.length, meta->traceId) && doubaoWriteAll(client_, payload.data, payload.length)) {
+        error = doubaoReadResponseTo<ClientT, Clock, Logger, Sink>(client_, start, DOUBAO_RESPONSE_TIMEOUT_MS, &keepAlive, meta, body);
+      }
+      meta->latencyMs = Clock::now() - start;
+      if (!keepAlive || error.length() > 0) {
+        client_.stop();
+      }
+      // The server may have closed the idle connection; retry once on a fresh one, but only
+      // if no response started, so nothing reached the sink yet
+      if (error == ERROR_NETWORK && reused && attempt == 0 && meta->status == 0) {
+        reused = false;
+        continue;
+      }
+      return error;
+    }
+    return ERROR_NETWORK;
+  }
+
+  void stop() {
+    client_.stop();
+  }
+
+  ClientT& client() {
+    return client_;
+  }
+
+private:
+  ClientT client_;
+  const DoubaoClientConfig* config_ = nullptr;
+};
+
+// Document space for the filtered response beyond the kept strings
+#define DOUBAO_PARSE_OVERHEAD 256
+
+/**
+ * Chat client with compile-time policies
+ * @tparam Transport How requests reach the server (DoubaoSharedTransport, DoubaoKeepAliveTransport<...>)
+ * @tparam Allocator Memory for parsed JSON (DoubaoHeapAllocator, DoubaoPsramAllocator)
+ * @tparam Clock Time source for retry backoff (DoubaoClock)
+ * @tparam Logger Log sink (DoubaoSerialLogger, DoubaoNullLogger)
+ */
+template <class Transport = DoubaoSharedTransport, class Allocator = DoubaoHeapAllocator,
+          class Clock = DoubaoClock, class Logger = DoubaoSerialLogger>
+class DoubaoClient {
+public:
+  /**
+   * Validate the configuration once and, if the transport sends it, render the request header block
+   * @param apiKey API key (nullptr uses the key pool with DoubaoSharedTransport)
+   * @param modelId Model ID used by ask(); may be empty when only chat() is used
+   * @param host Server host (default: DOUBAO_API_HOST)
+   * @param port Server port (default: 443)
+   * @return true on success, false otherwise
+   */
+  bool begin(const char* apiKey, const String& modelId = "", const char* host = DOUBAO_API_HOST, uint16_t port = 443) {
+    ready_ = config_.begin(apiKey, modelId, host, port, DOUBAO_CHAT_PATH, Transport::usesHeader) && transport_.begin(config_);
+    return ready_;
+  }
+
+  /**
+   * Use a flash-resident header block built with DOUBAO_HEADER_TEMPLATE
+   * @param headerTemplate Header block, must stay valid while the client is used
+   * @param modelId Model ID used by ask()
+   * @param host Server host matching the template (default: DOUBAO_API_HOST)
+   * @param port Server port (default: 443)
+   * @return true on success, false if the transport does not send header blocks (DoubaoSharedTransport) or otherwise
+   */
+  bool beginStatic(const char* headerTemplate, const String& modelId = "", const char* host = DOUBAO_API_HOST, uint16_t port = 443) {
+    if (!Transport::usesHeader) {
+      // The key lives only in the template, which this transport never sends
+      Logger::log("Error: Transport needs an API key, use begin()\n");
+      ready_ = false;
+      return false;
+    }
+    ready_ = config_.beginStatic(headerTemplate, modelId, host, port) && transport_.begin(config_);
+    return ready_;
+  }
+
+  /**
+   * Ask a question, optionally with an image
+   * @param inputText Text message to send
+   * @param systemPrompt System prompt/role
+   * @param temp Temperature parameter
+   * @param base64Image Base64 encoded image (optional)
+   * @param imageFormat Image format, e.g. "jpg" (optional)
+   * @param maxRetries Maximum number of attempts (default: 3)
+   * @return AI response or error code
+   */
+  String ask(const String& inputText, const String& systemPrompt, float temp, const String& base64Image = "", const String& imageFormat = "", int maxRetries = 3) {
+    if (!ready_ || config_.modelId().length() == 0) {
+      Logger::log("Error: Model ID not set\n");
+      return ERROR_INVALID_INPUT;
+    }
+    if (temp < 0.0 || temp > 1.0) {
+      Logger::log("Error: Temperature parameter out of range (0–1)\n");
+      return ERROR_INVALID_INPUT;
+    }
+    if (inputText.length() == 0) {
+      Logger::log("Error: Input text is empty\n");
+      return ERROR_INVALID_INPUT;
+    }
+    return chatWithRetry(buildPayload(inputText, config_.modelId(), systemPrompt, temp, base64Image, imageFormat), maxRetries);
+  }
+
+  /**
+   * Ask for JSON matching a schema and decode it into a struct while the response arrives
+   * @param inputText Text message to send
+   * @param systemPrompt System prompt/role
+   * @param temp Temperature parameter
+   * @param schema Schema of out (doubaoSchemaOf<T>())
+   * @param out Struct to fill; zeroed first
+   * @param meta Optional output for status, timing and token usage
+   * @param maxRetries Maximum number of attempts (default: 3)
+   * @return "" on success, ERROR_SCHEMA if the answer did not match the schema, or another error code
+   */
+  String askStructured(const String& inputText, const String& systemPrompt, float temp, const DoubaoSchema& schema, void* out,
+                       DoubaoResponseMeta* meta = nullptr, int maxRetries = 3) {
+    DoubaoResponseMeta localMeta;
+    if (meta == nullptr) {
+      meta = &localMeta;
+    }
+    if (!ready_ || config_.modelId().length() == 0) {
+      Logger::log("Error: Model ID not set\n");
+      return ERROR_INVALID_INPUT;
+    }
+    if (inputText.length() == 0) {
+      Logger::log("Error: Input text is empty\n");
+      return ERROR_INVALID_INPUT;
+    }
+    if (out == nullptr || schema.count == 0) {
+      Logger::log("Error: No output struct\n");
+      return ERROR_INVALID_INPUT;
+    }
+    String payload = buildStructuredPayload(inputText, config_.modelId(), systemPrompt, temp, schema);
+    DoubaoStructDecoder decoder(schema, out);
+    String result;
+    for (int i = 0; i < maxRetries; i++) {
+      decoder.reset();
+      result = transport_.postTo(DOUBAO_CHAT_PATH, payload, meta, decoder);
+      if (result.length() == 0) {
+        if (meta->status == 429 || meta->status >= 500) {
+          result = ERROR_OVERLOADED;
+        } else if (meta->status != 200) {
+          return ERROR_INVALID_INPUT;
+        } else {
+          bool valid = decoder.finish();
+          decoder.fillMeta(meta);
+          return valid ? "" : ERROR_SCHEMA;
+        }
+      }
+      if (result != ERROR_NETWORK && result != ERROR_TIMEOUT && result != ERROR_OVERLOADED) {
+        return result;
+      }
+      if (i < maxRetries - 1) {
+        unsigned long delayTime = 1000UL * (i + 1);
+        Logger::log("Request failed, retrying after %lu ms\n", delayTime);
+        Clock::sleep(delayTime);
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Typed form of askStructured(); the schema comes from DOUBAO_SCHEMA(T, ...)
+   */
+  template <class T>
+  String askStruct(const String& inputText, const String& systemPrompt, float temp, T* out, DoubaoResponseMeta* meta = nullptr, int maxRetries = 3) {
+    return askStructured(inputText, systemPrompt, temp, doubaoSchemaOf<T>(), out, meta, maxRetries);
+  }
+
+  /**
+   * Ask a question and run the tools the model calls until it answers. Each
+   * turn's calls run through tools.run() (in parallel on its workers), and the
+   * results go back over the same transport, so a keep-alive transport reuses
+   * one connection for the whole loop.
+   * @param inputText Text message to send
+   * @param systemPrompt System prompt/role
+   * @param temp Temperature parameter
+   * @param tools Tools offered to the model
+   * @param stats Optional output for the wall-time breakdown
+   * @param maxRounds Maximum number of model turns (default: DOUBAO_TOOL_MAX_ROUNDS)
+   * @param maxRetries Maximum number of attempts per turn (default: 3)
+   * @return AI response or error code (ERROR_TOOL_ROUNDS if the model was still calling tools)
+   */
+  String askWithTools(const String& inputText, const String& systemPrompt, float temp, DoubaoToolSet& tools,
+                      DoubaoToolStats* stats = nullptr, int maxRounds = DOUBAO_TOOL_MAX_ROUNDS, int maxRetries = 3) {
+    DoubaoToolStats localStats;
+    if (stats == nullptr) {
+      stats = &localStats;
+    }
+    *stats = DoubaoToolStats();
+    unsigned long loopStart = Clock::now();
+    if (!ready_ || config_.modelId().length() == 0) {
+      Logger::log("Error: Model ID not set\n");
+      return ERROR_INVALID_INPUT;
+    }
+    if (inputText.length() == 0) {
+      Logger::log("Error: Input text is empty\n");
+      return ERROR_INVALID_INPUT;
+    }
+    if (tools.count() == 0) {
+      Logger::log("Error: No tools added\n");
+      return ERROR_INVALID_INPUT;
+    }
+    String messages = buildToolMessages(systemPrompt, inputText);
+    DoubaoToolCall calls[DOUBAO_TOOL_MAX_CALLS];
+    DoubaoToolCallDecoder decoder(calls, DOUBAO_TOOL_MAX_CALLS);
+    String result = ERROR_TOOL_ROUNDS;
+    for (int round = 0; round < maxRounds; round++) {
+      unsigned long mark = Clock::now();
+      String payload = buildToolPayload(messages, config_.modelId(), temp, tools);
+      stats->buildMs += Clock::now() - mark;
+      mark = Clock::now();
+      DoubaoResponseMeta meta;
+      String error;
+      for (int i = 0; i < maxRetries; i++) {
+        decoder.reset();
+        error = transport_.postTo(DOUBAO_CHAT_PATH, payload, &meta, decoder);
+        if (error.length() == 0 && (meta.status == 429 || meta.status >= 500)) {
+          error = ERROR_OVERLOADED;
+        }
+        if (error != ERROR_NETWORK && error != ERROR_TIMEOUT && error != ERROR_OVERLOADED) {
+          break;
+        }
+        if (i < maxRetries - 1) {
+          unsigned long delayTime = 1000UL * (i + 1);
+          Logger::log("Request failed, retrying after %lu ms\n", delayTime);
+          Clock::sleep(delayTime);
+        }
+      }
+      stats->requestMs += Clock::now() - mark;
+      stats->rounds++;
+      if (error.length() == 0 && meta.status != 200) {
+        error = ERROR_INVALID_INPUT;
+      } else if (error.length() == 0 && !decoder.finish()) {
+        error = ERROR_JSON_PARSE;
+      }
+      if (error.length() > 0) {
+        result = error;
+        break;
+      }
+      decoder.fillMeta(&meta);
+      stats->promptTokens += meta.promptTokens;
+      stats->completionTokens += meta.completionTokens;
+      if (decoder.count() == 0) {
+        result = decoder.content();
+        break;
+      }
+      Logger::log("Running %d tool calls\n", decoder.count());
+      mark = Clock::now();
+      stats->parallelCalls += tools.run(calls, decoder.count());
+      stats->toolMs += Clock::now() - mark;
+      stats->toolCalls += decoder.count();
+      for (int i = 0; i < decoder.count(); i++) {
+        stats->toolBusyMs += calls[i].durationMs;
+      }
+      appendToolResults(messages, calls, decoder.count());
+    }
+    stats->totalMs = Clock::now() - loopStart;
+    if (result == ERROR_TOOL_ROUNDS) {
+      Logger::log("Error: Still calling tools after %d rounds\n", maxRounds);
+    }
+    Logger::log("Tool loop: %lu ms total, %lu ms requests, %lu ms tools, %lu ms building payloads\n", stats->totalMs,
+                stats->requestMs, stats->toolMs, stats->buildMs);
+    return result;
+  }
+
+  /**
+   * Send a prepared chat completions payload once
+   * @param payload JSON payload
+   * @param meta Optional output for status, timing and token usage
+   * @return Response text or error code (ERROR_OVERLOADED for HTTP 429/5xx)
+   */
+  String chat(DoubaoStringView payload, DoubaoResponseMeta* meta = nullptr) {
+    DoubaoResponseMeta localMeta;
+    if (meta == nullptr) {
+      meta = &localMeta;
+    }
+    if (!ready_) {
+      Logger::log("Error: Client not configured\n");
+      return ERROR_INVALID_INPUT;
+    }
+    String response = transport_.post(DOUBAO_CHAT_PATH, payload, meta);
+    if (response == ERROR_NETWORK || response == ERROR_TIMEOUT) {
+      return response;
+    }
+    if (meta->status == 429 || meta->status >= 500) {
+      return ERROR_OVERLOADED;
+    }
+    return parse(response, meta);
+  }
+
+  /**
+   * Send a prepared chat completions payload, retrying network errors, timeouts and overload
+   * @param payload JSON payload
+   * @param maxRetries Maximum number of attempts (default: 3)
+   * @param meta Optional output for the last attempt
+   * @return Response text or error code
+   */
+  String chatWithRetry(DoubaoStringView payload, int maxRetries = 3, DoubaoResponseMeta* meta = nullptr) {
+    String result;
+    for (int i = 0; i < maxRetries; i++) {
+      Logger::log("Requesting %d/%d\n", i + 1, maxRetries);
+      result = chat(payload, meta);
+      if (result != ERROR_NETWORK && result != ERROR_TIMEOUT && result != ERROR_OVERLOADED) {
+        return result;
+      }
+      if (i < maxRetries - 1) {
+        unsigned long delayTime = 1000UL * (i + 1);
+        Logger::log("Request failed, retrying after %lu ms\n", delayTime);
+        Clock::sleep(delayTime);
+      }
+    }
+    return result;
+  }
+
+  /**
+   * Send a raw POST request through the transport
+   * @param path Request path
+   * @param payload JSON payload
+   * @param meta Optional output for status and timing
+   * @return Raw response body or error code
+   */
+  String send(const char* path, DoubaoStringView payload, DoubaoResponseMeta* meta = nullptr) {
+    DoubaoResponseMeta localMeta;
+    return transport_.post(path, payload, meta != nullptr ? meta : &localMeta);
+  }
+
+  /**
+   * Extract the answer from a chat completions response body
+   * @param response Raw response body
+   * @param meta Optional output for token usage and finish reason
+   * @return Message content or ERROR_JSON_PARSE
+   */
+  static String parse(const String& response, DoubaoResponseMeta* meta = nullptr) {
+    String outputText;
+    // Only these fields are materialized; everything else in the body is skipped
+    StaticJsonDocument<192> filter;
+    filter["choices"][0]["message"]["content"] = true;
+    filter["choices"][0]["finish_reason"] = true;
+    filter["usage"]["prompt_tokens"] = true;
+    filter["usage"]["completion_tokens"] = true;
+    // Sized from the body (Content-Length bytes, or the sum of the chunks): the kept
+    // strings are copied out of it, so it bounds them
+    BasicJsonDocument<Allocator> jsonDoc(response.length() + DOUBAO_PARSE_OVERHEAD);
+    DeserializationError error = deserializeJson(jsonDoc, response, DeserializationOption::Filter(filter));
+    if (error) {
+      Logger::log("JSON Parse Error: %s\n", error.c_str());
+      return ERROR_JSON_PARSE;
+    }
+    outputText = jsonDoc["choices"][0]["message"]["content"].template as<String>();
+    if (meta != nullptr) {
+      if (meta->heapFreeBefore > 0) {
+        doubaoSampleHeap(meta);
+      }
+      meta->promptTokens = jsonDoc["usage"]["prompt_tokens"].template as<int>();
+      meta->completionTokens = jsonDoc["usage"]["completion_tokens"].template as<int>();
+      meta->finishReason = jsonDoc["choices"][0]["finish_reason"].template as<String>();
+    }
+    Logger::log("JSON Parse Successful\n");
+    return outputText;
+  }
+
+  Transport& transport() {
+    return transport_;
+  }
+
+  const DoubaoClientConfig& config() const {
+    return config_;
+  }
+
+private:
+  DoubaoClientConfig config_;
+  Transport transport_;
+  bool ready_ = false;
+};
+
+// Instantiation behind getGPTAnswer() and the other free functions
+typedef DoubaoClient<> DoubaoDefaultClient;
+
+#endif // DOUBAO_CLIENT_H
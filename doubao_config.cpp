@@ -0,0 +1,137 @@
+#include "doubao_config.h"
+
+static const char LENGTH_HEADER[] = "\r\nContent-Length: ";
+static const char TRACE_HEADER[] = "\r\nX-Client-Request-Id: ";
+
+DoubaoClientConfig::DoubaoClientConfig()
+    : block_(nullptr), owned_(false), length_(0), lengthSlot_(0), traceSlot_(0), apiKey_(nullptr), port_(443), valid_(false) {
+}
+
+DoubaoClientConfig::~DoubaoClientConfig() {
+  release();
+}
+
+void DoubaoClientConfig::release() {
+  if (owned_) {
+    free((void*)block_);
+  }
+  block_ = nullptr;
+  owned_ = false;
+  length_ = 0;
+  valid_ = false;
+}
+
+bool DoubaoClientConfig::locateSlots(const char* block) {
+  const char* length = strstr(block, LENGTH_HEADER);
+  const char* trace = strstr(block, TRACE_HEADER);
+  if (length == nullptr || trace == nullptr) {
+    Serial.println("Error: Header block has no Content-Length or trace id slot");
+    return false;
+  }
+  lengthSlot_ = length - block + strlen(LENGTH_HEADER);
+  traceSlot_ = trace - block + strlen(TRACE_HEADER);
+  length_ = strlen(block);
+  if (lengthSlot_ + DOUBAO_LENGTH_SLOT > length_ || traceSlot_ + DOUBAO_TRACE_ID_LENGTH > length_) {
+    Serial.println("Error: Header block slots are truncated");
+    return false;
+  }
+  return true;
+}
+
+bool DoubaoClientConfig::begin(const char* apiKey, const String& modelId, const char* host, uint16_t port, const char* path, bool renderHeader) {
+  release();
+  if (!hasApiKey(apiKey)) {
+    Serial.println("Error: API key not set");
+    return false;
+  }
+  if (host == nullptr || strlen(host) == 0 || path == nullptr) {
+    Serial.println("Error: Host not set");
+    return false;
+  }
+  apiKey_ = apiKey;
+  modelId_ = modelId;
+  host_ = host;
+  port_ = port;
+  path_ = path;
+  if (renderHeader && apiKey != nullptr && strlen(apiKey) > 0) {
+    // Rendered once; only the slots change per request
+    int size = snprintf(nullptr, 0, DOUBAO_HEADER_TEMPLATE("%s", "%s", "%s"), path, host, apiKey) + 1;
+    char* block = (char*)malloc(size);
+    if (block == nullptr) {
+      Serial.println("Error: Out of memory");
+      return false;
+    }
+    snprintf(block, size, DOUBAO_HEADER_TEMPLATE("%s", "%s", "%s"), path, host, apiKey);
+    block_ = block;
+    owned_ = true;
+    if (!locateSlots(block_)) {
+      release();
+      return false;
+    }
+  }
+  valid_ = true;
+  return true;
+}
+
+bool DoubaoClientConfig::beginStatic(const char* headerTemplate, const String& modelId, const char* host, uint16_t port, const char* path) {
+  release();
+  if (headerTemplate == nullptr || !locateSlots(headerTemplate)) {
+    return false;
+  }
+  block_ = headerTemplate;
+  apiKey_ = nullptr;
+  modelId_ = modelId;
+  host_ = host;
+  port_ = port;
+  path_ = path;
+  valid_ = true;
+  return true;
+}
+
+size_t DoubaoClientConfig::render(char* out, size_t contentLength, char* traceId) const {
+  if (block_ == nullptr) {
+    return 0;
+  }
+  memcpy(out, block_, length_);
+  char digits[DOUBAO_LENGTH_SLOT + 1];
+  int n = snprintf(digits, sizeof(digits), "%u", (unsigned)contentLength);
+  if (n <= 0 || n > DOUBAO_LENGTH_SLOT) {
+    return 0;
+  }
+  memcpy(out + lengthSlot_, digits, n);
+  generateTraceId(traceId);
+  memcpy(out + traceSlot_, traceId, DOUBAO_TRACE_ID_LENGTH);
+  return length_;
+}
+
+bool DoubaoClientConfig::valid() const {
+  return valid_;
+}
+
+bool DoubaoClientConfig::hasHeader() const {
+  return block_ != nullptr;
+}
+
+size_t DoubaoClientConfig::headerLength() const {
+  return length_;
+}
+
+const char* DoubaoClientConfig::apiKey() const {
+  return apiKey_;
+}
+
+const String& DoubaoClientConfig::modelId() const {
+  return modelId_;
+}
+
+const char* DoubaoClientConfig::host() const {
+  return host_.c_str();
+}
+
+uint16_t DoubaoClientConfig::port() const {
+  return port_;
+}
+
+const char* DoubaoClientConfig::path() const {
+  return path_.c_str();
+}
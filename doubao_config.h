@@ -0,0 +1,114 @@
+#ifndef DOUBAO_CONFIG_H
+#define DOUBAO_CONFIG_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+
+// Digits reserved for Content-Length (payloads below 100 MB)
+#define DOUBAO_LENGTH_SLOT 8
+
+/*
+ * Header block template with reserved slots. The Content-Length slot is
+ * DOUBAO_LENGTH_SLOT spaces: the digits overwrite its start, and the
+ * remaining spaces are trailing whitespace, which HTTP ignores. The trace id
+ * slot is DOUBAO_TRACE_ID_LENGTH '#' characters. With a key known at compile
+ * time the whole block can stay in flash:
+ *
+ *   static const char header[] PROGMEM = DOUBAO_HEADER_TEMPLATE(DOUBAO_API_HOST, DOUBAO_CHAT_PATH, "my-api-key");
+ *   config.beginStatic(header, "doubao-1-5-pro-32k-250115");
+ */
+#define DOUBAO_HEADER_TEMPLATE(host, path, apiKey)                                                   \
+  "POST " path " HTTP/1.1\r\nHost: " host "\r\nContent-Type: application/json\r\nAuthorization: Bearer " apiKey \
+  "\r\nConnection: keep-alive\r\nContent-Length:         \r\nX-Client-Request-Id: ################\r\n\r\n"
+
+/**
+ * Validated client settings and the request header block rendered from them
+ */
+class DoubaoClientConfig {
+public:
+  DoubaoClientConfig();
+  ~DoubaoClientConfig();
+  DoubaoClientConfig(const DoubaoClientConfig&) = delete;
+  DoubaoClientConfig& operator=(const DoubaoClientConfig&) = delete;
+
+  /**
+   * Validate the settings and render the header block
+   * @param apiKey API key (nullptr or "" when a key pool is installed; no header block is rendered then)
+   * @param modelId Model ID (may be empty for raw payloads)
+   * @param host Server host (default: DOUBAO_API_HOST)
+   * @param port Server port (default: 443)
+   * @param path Request path (default: DOUBAO_CHAT_PATH)
+   * @param renderHeader Render the header block (default: true); false for transports that never send it
+   * @return true on success, false otherwise
+   */
+  bool begin(const char* apiKey, const String& modelId = "", const char* host = DOUBAO_API_HOST, uint16_t port = 443,
+             const char* path = DOUBAO_CHAT_PATH, bool renderHeader = true);
+
+  /**
+   * Use a header block built with DOUBAO_HEADER_TEMPLATE in place (not copied)
+   * @param headerTemplate Header block, must stay valid while the config is used
+   * @param modelId Model ID (may be empty for raw payloads)
+   * @param host Server host matching the template (default: DOUBAO_API_HOST)
+   * @param port Server port (default: 443)
+   * @param path Request path matching the template (default: DOUBAO_CHAT_PATH)
+   * @return true on success, false if the template has no slots
+   */
+  bool beginStatic(const char* headerTemplate, const String& modelId = "", const char* host = DOUBAO_API_HOST, uint16_t port = 443, const char* path = DOUBAO_CHAT_PATH);
+
+  /**
+   * Copy the header block and fill the slots
+   * @param out Output buffer of at least headerLength() bytes
+   * @param contentLength Payload length
+   * @param traceId Output trace id (DOUBAO_TRACE_ID_LENGTH + 1 bytes)
+   * @return Bytes written, 0 if no header block is available
+   */
+  size_t render(char* out, size_t contentLength, char* traceId) const;
+
+  /**
+   * Write the filled header block in one write
+   * @param client Connection
+   * @param contentLength Payload length
+   * @param traceId Output trace id (DOUBAO_TRACE_ID_LENGTH + 1 bytes)
+   * @return true on success, false otherwise
+   */
+  template <class ClientT>
+  bool writeHead(ClientT& client, size_t contentLength, char* traceId) const {
+    char stackBuffer[384];
+    char* buffer = length_ <= sizeof(stackBuffer) ? stackBuffer : (char*)malloc(length_);
+    if (buffer == nullptr) {
+      return false;
+    }
+    bool ok = render(buffer, contentLength, traceId) > 0 && client.write((const uint8_t*)buffer, length_) == length_;
+    if (buffer != stackBuffer) {
+      free(buffer);
+    }
+    return ok;
+  }
+
+  bool valid() const;
+  bool hasHeader() const;
+  size_t headerLength() const;
+  const char* apiKey() const;
+  const String& modelId() const;
+  const char* host() const;
+  uint16_t port() const;
+  const char* path() const;
+
+private:
+  bool locateSlots(const char* block);
+  void release();
+
+  const char* block_;
+  bool owned_;
+  size_t length_;
+  size_t lengthSlot_;
+  size_t traceSlot_;
+  const char* apiKey_;
+  String modelId_;
+  String host_;
+  String path_;
+  uint16_t port_;
+  bool valid_;
+};
+
+#endif // DOUBAO_CONFIG_H
@@ -0,0 +1,15 @@
+#include "doubao_coro.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+String doubaoChatResult(const String& result, DoubaoResponseMeta& meta) {
+  if (isErrorResponse(result)) {
+    return result;
+  }
+  if (meta.status == 429 || meta.status >= 500) {
+    return ERROR_OVERLOADED;
+  }
+  return parseChatResponse(result, &meta);
+}
+
+#endif // __cpp_impl_coroutine
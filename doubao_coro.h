@@ -0,0 +1,381 @@
+#ifndef DOUBAO_CORO_H
+#define DOUBAO_CORO_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+#include "doubao_client.h"
+#include "doubao_policies.h"
+
+/*
+ * Coroutine interface for multi-step flows (capture, ask, parse, ask again):
+ *
+ *   DoubaoFlow describe(DoubaoCoClient<DoubaoHttp2Connection>& ai) {
+ *     String objects = co_await ai.chat("List the objects in view");
+ *     String answer = co_await ai.chat("Which of these is dangerous? " + objects);
+ *   }
+ *
+ * A flow starts when it is called and runs until its first co_await. The
+ * request is then submitted to the client's connection and the flow is
+ * suspended. DoubaoCoClient::run() polls the connection and resumes each flow
+ * once its response is in, so any number of flows share the calling task.
+ * A suspended flow costs its coroutine frame (its locals and the pending
+ * request), allocated from the heap when the flow is called.
+ *
+ * Flows are resumed from run(), never from inside a connection callback, so a
+ * resumed flow may submit its next request right away.
+ *
+ * Connection policy: anything with the submit()/poll()/pending() members of
+ * DoubaoHttp2Connection. DoubaoHttp2Connection multiplexes the requests of all
+ * flows on one TLS connection. DoubaoQueuedConnection<Transport> sends them one
+ * at a time through a DoubaoClient transport policy and needs no HTTP/2. Its
+ * default, DoubaoSharedTransport, goes through sendApiRequest() and so the
+ * ESP32 network stack. A DoubaoKeepAliveTransport over a stand-in client runs
+ * flows against a local server instead (see doubao_impair.h).
+ *
+ * Only available with compilers that implement C++20 coroutines
+ * (e.g. -std=gnu++20 on GCC 10 and later).
+ */
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <utility>
+
+// Requests waiting in one DoubaoQueuedConnection
+#define DOUBAO_CORO_MAX_QUEUED 8
+
+/**
+ * Called when a request finishes (same signature as DoubaoHttp2Callback)
+ * @param result Raw response body or error code
+ * @param meta Status and timing of the request
+ * @param context User pointer given to submit()
+ */
+typedef void (*DoubaoRequestCallback)(const String& result, const DoubaoResponseMeta& meta, void* context);
+
+/**
+ * Return type of a flow coroutine. The flow's frame is freed when it returns.
+ */
+struct DoubaoFlow {
+  struct promise_type {
+    DoubaoFlow get_return_object() {
+      return DoubaoFlow();
+    }
+    std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+    std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+    void return_void() {
+    }
+    void unhandled_exception() {
+      abort();
+    }
+    // Frames come from malloc(); when it fails the flow does not start
+    static void* operator new(size_t size) noexcept {
+      return malloc(size);
+    }
+    static void operator delete(void* ptr) {
+      free(ptr);
+    }
+    static DoubaoFlow get_return_object_on_allocation_failure() {
+      Serial.println("Error: Out of memory for coroutine frame");
+      return DoubaoFlow();
+    }
+  };
+};
+
+/**
+ * Connection that sends queued requests one at a time through a transport policy.
+ * Each poll() blocks for one request; flows still interleave between requests.
+ * @tparam Transport DoubaoClient transport policy (DoubaoSharedTransport, DoubaoKeepAliveTransport<...>)
+ */
+template <class Transport = DoubaoSharedTransport>
+class DoubaoQueuedConnection {
+public:
+  /**
+   * @param host Server host, used by transports with their own connection (default: DOUBAO_API_HOST)
+   * @param port Server port (default: 443)
+   */
+  DoubaoQueuedConnection(const char* host = DOUBAO_API_HOST, uint16_t port = 443)
+      : host_(host), port_(port), head_(0), count_(0), nextId_(1) {
+  }
+
+  /**
+   * Queue a POST request
+   * @param path Request path (e.g. DOUBAO_CHAT_PATH)
+   * @param payload JSON payload to send
+   * @param apiKey API key for authentication; must stay valid until the request completes
+   * @param callback Receives the response
+   * @param context User pointer passed to callback
+   * @return Request id, -1 if the queue is full
+   */
+  int submit(const String& path, const String& payload, const char* apiKey, DoubaoRequestCallback callback, void* context = nullptr) {
+    if (count_ >= DOUBAO_CORO_MAX_QUEUED) {
+      Serial.println("Error: Request queue is full");
+      return -1;
+    }
+    Request& r = queue_[(head_ + count_) % DOUBAO_CORO_MAX_QUEUED];
+    r.path = path;
+    r.payload = payload;
+    r.apiKey = apiKey;
+    r.callback = callback;
+    r.context = context;
+    count_++;
+    return nextId_++;
+  }
+
+  /**
+   * Send the oldest queued request and wait for its response
+   * @param timeoutMs Unused, the request has DOUBAO_RESPONSE_TIMEOUT_MS
+   * @return Number of requests completed during this call (0 or 1)
+   */
+  int poll(unsigned long timeoutMs = 0) {
+    if (count_ == 0) {
+      return 0;
+    }
+    // Taken off the queue first, so the callback may submit again
+    Request& front = queue_[head_];
+    String path = std::move(front.path);
+    String payload = std::move(front.payload);
+    const char* apiKey = front.apiKey;
+    DoubaoRequestCallback callback = front.callback;
+    void* context = front.context;
+    front.path = "";
+    front.payload = "";
+    head_ = (head_ + 1) % DOUBAO_CORO_MAX_QUEUED;
+    count_--;
+    DoubaoResponseMeta meta;
+    String result;
+    // The config carries key and path; it is only rebuilt when a request changes them
+    if ((configured_ && config_.apiKey() == apiKey && path == config_.path()) ||
+        (config_.begin(apiKey, "", host_.c_str(), port_, path.c_str(), Transport::usesHeader) && transport_.begin(config_))) {
+      configured_ = true;
+      result = transport_.post(path.c_str(), payload, &meta);
+    } else {
+      configured_ = false;
+      result = ERROR_INVALID_INPUT;
+    }
+    if (callback != nullptr) {
+      callback(result, meta, context);
+    }
+    return 1;
+  }
+
+  /**
+   * @return Number of queued requests
+   */
+  int pending() const {
+    return count_;
+  }
+
+  /**
+   * @return The transport, e.g. to reach a stand-in client
+   */
+  Transport& transport() {
+    return transport_;
+  }
+
+private:
+  struct Request {
+    String path;
+    String payload;
+    const char* apiKey;
+    DoubaoRequestCallback callback;
+    void* context;
+  };
+
+  String host_;
+  uint16_t port_;
+  Transport transport_;
+  DoubaoClientConfig config_;
+  bool configured_ = false;
+  Request queue_[DOUBAO_CORO_MAX_QUEUED];
+  int head_;
+  int count_;
+  int nextId_;
+};
+
+/**
+ * Turn a raw chat completions response into the answer, as getGPTAnswer() does
+ * @param result Raw response body or error code
+ * @param meta Status of the request; usage and finish_reason are filled in
+ * @return AI response or error code
+ */
+String doubaoChatResult(const String& result, DoubaoResponseMeta& meta);
+
+/**
+ * Chat client whose requests are awaited from flows
+ * @tparam Connection Connection policy (DoubaoHttp2Connection, DoubaoQueuedConnection<...>)
+ */
+template <class Connection>
+class DoubaoCoClient {
+public:
+  // Result of chat() and post(); co_await it for the answer or error code
+  class Awaitable {
+  public:
+    Awaitable(DoubaoCoClient* client, const char* path, const String& payload, bool chat, DoubaoResponseMeta* meta)
+        : Awaitable(client, path, String(payload), chat, meta) {
+    }
+    // Payloads built by chat() are moved in rather than copied
+    Awaitable(DoubaoCoClient* client, const char* path, String&& payload, bool chat, DoubaoResponseMeta* meta)
+        : client_(client), path_(path), payload_(std::move(payload)), chat_(chat), done_(false), meta_(meta), next_(nullptr) {
+    }
+    Awaitable(const Awaitable&) = delete;
+    Awaitable& operator=(const Awaitable&) = delete;
+
+    bool await_ready() const noexcept {
+      return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      handle_ = handle;
+      client_->waiting_++;
+      // A connection may fail the request inside submit(); it is then already queued for resumption
+      int id = client_->connection_.submit(path_, payload_, client_->apiKey_, onDone, this);
+      // The connection holds its own copy now
+      payload_ = String();
+      if (id >= 0 || done_) {
+        return true;
+      }
+      client_->waiting_--;
+      result_ = ERROR_NETWORK;
+      return false;
+    }
+
+    String await_resume() {
+      return std::move(result_);
+    }
+
+  private:
+    static void onDone(const String& result, const DoubaoResponseMeta& meta, void* context) {
+      Awaitable* self = (Awaitable*)context;
+      DoubaoResponseMeta localMeta = meta;
+      self->result_ = self->chat_ ? doubaoChatResult(result, localMeta) : result;
+      if (self->meta_ != nullptr) {
+        *self->meta_ = localMeta;
+      }
+      self->done_ = true;
+      self->client_->ready(self);
+    }
+
+    DoubaoCoClient* client_;
+    const char* path_;
+    String payload_;
+    bool chat_;
+    bool done_;
+    DoubaoResponseMeta* meta_;
+    String result_;
+    std::coroutine_handle<> handle_;
+    Awaitable* next_;     // Ready list of the client
+
+    friend class DoubaoCoClient;
+  };
+
+  /**
+   * @param connection Connection carrying the requests; must outlive the client
+   * @param apiKey API key for authentication; must stay valid
+   * @param modelId Model ID to use
+   * @param systemPrompt Default system prompt/role
+   * @param temp Default temperature parameter
+   */
+  DoubaoCoClient(Connection& connection, const char* apiKey, const String& modelId, const String& systemPrompt = "You are a helpful assistant", float temp = 0.7)
+      : connection_(connection), apiKey_(apiKey), modelId_(modelId), systemPrompt_(systemPrompt), temp_(temp),
+        readyHead_(nullptr), readyTail_(nullptr), waiting_(0) {
+  }
+
+  /**
+   * Ask a question with the default system prompt and temperature
+   * @param inputText Text message to send
+   * @param meta Optional output for status, timing and usage; must outlive the co_await
+   * @return Awaitable giving the AI response or error code
+   */
+  Awaitable chat(const String& inputText, DoubaoResponseMeta* meta = nullptr) {
+    return chat(inputText, systemPrompt_, temp_, meta);
+  }
+
+  /**
+   * Ask a question
+   * @param inputText Text message to send
+   * @param systemPrompt System prompt/role
+   * @param temp Temperature parameter
+   * @param meta Optional output for status, timing and usage; must outlive the co_await
+   * @return Awaitable giving the AI response or error code
+   */
+  Awaitable chat(const String& inputText, const String& systemPrompt, float temp, DoubaoResponseMeta* meta = nullptr) {
+    return Awaitable(this, DOUBAO_CHAT_PATH, buildPayload(inputText, modelId_, systemPrompt, temp), true, meta);
+  }
+
+  /**
+   * Send a prepared payload
+   * @param path Request path; must stay valid until the request completes
+   * @param payload JSON payload to send
+   * @param meta Optional output for status and timing; must outlive the co_await
+   * @return Awaitable giving the raw response body or error code
+   */
+  Awaitable post(const char* path, const String& payload, DoubaoResponseMeta* meta = nullptr) {
+    return Awaitable(this, path, payload, false, meta);
+  }
+
+  /**
+   * Poll the connection and resume flows as their responses arrive
+   * @param timeoutMs Longest time to run
+   * @return true once no flow is waiting, false on timeout (flows stay suspended)
+   */
+  bool run(unsigned long timeoutMs = DOUBAO_RESPONSE_TIMEOUT_MS) {
+    unsigned long start = DoubaoClock::now();
+    while (true) {
+      resumeReady();
+      if (waiting_ == 0) {
+        return true;
+      }
+      unsigned long elapsed = DoubaoClock::now() - start;
+      if (elapsed >= timeoutMs) {
+        return false;
+      }
+      connection_.poll(min(timeoutMs - elapsed, 100UL));
+    }
+  }
+
+  /**
+   * @return Number of flows waiting for a response
+   */
+  int waiting() const {
+    return waiting_;
+  }
+
+private:
+  void ready(Awaitable* awaitable) {
+    waiting_--;
+    if (readyTail_ != nullptr) {
+      readyTail_->next_ = awaitable;
+    } else {
+      readyHead_ = awaitable;
+    }
+    readyTail_ = awaitable;
+  }
+
+  void resumeReady() {
+    while (readyHead_ != nullptr) {
+      Awaitable* awaitable = readyHead_;
+      readyHead_ = awaitable->next_;
+      if (readyHead_ == nullptr) {
+        readyTail_ = nullptr;
+      }
+      // May submit further requests, or finish the flow and free the awaitable
+      awaitable->handle_.resume();
+    }
+  }
+
+  Connection& connection_;
+  const char* apiKey_;
+  String modelId_;
+  String systemPrompt_;
+  float temp_;
+  Awaitable* readyHead_;
+  Awaitable* readyTail_;
+  int waiting_;   // Submitted, not yet completed
+};
+
+#endif // __cpp_impl_coroutine
+
+#endif // DOUBAO_CORO_H
@@ -0,0 +1,97 @@
+#include "doubao_embeddings.h"
+#include "doubao_json_path.h"
+
+int getEmbedding(const String& inputText, const char* apiKey, const String& modelId, float* out, int maxDim) {
+  if (!validateConfig(apiKey, modelId, 0.0) || out == nullptr || maxDim <= 0) {
+    return 0;
+  }
+  if (inputText.length() == 0) {
+    Serial.println("Error: Input text is empty");
+    return 0;
+  }
+  String payload;
+  payload.reserve(inputText.length() + modelId.length() + 64);
+  payload = "{";
+  payload += "\"model\":\"" + modelId + "\",";
+  payload += "\"input\":[\"" + jsonEscape(inputText) + "\"],";
+  payload += "\"encoding_format\":\"float\"";
+  payload += "}";
+  String response = sendApiRequest(DOUBAO_EMBEDDINGS_PATH, payload, apiKey);
+  if (isErrorResponse(response)) {
+    return 0;
+  }
+  // Locate the vector by path, then scan the float array directly instead of
+  // building a DOM of thousands of values
+  DoubaoJsonExtractor extractor;
+  int field = extractor.add("/data/0/embedding");
+  DoubaoStringView array;
+  if (extractor.extract(response) && extractor.has(field)) {
+    array = extractor.raw(field);
+  }
+  if (array.length < 2 || array.data[0] != '[') {
+    Serial.println("Error: No embedding in response");
+    return 0;
+  }
+  const char* p = array.data + 1;
+  const char* end = array.data + array.length - 1;   // The closing ']'
+  int dim = 0;
+  while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+    p++;
+  }
+  while (p < end) {
+    if (dim == maxDim) {
+      // A truncated vector would be compared with vectors of another model size
+      Serial.printf("Error: Embedding has more than %d dimensions\n", maxDim);
+      return 0;
+    }
+    char* next = nullptr;
+    float value = strtof(p, &next);
+    if (next == p || next > end) {
+      Serial.println("Error: Malformed embedding");
+      return 0;
+    }
+    out[dim++] = value;
+    p = next;
+    while (p < end && (*p == ',' || *p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+      p++;
+    }
+  }
+  return dim;
+}
+
+float quantizeEmbedding(const float* in, int dim, int8_t* out) {
+  float norm = 0.0f;
+  float maxAbs = 0.0f;
+  for (int i = 0; i < dim; i++) {
+    norm += in[i] * in[i];
+    maxAbs = max(maxAbs, fabsf(in[i]));
+  }
+  if (norm <= 0.0f || maxAbs <= 0.0f) {
+    memset(out, 0, dim);
+    return 0.0f;
+  }
+  norm = sqrtf(norm);
+  // Largest component maps to 127 after normalization
+  float scale = 127.0f * norm / maxAbs;
+  for (int i = 0; i < dim; i++) {
+    out[i] = (int8_t)lroundf(in[i] / norm * scale);
+  }
+  return scale;
+}
+
+int32_t dotProductInt8(const int8_t* a, const int8_t* b, int dim) {
+  // Four independent accumulators keep the multiply-add pipeline busy and let
+  // compilers with vector units auto-vectorize the main loop.
+  int32_t sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+  int i = 0;
+  for (; i + 4 <= dim; i += 4) {
+    sum0 += (int16_t)a[i] * b[i];
+    sum1 += (int16_t)a[i + 1] * b[i + 1];
+    sum2 += (int16_t)a[i + 2] * b[i + 2];
+    sum3 += (int16_t)a[i + 3] * b[i + 3];
+  }
+  for (; i < dim; i++) {
+    sum0 += (int16_t)a[i] * b[i];
+  }
+  return sum0 + sum1 + sum2 + sum3;
+}
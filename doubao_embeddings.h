@@ -0,0 +1,36 @@
+#ifndef DOUBAO_EMBEDDINGS_H
+#define DOUBAO_EMBEDDINGS_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+
+/**
+ * Get the embedding vector of a text from the Ark embeddings endpoint
+ * @param inputText Text to embed
+ * @param apiKey API key for authentication
+ * @param modelId Embedding model ID to use
+ * @param out Output buffer for the vector
+ * @param maxDim Capacity of out
+ * @return Number of dimensions written, 0 on failure or if the vector has more than maxDim dimensions
+ */
+int getEmbedding(const String& inputText, const char* apiKey, const String& modelId, float* out, int maxDim);
+
+/**
+ * Normalize a vector to unit length and quantize it to int8
+ * @param in Float vector
+ * @param dim Number of dimensions
+ * @param out Quantized output, dim entries
+ * @return Scale factor so that out[i] / scale approximates the normalized in[i] (0 for a zero vector)
+ */
+float quantizeEmbedding(const float* in, int dim, int8_t* out);
+
+/**
+ * Dot product of two int8 vectors
+ * @param a First vector
+ * @param b Second vector
+ * @param dim Number of dimensions
+ * @return Integer dot product
+ */
+int32_t dotProductInt8(const int8_t* a, const int8_t* b, int dim);
+
+#endif // DOUBAO_EMBEDDINGS_H
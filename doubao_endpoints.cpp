@@ -0,0 +1,225 @@
+#include "doubao_endpoints.h"
+#include "doubao_policies.h"
+
+// Weight of the newest sample in the smoothed latencies
+static const float LATENCY_ALPHA = 0.3f;
+
+static void smooth(float& value, float sample) {
+  value = value == 0 ? sample : value + LATENCY_ALPHA * (sample - value);
+}
+
+static bool isFailure(const String& response, const DoubaoResponseMeta* meta) {
+  return response == ERROR_NETWORK || response == ERROR_TIMEOUT || meta->status == 429 || meta->status >= 500;
+}
+
+DoubaoEndpointPool::DoubaoEndpointPool() : count_(0) {
+  for (int i = 0; i < DOUBAO_MAX_ENDPOINTS; i++) {
+    connectionLocks_[i] = nullptr;
+  }
+}
+
+int DoubaoEndpointPool::add(const char* host, uint16_t port, bool tls, const char* pathPrefix) {
+  if (count_ >= DOUBAO_MAX_ENDPOINTS || host == nullptr || strlen(host) == 0) {
+    Serial.println("Error: Cannot add endpoint");
+    return -1;
+  }
+  if (connectionLocks_[count_] == nullptr) {
+    connectionLocks_[count_] = xSemaphoreCreateMutex();
+  }
+  DoubaoEndpoint& e = endpoints_[count_];
+  e.host = host;
+  e.port = port;
+  e.tls = tls;
+  e.pathPrefix = pathPrefix != nullptr ? pathPrefix : "";
+  e.rttMs = 0;
+  e.ttfbMs = 0;
+  e.requests = 0;
+  e.failures = 0;
+  e.consecutiveFailures = 0;
+  e.downUntil = 0;
+  return count_++;
+}
+
+int DoubaoEndpointPool::size() const {
+  return count_;
+}
+
+DoubaoEndpoint DoubaoEndpointPool::endpoint(int index) const {
+  // host and pathPrefix never change after add(), so only the numbers need the lock
+  DoubaoEndpoint e = endpoints_[index];
+  DoubaoSpinLock lock(lock_);
+  e.rttMs = endpoints_[index].rttMs;
+  e.ttfbMs = endpoints_[index].ttfbMs;
+  e.requests = endpoints_[index].requests;
+  e.failures = endpoints_[index].failures;
+  e.consecutiveFailures = endpoints_[index].consecutiveFailures;
+  e.downUntil = endpoints_[index].downUntil;
+  return e;
+}
+
+Client& DoubaoEndpointPool::client(int index) {
+  if (endpoints_[index].tls) {
+    return secureClients_[index];
+  }
+  return plainClients_[index];
+}
+
+// Caller holds lock_
+bool DoubaoEndpointPool::healthy(int index) const {
+  const DoubaoEndpoint& e = endpoints_[index];
+  return e.downUntil == 0 || (long)(DoubaoClock::now() - e.downUntil) >= 0;
+}
+
+// Returns the backoff; the caller closes its connection and logs
+unsigned long DoubaoEndpointPool::markFailure(int index) {
+  DoubaoSpinLock lock(lock_);
+  DoubaoEndpoint& e = endpoints_[index];
+  e.failures++;
+  if (e.consecutiveFailures < 16) {
+    e.consecutiveFailures++;
+  }
+  unsigned long backoff = (unsigned long)DOUBAO_ENDPOINT_BACKOFF_MS << min(e.consecutiveFailures - 1, 5);
+  backoff = min(backoff, (unsigned long)DOUBAO_ENDPOINT_MAX_BACKOFF_MS);
+  e.downUntil = DoubaoClock::now() + backoff;
+  if (e.downUntil == 0) {
+    e.downUntil = 1;
+  }
+  return backoff;
+}
+
+int DoubaoEndpointPool::probe() {
+  int reachable = 0;
+  for (int i = 0; i < count_; i++) {
+    // A connection busy with a request is reachable by definition
+    if (xSemaphoreTake(connectionLocks_[i], 0) != pdTRUE) {
+      reachable++;
+      continue;
+    }
+    Client& c = client(i);
+    c.stop();
+    unsigned long start = DoubaoClock::now();
+    if (c.connect(endpoints_[i].host.c_str(), endpoints_[i].port)) {
+      unsigned long rtt = DoubaoClock::now() - start;
+      DoubaoSpinLock lock(lock_);
+      smooth(endpoints_[i].rttMs, rtt);
+      endpoints_[i].consecutiveFailures = 0;
+      endpoints_[i].downUntil = 0;
+      reachable++;
+    } else {
+      c.stop();
+      Serial.printf("Endpoint %s down for %lu ms\n", endpoints_[i].host.c_str(), markFailure(i));
+    }
+    xSemaphoreGive(connectionLocks_[i]);
+  }
+  return reachable;
+}
+
+int DoubaoEndpointPool::select() const {
+  DoubaoSpinLock lock(lock_);
+  int best = -1;
+  bool bestMeasured = false;
+  float bestScore = 0;
+  for (int i = 0; i < count_; i++) {
+    if (!healthy(i)) {
+      continue;
+    }
+    // Exploration: endpoints without a TTFB sample go first (lowest connect RTT first)
+    // until one request has completed on each; measured endpoints compete on TTFB only.
+    // RTT and TTFB are never compared with each other, as TTFB includes generation time.
+    const DoubaoEndpoint& e = endpoints_[i];
+    bool measured = e.ttfbMs > 0;
+    float score = measured ? e.ttfbMs : e.rttMs;
+    if (best < 0 || (!measured && bestMeasured) || (measured == bestMeasured && score < bestScore)) {
+      best = i;
+      bestMeasured = measured;
+      bestScore = score;
+    }
+  }
+  if (best >= 0 || count_ == 0) {
+    return best;
+  }
+  // Everything is down: use the endpoint that comes back first
+  best = 0;
+  for (int i = 1; i < count_; i++) {
+    if ((long)(endpoints_[i].downUntil - endpoints_[best].downUntil) < 0) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+String DoubaoEndpointPool::send(int index, const String& path, DoubaoStringView payload, const char* apiKey, DoubaoResponseMeta* meta) {
+  const DoubaoEndpoint& e = endpoints_[index];
+  if (xSemaphoreTake(connectionLocks_[index], 0) == pdTRUE) {
+    // Called with the concrete client so reads wait on its socket
+    String response = e.tls ? sendApiRequestVia(secureClients_[index], e.host.c_str(), e.port, e.pathPrefix + path, payload, apiKey, true, meta)
+                            : sendApiRequestVia(plainClients_[index], e.host.c_str(), e.port, e.pathPrefix + path, payload, apiKey, true, meta);
+    if (isFailure(response, meta)) {
+      client(index).stop();
+    }
+    xSemaphoreGive(connectionLocks_[index]);
+    return response;
+  }
+  // Another task is using the kept-alive connection: use a fresh one instead of waiting
+  if (e.tls) {
+    DoubaoTlsClient secure;
+    return sendApiRequestVia(secure, e.host.c_str(), e.port, e.pathPrefix + path, payload, apiKey, false, meta);
+  }
+  WiFiClient plain;
+  return sendApiRequestVia(plain, e.host.c_str(), e.port, e.pathPrefix + path, payload, apiKey, false, meta);
+}
+
+String DoubaoEndpointPool::request(const String& path, DoubaoStringView payload, const char* apiKey, DoubaoResponseMeta* meta) {
+  DoubaoResponseMeta localMeta;
+  if (meta == nullptr) {
+    meta = &localMeta;
+  }
+  if (count_ == 0) {
+    Serial.println("Error: No endpoints configured");
+    return ERROR_NETWORK;
+  }
+  String response = ERROR_NETWORK;
+  bool tried[DOUBAO_MAX_ENDPOINTS] = {false};
+  for (int attempt = 0; attempt < count_; attempt++) {
+    int index = select();
+    if (tried[index]) {
+      // select() only repeats an endpoint when the rest are down; pick any untried one
+      for (index = 0; index < count_ && tried[index]; index++) {
+      }
+    }
+    tried[index] = true;
+    {
+      DoubaoSpinLock lock(lock_);
+      endpoints_[index].requests++;
+    }
+    response = send(index, path, payload, apiKey, meta);
+    if (response == ERROR_OVERLOADED && meta->status == 0) {
+      // Every pooled API key is out of quota: no request was sent, so the
+      // endpoint is fine and another one would not help
+      return response;
+    }
+    if (!isFailure(response, meta)) {
+      DoubaoSpinLock lock(lock_);
+      DoubaoEndpoint& e = endpoints_[index];
+      // At least 1 ms, so a measured endpoint never looks unexplored again
+      smooth(e.ttfbMs, max((float)meta->ttfbMs, 1.0f));
+      e.consecutiveFailures = 0;
+      e.downUntil = 0;
+      return response;
+    }
+    Serial.printf("Endpoint %s down for %lu ms\n", endpoints_[index].host.c_str(), markFailure(index));
+    if (attempt + 1 < count_) {
+      Serial.println("Failing over to next endpoint");
+    }
+  }
+  return response;
+}
+
+void DoubaoEndpointPool::printStatus(Print& out) const {
+  for (int i = 0; i < count_; i++) {
+    DoubaoEndpoint e = endpoint(i);
+    bool up = e.downUntil == 0 || (long)(DoubaoClock::now() - e.downUntil) >= 0;
+    out.printf("%s:%u%s rtt %.0f ms, ttfb %.0f ms, %u/%u failed%s\n", e.host.c_str(), e.port, e.tls ? "" : " (plain)",
+               e.rttMs, e.ttfbMs, (unsigned)e.failures, (unsigned)e.requests, up ? "" : ", down");
+  }
+}
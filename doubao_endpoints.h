@@ -0,0 +1,115 @@
+#ifndef DOUBAO_ENDPOINTS_H
+#define DOUBAO_ENDPOINTS_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include "doubao_api.h"
+#include "doubao_lock.h"
+#include "doubao_tls.h"
+
+#define DOUBAO_MAX_ENDPOINTS 4
+
+// How long an endpoint is skipped after a failure, doubled per consecutive failure
+#define DOUBAO_ENDPOINT_BACKOFF_MS 5000
+#define DOUBAO_ENDPOINT_MAX_BACKOFF_MS 120000
+
+/*
+ * Each endpoint owns its connection: a TLS client for remote hosts or a plain
+ * client for a local proxy. The connection is kept alive between requests and
+ * the TLS session is resumed on reconnect, both per endpoint; the read-only
+ * TLS config (CA chain, pins) is shared. Endpoints are ranked by smoothed
+ * time to first byte. An endpoint without a TTFB sample is explored first
+ * (the lowest connect RTT among such endpoints wins) until one request has
+ * completed on it; RTT never competes with TTFB. Endpoints that failed are
+ * skipped until their backoff expires.
+ *
+ * The pool may be shared by several tasks. Each endpoint's kept-alive
+ * connection is used by one request at a time. A request that finds it busy
+ * opens a short-lived connection of its own rather than waiting. Statistics
+ * are updated under a spinlock.
+ */
+struct DoubaoEndpoint {
+  String host;
+  uint16_t port;
+  bool tls;
+  String pathPrefix;     // Prepended to the request path (e.g. "/ark" behind a proxy)
+  float rttMs;           // Smoothed connect time, 0 until measured
+  float ttfbMs;          // Smoothed time to first byte, 0 until measured
+  uint32_t requests;
+  uint32_t failures;
+  uint8_t consecutiveFailures;
+  unsigned long downUntil;
+};
+
+/**
+ * Set of API endpoints with latency-based selection and failover
+ */
+class DoubaoEndpointPool {
+public:
+  DoubaoEndpointPool();
+
+  /**
+   * Add an endpoint
+   * @param host Host name or IP address
+   * @param port Port (default: 443)
+   * @param tls Use TLS (default: true); false for a local plain HTTP proxy
+   * @param pathPrefix Prefix added to request paths (default: "")
+   * @return Endpoint index, -1 if the pool is full
+   */
+  int add(const char* host, uint16_t port = 443, bool tls = true, const char* pathPrefix = "");
+
+  /**
+   * Measure connect RTT of every endpoint; the connections stay open for the next request
+   * @return Number of reachable endpoints
+   */
+  int probe();
+
+  /**
+   * Pick the endpoint for the next request
+   * @return Endpoint index, -1 if the pool is empty
+   */
+  int select() const;
+
+  /**
+   * Send a POST request to the best endpoint, failing over to the others on
+   * network errors, timeouts and HTTP 429/5xx
+   * @param path Request path (e.g. DOUBAO_CHAT_PATH)
+   * @param payload JSON payload to send
+   * @param apiKey API key for authentication
+   * @param meta Optional output for status and timing
+   * @return Raw response body or error code
+   */
+  String request(const String& path, DoubaoStringView payload, const char* apiKey, DoubaoResponseMeta* meta = nullptr);
+
+  /**
+   * @param index Endpoint index
+   * @return Snapshot of the endpoint state
+   */
+  DoubaoEndpoint endpoint(int index) const;
+
+  /**
+   * @return Number of endpoints
+   */
+  int size() const;
+
+  /**
+   * Print latency and health of every endpoint
+   * @param out Output stream (e.g. Serial)
+   */
+  void printStatus(Print& out) const;
+
+private:
+  Client& client(int index);
+  bool healthy(int index) const;
+  unsigned long markFailure(int index);
+  String send(int index, const String& path, DoubaoStringView payload, const char* apiKey, DoubaoResponseMeta* meta);
+
+  DoubaoEndpoint endpoints_[DOUBAO_MAX_ENDPOINTS];
+  DoubaoTlsClient secureClients_[DOUBAO_MAX_ENDPOINTS];
+  WiFiClient plainClients_[DOUBAO_MAX_ENDPOINTS];
+  SemaphoreHandle_t connectionLocks_[DOUBAO_MAX_ENDPOINTS];   // Held while a request uses the kept-alive connection
+  int count_;
+  mutable portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;  // Guards the numeric fields of endpoints_
+};
+
+#endif // DOUBAO_ENDPOINTS_H
@@ -0,0 +1,220 @@
+#ifndef DOUBAO_HTTP_H
+#define DOUBAO_HTTP_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+#include "doubao_policies.h"
+#include "doubao_view.h"
+
+/*
+ * HTTP/1.1 framing shared by the request functions and DoubaoClient
+ * transports. Templated on the connection type so a concrete (final) client
+ * is called directly instead of through Client's virtual functions.
+ *
+ * Reads never poll on a timer: when nothing is buffered the task blocks in
+ * Clock::waitReadable() on the connection's socket until bytes arrive.
+ *
+ * Response bodies are written to a sink: any type with
+ *   void reserve(size_t size);
+ *   bool append(DoubaoStringView data);
+ *   size_t length() const;
+ * DoubaoStringSink collects into a String; DoubaoBuffer is a sink as well.
+ */
+
+// Body sink appending to a String
+struct DoubaoStringSink {
+  explicit DoubaoStringSink(String& target) : body(target) {
+  }
+  void reserve(size_t size) {
+    body.reserve(size);
+  }
+  bool append(DoubaoStringView data) {
+    return body.concat(data.data, data.length);
+  }
+  size_t length() const {
+    return body.length();
+  }
+  String& body;
+};
+
+// Record the current free heap if it is the lowest seen during the request
+inline void doubaoSampleHeap(DoubaoResponseMeta* meta) {
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (freeHeap < meta->heapMinFree) {
+    meta->heapMinFree = freeHeap;
+  }
+}
+
+// Block until the connection has data or is closed, at most until deadline
+template <class ClientT, class Clock>
+void doubaoWaitReadable(ClientT& client, unsigned long deadline) {
+  unsigned long now = Clock::now();
+  if (now < deadline) {
+    Clock::waitReadable(doubaoSocketOf(client), deadline - now);
+  }
+}
+
+template <class ClientT, class Clock>
+bool doubaoReadLine(ClientT& client, String& line, unsigned long deadline) {
+  line = "";
+  while (Clock::now() < deadline) {
+    if (client.available()) {
+      char c = (char)client.read();
+      if (c == '\n') {
+        line.trim();
+        return true;
+      }
+      line += c;
+    } else if (!client.connected()) {
+      return line.length() > 0;
+    } else {
+      doubaoWaitReadable<ClientT, Clock>(client, deadline);
+    }
+  }
+  return false;
+}
+
+template <class ClientT, class Clock, class Sink>
+bool doubaoReadBody(ClientT& client, Sink& body, size_t length, unsigned long deadline) {
+  char buf[512];
+  while (length > 0 && Clock::now() < deadline) {
+    int available = client.available();
+    if (available > 0) {
+      int n = client.read((uint8_t*)buf, min((size_t)available, min(length, sizeof(buf))));
+      if (n > 0) {
+        body.append(DoubaoStringView(buf, n));
+        length -= n;
+      }
+    } else if (!client.connected()) {
+      return false;
+    } else {
+      doubaoWaitReadable<ClientT, Clock>(client, deadline);
+    }
+  }
+  return length == 0;
+}
+
+/**
+ * Read one HTTP/1.1 response framed by Content-Length, chunked encoding or connection close,
+ * passing the body to a sink as it arrives
+ * @param client Connection to read from
+ * @param start Time the request was started (Clock::now())
+ * @param timeoutMs Time allowed for the complete response
+ * @param keepAlive Output, false if the server closes the connection
+ * @param meta Output for status, timing and rate-limit headers
+ * @param body Sink receiving the body
+ * @return "" on success, ERROR_TIMEOUT or ERROR_NETWORK if the response ended before its framing said it would
+ */
+template <class ClientT, class Clock = DoubaoClock, class Logger = DoubaoSerialLogger, class Sink = DoubaoStringSink>
+String doubaoReadResponseTo(ClientT& client, unsigned long start, unsigned long timeoutMs, bool* keepAlive, DoubaoResponseMeta* meta, Sink& body) {
+  meta->status = 0;
+  meta->requestsRemaining = -1;
+  meta->tokensRemaining = -1;
+  meta->retryAfterMs = 0;
+  unsigned long deadline = start + timeoutMs;
+  String line;
+  if (!doubaoReadLine<ClientT, Clock>(client, line, deadline) || !line.startsWith("HTTP/")) {
+    return line.length() == 0 && Clock::now() >= deadline ? ERROR_TIMEOUT : ERROR_NETWORK;
+  }
+  int status = line.substring(line.indexOf(' ') + 1).toInt();
+  meta->status = status;
+  meta->ttfbMs = Clock::now() - start;
+  if (status != 200) {
+    Logger::log("HTTP status %d\n", status);
+  }
+  long contentLength = -1;
+  bool chunked = false;
+  *keepAlive = true;
+  while (doubaoReadLine<ClientT, Clock>(client, line, deadline) && line.length() > 0) {
+    String header = line;
+    header.toLowerCase();
+    if (header.startsWith("content-length:")) {
+      contentLength = header.substring(15).toInt();
+    } else if (header.startsWith("transfer-encoding:") && header.indexOf("chunked") > 0) {
+      chunked = true;
+    } else if (header.startsWith("connection:") && header.indexOf("close") > 0) {
+      *keepAlive = false;
+    } else if (header.startsWith("x-ratelimit-remaining-requests:")) {
+      meta->requestsRemaining = header.substring(31).toInt();
+    } else if (header.startsWith("x-ratelimit-remaining-tokens:")) {
+      meta->tokensRemaining = header.substring(29).toInt();
+    } else if (header.startsWith("retry-after:")) {
+      meta->retryAfterMs = header.substring(12).toInt() * 1000UL;
+    }
+  }
+  // A body cut short by a reset or the deadline is an error, never a shorter success
+  bool complete;
+  if (chunked) {
+    complete = false;
+    while (doubaoReadLine<ClientT, Clock>(client, line, deadline)) {
+      long size = strtol(line.c_str(), nullptr, 16);
+      if (size <= 0) {
+        // Terminal chunk, followed by the empty line closing the trailers
+        complete = size == 0 && doubaoReadLine<ClientT, Clock>(client, line, deadline);
+        break;
+      }
+      body.reserve(body.length() + size);
+      if (!doubaoReadBody<ClientT, Clock, Sink>(client, body, size, deadline) || !doubaoReadLine<ClientT, Clock>(client, line, deadline)) {
+        break;
+      }
+    }
+  } else if (contentLength >= 0) {
+    body.reserve(contentLength);
+    complete = doubaoReadBody<ClientT, Clock, Sink>(client, body, contentLength, deadline);
+  } else {
+    *keepAlive = false;
+    while (Clock::now() < deadline && (client.connected() || client.available())) {
+      if (!doubaoReadBody<ClientT, Clock, Sink>(client, body, 512, deadline)) {
+        break;
+      }
+    }
+    // Without framing only the server closing the connection ends the body
+    complete = !client.connected() && !client.available();
+  }
+  if (!complete) {
+    *keepAlive = false;
+    Logger::log("Response cut short after %u body bytes\n", (unsigned)body.length());
+    return Clock::now() >= deadline ? ERROR_TIMEOUT : ERROR_NETWORK;
+  }
+  if (body.length() == 0) {
+    Logger::log("No response received\n");
+    return ERROR_TIMEOUT;
+  }
+  return "";
+}
+
+/**
+ * Read one HTTP/1.1 response into a String
+ * @param client Connection to read from
+ * @param start Time the request was started (Clock::now())
+ * @param timeoutMs Time allowed for the complete response
+ * @param keepAlive Output, false if the server closes the connection
+ * @param meta Output for status, timing and rate-limit headers
+ * @return Response body or error code
+ */
+template <class ClientT, class Clock = DoubaoClock, class Logger = DoubaoSerialLogger>
+String doubaoReadResponse(ClientT& client, unsigned long start, unsigned long timeoutMs, bool* keepAlive, DoubaoResponseMeta* meta) {
+  String body;
+  DoubaoStringSink sink(body);
+  String error = doubaoReadResponseTo<ClientT, Clock, Logger>(client, start, timeoutMs, keepAlive, meta, sink);
+  return error.length() > 0 ? error : body;
+}
+
+/**
+ * Write a buffer completely
+ * @return true if every byte was written
+ */
+template <class ClientT>
+bool doubaoWriteAll(ClientT& client, const char* data, size_t length) {
+  size_t sent = 0;
+  while (sent < length) {
+    size_t n = client.write((const uint8_t*)data + sent, length - sent);
+    if (n == 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+#endif // DOUBAO_HTTP_H
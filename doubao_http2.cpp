@@ -0,0 +1,426 @@
+#include "doubao_http2.h"
+#include "doubao_socket.h"
+
+#ifdef DOUBAO_ENABLE_HTTP2
+
+static const char* ALPN_PROTOCOLS[] = {"h2", nullptr};
+
+static nghttp2_nv makeHeader(const char* name, const String& value) {
+  nghttp2_nv nv;
+  nv.name = (uint8_t*)name;
+  nv.namelen = strlen(name);
+  nv.value = (uint8_t*)value.c_str();
+  nv.valuelen = value.length();
+  nv.flags = NGHTTP2_NV_FLAG_NONE;
+  return nv;
+}
+
+DoubaoHttp2Connection::DoubaoHttp2Connection(const char* host, uint16_t port)
+    : host_(host), port_(port), io_(&client_), session_(nullptr), pending_(0), completed_(0) {
+  for (int i = 0; i < DOUBAO_HTTP2_MAX_STREAMS; i++) {
+    streams_[i].used = false;
+  }
+}
+
+DoubaoHttp2Connection::~DoubaoHttp2Connection() {
+  close();
+}
+
+void DoubaoHttp2Connection::setClient(Client& client) {
+  close();
+  io_ = &client;
+}
+
+bool DoubaoHttp2Connection::connected() {
+  return session_ != nullptr && io_->connected() &&
+         (nghttp2_session_want_read(session_) || nghttp2_session_want_write(session_));
+}
+
+int DoubaoHttp2Connection::pending() const {
+  return pending_;
+}
+
+bool DoubaoHttp2Connection::connect() {
+  close();
+  if (io_ == &client_) {
+    client_.setInsecure();
+    client_.setAlpnProtocols(ALPN_PROTOCOLS);
+  }
+  if (!io_->connect(host_.c_str(), port_)) {
+    Serial.println("Failed to connect to server");
+    return false;
+  }
+  // A server without HTTP/2 falls back to HTTP/1.1 in the handshake; frames sent then would be garbage
+  const char* protocol = io_ == &client_ ? client_.alpnProtocol() : "h2";
+  if (protocol == nullptr || strcmp(protocol, "h2") != 0) {
+    Serial.println("Error: Server did not negotiate HTTP/2");
+    io_->stop();
+    return false;
+  }
+  nghttp2_session_callbacks* callbacks;
+  if (nghttp2_session_callbacks_new(&callbacks) != 0) {
+    io_->stop();
+    return false;
+  }
+  nghttp2_session_callbacks_set_send_callback(callbacks, onSend);
+  nghttp2_session_callbacks_set_on_header_callback(callbacks, onHeader);
+  nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, onData);
+  nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, onStreamClose);
+  int rv = nghttp2_session_client_new(&session_, callbacks, this);
+  nghttp2_session_callbacks_del(callbacks);
+  if (rv != 0) {
+    session_ = nullptr;
+    io_->stop();
+    return false;
+  }
+  nghttp2_settings_entry settings[] = {
+    {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, DOUBAO_HTTP2_MAX_STREAMS},
+    {NGHTTP2_SETTINGS_ENABLE_PUSH, 0},
+  };
+  nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, settings, sizeof(settings) / sizeof(settings[0]));
+  if (!flush()) {
+    Serial.println("Error: HTTP/2 handshake failed");
+    close();
+    return false;
+  }
+  return true;
+}
+
+void DoubaoHttp2Connection::close() {
+  for (int i = 0; i < DOUBAO_HTTP2_MAX_STREAMS; i++) {
+    if (streams_[i].used) {
+      finish(&streams_[i], ERROR_NETWORK);
+    }
+  }
+  if (session_ != nullptr) {
+    nghttp2_session_del(session_);
+    session_ = nullptr;
+  }
+  io_->stop();
+}
+
+void DoubaoHttp2Connection::finish(Stream* stream, const String& result) {
+  stream->used = false;
+  stream->payload = "";
+  stream->meta.latencyMs = millis() - stream->start;
+  pending_--;
+  completed_++;
+  String body = result;
+  stream->body = "";
+  if (stream->callback != nullptr) {
+    stream->callback(body, stream->meta, stream->context);
+  }
+}
+
+bool DoubaoHttp2Connection::cancel(int streamId) {
+  for (int i = 0; i < DOUBAO_HTTP2_MAX_STREAMS; i++) {
+    Stream* stream = &streams_[i];
+    if (!stream->used || stream->id != streamId) {
+      continue;
+    }
+    // Free the slot now; late frames for the stream no longer find it
+    stream->used = false;
+    stream->payload = "";
+    stream->body = "";
+    stream->callback = nullptr;
+    stream->context = nullptr;
+    pending_--;
+    if (session_ != nullptr) {
+      nghttp2_session_set_stream_user_data(session_, streamId, nullptr);
+      nghttp2_submit_rst_stream(session_, NGHTTP2_FLAG_NONE, streamId, NGHTTP2_CANCEL);
+      if (!flush()) {
+        close();
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+bool DoubaoHttp2Connection::flush() {
+  int rv = nghttp2_session_send(session_);
+  if (rv != 0) {
+    Serial.printf("HTTP/2 send failed: %s\n", nghttp2_strerror(rv));
+    return false;
+  }
+  return true;
+}
+
+int DoubaoHttp2Connection::submit(const String& path, const String& payload, const char* apiKey, DoubaoHttp2Callback callback, void* context) {
+  if (apiKey == nullptr || strlen(apiKey) == 0) {
+    Serial.println("Error: API key not set");
+    return -1;
+  }
+  if (!connected() && !connect()) {
+    return -1;
+  }
+  Stream* stream = nullptr;
+  for (int i = 0; i < DOUBAO_HTTP2_MAX_STREAMS; i++) {
+    if (!streams_[i].used) {
+      stream = &streams_[i];
+      break;
+    }
+  }
+  if (stream == nullptr) {
+    Serial.println("Error: Too many HTTP/2 streams in flight");
+    return -1;
+  }
+  stream->payload = payload;
+  stream->sent = 0;
+  stream->body = "";
+  stream->meta = DoubaoResponseMeta();
+  stream->start = millis();
+  stream->callback = callback;
+  stream->context = context;
+
+  String method = "POST";
+  String scheme = "https";
+  String contentType = "application/json";
+  String contentLength = String(payload.length());
+  String authorization = "Bearer " + String(apiKey);
+  // nghttp2 copies the header block, so the temporaries only need to outlive the call
+  nghttp2_nv headers[] = {
+    makeHeader(":method", method),
+    makeHeader(":scheme", scheme),
+    makeHeader(":authority", host_),
+    makeHeader(":path", path),
+    makeHeader("content-type", contentType),
+    makeHeader("content-length", contentLength),
+    makeHeader("authorization", authorization),
+  };
+  nghttp2_data_provider provider;
+  provider.source.ptr = stream;
+  provider.read_callback = onReadPayload;
+  int32_t id = nghttp2_submit_request(session_, nullptr, headers, sizeof(headers) / sizeof(headers[0]), &provider, stream);
+  if (id < 0) {
+    Serial.printf("HTTP/2 submit failed: %s\n", nghttp2_strerror(id));
+    stream->payload = "";
+    return -1;
+  }
+  stream->id = id;
+  stream->used = true;
+  pending_++;
+  if (!flush()) {
+    close();
+    return -1;
+  }
+  return id;
+}
+
+int DoubaoHttp2Connection::poll(unsigned long timeoutMs) {
+  if (session_ == nullptr) {
+    return 0;
+  }
+  completed_ = 0;
+  unsigned long deadline = millis() + timeoutMs;
+  uint8_t buf[1024];
+  do {
+    while (session_ != nullptr && io_->available()) {
+      int n = io_->read(buf, sizeof(buf));
+      if (n <= 0) {
+        break;
+      }
+      ssize_t rv = nghttp2_session_mem_recv(session_, buf, n);
+      if (rv < 0) {
+        Serial.printf("HTTP/2 receive failed: %s\n", nghttp2_strerror((int)rv));
+        close();
+        return completed_;
+      }
+    }
+    if (session_ == nullptr || !flush()) {
+      close();
+      return completed_;
+    }
+    if (!io_->connected()) {
+      close();
+      return completed_;
+    }
+    if (completed_ > 0 || pending_ == 0) {
+      break;
+    }
+    long remaining = (long)(deadline - millis());
+    if (timeoutMs > 0 && remaining > 0) {
+      // Sleep until the server sends something; WiFiClientSecure may not expose its socket
+      int socket = io_ == &client_ ? doubaoSocketOf(client_) : -1;
+      if (socket >= 0) {
+        doubaoSocketWait(socket, false, remaining);
+      } else {
+        delay(1);
+      }
+    }
+  } while ((long)(deadline - millis()) > 0);
+  return completed_;
+}
+
+struct Http2Result {
+  String* body;
+  DoubaoResponseMeta* meta;
+  bool done;
+};
+
+static void storeResult(const String& result, const DoubaoResponseMeta& meta, void* context) {
+  Http2Result* r = (Http2Result*)context;
+  *r->body = result;
+  if (r->meta != nullptr) {
+    *r->meta = meta;
+  }
+  r->done = true;
+}
+
+String DoubaoHttp2Connection::request(const String& path, const String& payload, const char* apiKey, DoubaoResponseMeta* meta,
+                                      unsigned long timeoutMs) {
+  String body;
+  Http2Result result = {&body, meta, false};
+  int id = submit(path, payload, apiKey, storeResult, &result);
+  if (id < 0) {
+    return ERROR_NETWORK;
+  }
+  unsigned long deadline = millis() + timeoutMs;
+  while (!result.done && (long)(deadline - millis()) > 0) {
+    poll(100);
+  }
+  if (!result.done) {
+    // result lives on this stack frame: the stream must not call back into it later
+    cancel(id);
+    return ERROR_TIMEOUT;
+  }
+  return body;
+}
+
+ssize_t DoubaoHttp2Connection::onSend(nghttp2_session* session, const uint8_t* data, size_t length, int flags, void* userData) {
+  DoubaoHttp2Connection* self = (DoubaoHttp2Connection*)userData;
+  size_t written = self->io_->write(data, length);
+  if (written == 0) {
+    return self->io_->connected() ? NGHTTP2_ERR_WOULDBLOCK : NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
+  return written;
+}
+
+ssize_t DoubaoHttp2Connection::onReadPayload(nghttp2_session* session, int32_t streamId, uint8_t* buf, size_t length, uint32_t* dataFlags, nghttp2_data_source* source, void* userData) {
+  Stream* stream = (Stream*)source->ptr;
+  size_t n = min(length, (size_t)(stream->payload.length() - stream->sent));
+  memcpy(buf, stream->payload.c_str() + stream->sent, n);
+  stream->sent += n;
+  if (stream->sent >= stream->payload.length()) {
+    *dataFlags |= NGHTTP2_DATA_FLAG_EOF;
+    // The request body is fully handed over; free it while the answer is generated
+    stream->payload = "";
+    stream->sent = 0;
+  }
+  return n;
+}
+
+int DoubaoHttp2Connection::onHeader(nghttp2_session* session, const nghttp2_frame* frame, const uint8_t* name, size_t nameLength, const uint8_t* value, size_t valueLength, uint8_t flags, void* userData) {
+  if (frame->hd.type != NGHTTP2_HEADERS) {
+    return 0;
+  }
+  Stream* stream = (Stream*)nghttp2_session_get_stream_user_data(session, frame->hd.stream_id);
+  if (stream == nullptr) {
+    return 0;
+  }
+  // nghttp2 NUL-terminates header names and values
+  if (nameLength == 7 && memcmp(name, ":status", 7) == 0) {
+    stream->meta.status = atoi((const char*)value);
+    stream->meta.ttfbMs = millis() - stream->start;
+    if (stream->meta.status != 200) {
+      Serial.printf("HTTP status %d\n", stream->meta.status);
+    }
+  } else if (nameLength == 30 && memcmp(name, "x-ratelimit-remaining-requests", 30) == 0) {
+    stream->meta.requestsRemaining = atol((const char*)value);
+  } else if (nameLength == 28 && memcmp(name, "x-ratelimit-remaining-tokens", 28) == 0) {
+    stream->meta.tokensRemaining = atol((const char*)value);
+  } else if (nameLength == 11 && memcmp(name, "retry-after", 11) == 0) {
+    stream->meta.retryAfterMs = atol((const char*)value) * 1000UL;
+  }
+  return 0;
+}
+
+int DoubaoHttp2Connection::onData(nghttp2_session* session, uint8_t flags, int32_t streamId, const uint8_t* data, size_t length, void* userData) {
+  Stream* stream = (Stream*)nghttp2_session_get_stream_user_data(session, streamId);
+  if (stream != nullptr) {
+    stream->body.concat((const char*)data, length);
+  }
+  return 0;
+}
+
+int DoubaoHttp2Connection::onStreamClose(nghttp2_session* session, int32_t streamId, uint32_t errorCode, void* userData) {
+  DoubaoHttp2Connection* self = (DoubaoHttp2Connection*)userData;
+  Stream* stream = (Stream*)nghttp2_session_get_stream_user_data(session, streamId);
+  if (stream == nullptr || !stream->used) {
+    return 0;
+  }
+  if (errorCode != NGHTTP2_NO_ERROR || stream->body.length() == 0) {
+    Serial.printf("HTTP/2 stream %d closed: %s\n", (int)streamId, nghttp2_http2_strerror(errorCode));
+    self->finish(stream, errorCode == NGHTTP2_REFUSED_STREAM ? ERROR_OVERLOADED : ERROR_NETWORK);
+  } else {
+    self->finish(stream, stream->body);
+  }
+  return 0;
+}
+
+struct Http2Answer {
+  String* answer;
+  bool done;
+};
+
+static void storeAnswer(const String& result, const DoubaoResponseMeta& meta, void* context) {
+  Http2Answer* a = (Http2Answer*)context;
+  if (result == ERROR_NETWORK || result == ERROR_OVERLOADED) {
+    *a->answer = result;
+  } else if (meta.status == 429 || meta.status >= 500) {
+    *a->answer = ERROR_OVERLOADED;
+  } else {
+    *a->answer = parseChatResponse(result);
+  }
+  a->done = true;
+}
+
+int getGPTAnswersHttp2(DoubaoHttp2Connection& connection, const String* inputTexts, int count, const char* apiKey, String modelId, String systemPrompt, float temp, String* answers) {
+  if (!validateConfig(apiKey, modelId, temp) || count <= 0) {
+    return 0;
+  }
+  Http2Answer slots[DOUBAO_HTTP2_MAX_STREAMS];
+  bool busy[DOUBAO_HTTP2_MAX_STREAMS] = {false};
+  int next = 0;
+  int inFlight = 0;
+  int succeeded = 0;
+  unsigned long deadline = millis() + DOUBAO_RESPONSE_TIMEOUT_MS;
+  while (next < count || inFlight > 0) {
+    // Keep every stream slot busy
+    for (int s = 0; s < DOUBAO_HTTP2_MAX_STREAMS && next < count; s++) {
+      if (busy[s]) {
+        continue;
+      }
+      slots[s].answer = &answers[next];
+      slots[s].done = false;
+      String payload = buildPayload(inputTexts[next], modelId, systemPrompt, temp);
+      next++;
+      if (connection.submit(DOUBAO_CHAT_PATH, payload, apiKey, storeAnswer, &slots[s]) < 0) {
+        *slots[s].answer = ERROR_NETWORK;
+        continue;
+      }
+      busy[s] = true;
+      inFlight++;
+    }
+    if (inFlight == 0) {
+      continue;
+    }
+    if ((long)(millis() - deadline) >= 0) {
+      connection.close();
+    } else {
+      connection.poll(100);
+    }
+    for (int s = 0; s < DOUBAO_HTTP2_MAX_STREAMS; s++) {
+      if (busy[s] && slots[s].done) {
+        busy[s] = false;
+        inFlight--;
+        if (!isErrorResponse(*slots[s].answer)) {
+          succeeded++;
+        }
+      }
+    }
+  }
+  return succeeded;
+}
+
+#endif // DOUBAO_ENABLE_HTTP2
@@ -0,0 +1,169 @@
+#ifndef DOUBAO_HTTP2_H
+#define DOUBAO_HTTP2_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+
+/*
+ * Optional HTTP/2 transport built on nghttp2 (shipped with ESP-IDF). Enable it
+ * with -DDOUBAO_ENABLE_HTTP2 in the build flags. Many chat completions then
+ * share one TLS connection as independent streams; request headers are HPACK
+ * compressed, so after the first request the host, path and Authorization
+ * header cost a byte or two each.
+ */
+#ifdef DOUBAO_ENABLE_HTTP2
+
+#include <WiFiClientSecure.h>
+#include <mbedtls/ssl.h>
+#include <nghttp2/nghttp2.h>
+
+// Streams in flight on one connection
+#define DOUBAO_HTTP2_MAX_STREAMS 8
+
+/**
+ * Called when a stream finishes
+ * @param result Raw response body or error code
+ * @param meta Status and timing of the stream
+ * @param context User pointer given to submit()
+ */
+typedef void (*DoubaoHttp2Callback)(const String& result, const DoubaoResponseMeta& meta, void* context);
+
+/**
+ * WiFiClientSecure that reports the protocol the server chose through ALPN
+ */
+class DoubaoAlpnClient : public WiFiClientSecure {
+public:
+  /**
+   * @return Negotiated protocol (e.g. "h2"), nullptr if none was negotiated
+   */
+  const char* alpnProtocol() {
+    return sslclient ? mbedtls_ssl_get_alpn_protocol(&sslclient->ssl_ctx) : nullptr;
+  }
+};
+
+/**
+ * One TLS connection carrying multiplexed HTTP/2 requests
+ */
+class DoubaoHttp2Connection {
+public:
+  /**
+   * @param host Server host (default: DOUBAO_API_HOST)
+   * @param port Server port (default: 443)
+   */
+  DoubaoHttp2Connection(const char* host = DOUBAO_API_HOST, uint16_t port = 443);
+  ~DoubaoHttp2Connection();
+
+  /**
+   * Carry the session over another connection instead of TLS, e.g. a WiFiClient
+   * to a plain-TCP (h2c) stand-in server or an in-memory one; ALPN is not checked
+   * @param client Connection to use; must outlive this object
+   */
+  void setClient(Client& client);
+
+  /**
+   * Open the TLS connection (ALPN "h2") and start the HTTP/2 session
+   * @return true on success, false if the server does not speak HTTP/2
+   */
+  bool connect();
+
+  /**
+   * Close the session; unfinished streams complete with ERROR_NETWORK
+   */
+  void close();
+
+  /**
+   * @return true while the session is usable
+   */
+  bool connected();
+
+  /**
+   * Start a POST request on a new stream; connects on demand
+   * @param path Request path (e.g. DOUBAO_CHAT_PATH)
+   * @param payload JSON payload to send
+   * @param apiKey API key for authentication; required, HTTP/2 requests do not draw keys from a DoubaoKeyPool
+   * @param callback Receives the response
+   * @param context User pointer passed to callback
+   * @return Stream id, -1 on failure
+   */
+  int submit(const String& path, const String& payload, const char* apiKey, DoubaoHttp2Callback callback, void* context = nullptr);
+
+  /**
+   * Abandon a stream: the server is sent RST_STREAM (CANCEL) and its callback is never called
+   * @param streamId Stream id returned by submit()
+   * @return true if the stream was in flight, false otherwise
+   */
+  bool cancel(int streamId);
+
+  /**
+   * Send and receive pending frames
+   * @param timeoutMs Time to wait for incoming data (default: 0)
+   * @return Number of streams completed during this call
+   */
+  int poll(unsigned long timeoutMs = 0);
+
+  /**
+   * @return Number of streams in flight
+   */
+  int pending() const;
+
+  /**
+   * Send one request and wait for its response
+   * @param path Request path
+   * @param payload JSON payload to send
+   * @param apiKey API key for authentication; required, see submit()
+   * @param meta Optional output for status and timing
+   * @param timeoutMs Time allowed for the response (default: DOUBAO_RESPONSE_TIMEOUT_MS)
+   * @return Raw response body or error code; on ERROR_TIMEOUT the stream is cancelled
+   */
+  String request(const String& path, const String& payload, const char* apiKey, DoubaoResponseMeta* meta = nullptr,
+                 unsigned long timeoutMs = DOUBAO_RESPONSE_TIMEOUT_MS);
+
+private:
+  struct Stream {
+    bool used;
+    int32_t id;
+    String payload;
+    size_t sent;
+    String body;
+    DoubaoResponseMeta meta;
+    unsigned long start;
+    DoubaoHttp2Callback callback;
+    void* context;
+  };
+
+  void finish(Stream* stream, const String& result);
+  bool flush();
+
+  static ssize_t onSend(nghttp2_session* session, const uint8_t* data, size_t length, int flags, void* userData);
+  static ssize_t onReadPayload(nghttp2_session* session, int32_t streamId, uint8_t* buf, size_t length, uint32_t* dataFlags, nghttp2_data_source* source, void* userData);
+  static int onHeader(nghttp2_session* session, const nghttp2_frame* frame, const uint8_t* name, size_t nameLength, const uint8_t* value, size_t valueLength, uint8_t flags, void* userData);
+  static int onData(nghttp2_session* session, uint8_t flags, int32_t streamId, const uint8_t* data, size_t length, void* userData);
+  static int onStreamClose(nghttp2_session* session, int32_t streamId, uint32_t errorCode, void* userData);
+
+  String host_;
+  uint16_t port_;
+  DoubaoAlpnClient client_;
+  Client* io_;                // client_, or the connection given to setClient()
+  nghttp2_session* session_;
+  Stream streams_[DOUBAO_HTTP2_MAX_STREAMS];
+  int pending_;
+  int completed_;
+};
+
+/**
+ * Get GPT answers for several prompts at once over one HTTP/2 connection
+ * @param connection HTTP/2 connection
+ * @param inputTexts Prompts to send
+ * @param count Number of prompts (at most DOUBAO_HTTP2_MAX_STREAMS are in flight at a time)
+ * @param apiKey API key for authentication; required, a DoubaoKeyPool is not used
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @param answers Output array of count entries, each an AI response or error code
+ * @return Number of successful answers
+ */
+int getGPTAnswersHttp2(DoubaoHttp2Connection& connection, const String* inputTexts, int count, const char* apiKey, String modelId, String systemPrompt, float temp, String* answers);
+
+#endif // DOUBAO_ENABLE_HTTP2
+
+#endif // DOUBAO_HTTP2_H
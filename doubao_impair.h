@@ -0,0 +1,265 @@
+#ifndef DOUBAO_IMPAIR_H
+#define DOUBAO_IMPAIR_H
+
+#include <Arduino.h>
+#include "doubao_policies.h"
+
+// Bytes that may arrive back to back under a bandwidth cap (one TCP segment)
+#define DOUBAO_IMPAIR_BURST 1460
+
+/*
+ * Network impairment for comparing retry and timeout strategies on
+ * reproducible bad links. DoubaoImpairedClient wraps a connection type and
+ * holds back what the server sends: it adds round-trip time and jitter, caps
+ * the bandwidth, stalls the stream, resets the connection mid-response, or
+ * trickles bytes like a slow-loris server. Use it as the ClientT of
+ * DoubaoKeepAliveTransport:
+ *
+ *   typedef DoubaoImpairedClient<DoubaoTlsClient> Impaired;
+ *   DoubaoClient<DoubaoKeepAliveTransport<Impaired>> client;
+ *   client.transport().client().setImpairment(doubaoImpairmentWeakWifi());
+ *
+ * Random choices come from a generator seeded by the profile, so a profile
+ * gives the same run every time when the server does. With
+ * DoubaoVirtualClock as Clock, a held-back byte wakes the reader at exactly
+ * the time it is released, and the delays cost no real time.
+ *
+ * The wrapper does not expose fd(): a socket can be readable while its bytes
+ * are still held back, so readers check the connection every
+ * DOUBAO_POLL_INTERVAL_MS instead of waiting in select().
+ */
+struct DoubaoImpairment {
+  unsigned long rttMs = 0;          // Added before each connect and before the first byte of each response
+  unsigned long jitterMs = 0;       // Up to this much more, uniformly random, on each such delay
+  uint32_t bytesPerSecond = 0;      // Receive bandwidth cap, 0 for none
+  float stallChance = 0;            // Per KB received, chance the stream stops for stallMs
+  unsigned long stallMs = 0;
+  float resetChance = 0;            // Per KB received, chance the connection is reset
+  unsigned long lorisMs = 0;        // Slow-loris server: one byte per lorisMs, 0 for none
+  uint32_t seed = 1;                // Random generator seed
+};
+
+// What the impairment did since the last setImpairment()
+struct DoubaoImpairmentStats {
+  uint32_t bytes = 0;               // Bytes passed to the reader
+  uint32_t stalls = 0;
+  uint32_t resets = 0;
+  unsigned long delayedMs = 0;      // Round-trip time and jitter added
+};
+
+// Presets: rough link shapes to start from, not measurements; adjust them to match logs from the field
+
+// Strong signal: short round trips, no losses
+inline DoubaoImpairment doubaoImpairmentGoodWifi() {
+  DoubaoImpairment p;
+  p.rttMs = 30;
+  p.jitterMs = 10;
+  return p;
+}
+
+// Shared access point at a busy time: queueing delay, a slower link, occasional stalls
+inline DoubaoImpairment doubaoImpairmentBusyWifi() {
+  DoubaoImpairment p;
+  p.rttMs = 80;
+  p.jitterMs = 120;
+  p.bytesPerSecond = 250000;
+  p.stallChance = 0.02;
+  p.stallMs = 800;
+  p.resetChance = 0.002;
+  return p;
+}
+
+// Edge of range: long retransmission stalls and dropped connections
+inline DoubaoImpairment doubaoImpairmentWeakWifi() {
+  DoubaoImpairment p;
+  p.rttMs = 250;
+  p.jitterMs = 400;
+  p.bytesPerSecond = 40000;
+  p.stallChance = 0.05;
+  p.stallMs = 3000;
+  p.resetChance = 0.01;
+  return p;
+}
+
+// Server that accepts the request and then sends one byte every two seconds
+inline DoubaoImpairment doubaoImpairmentSlowLoris() {
+  DoubaoImpairment p;
+  p.rttMs = 50;
+  p.lorisMs = 2000;
+  return p;
+}
+
+/**
+ * Connection wrapper injecting the faults of a DoubaoImpairment
+ * @tparam ClientT Wrapped connection type (DoubaoTlsClient, WiFiClient, a host stand-in)
+ * @tparam Clock Time source; DoubaoVirtualClock for tests that should not take real time
+ */
+template <class ClientT, class Clock = DoubaoClock>
+class DoubaoImpairedClient {
+public:
+  /**
+   * Apply a profile; reseeds the random generator and clears the statistics
+   * @param impairment Faults to inject
+   */
+  void setImpairment(const DoubaoImpairment& impairment) {
+    impairment_ = impairment;
+    random_ = impairment.seed != 0 ? impairment.seed : 1;
+    stats_ = DoubaoImpairmentStats();
+  }
+
+  const DoubaoImpairment& impairment() const {
+    return impairment_;
+  }
+
+  const DoubaoImpairmentStats& stats() const {
+    return stats_;
+  }
+
+  ClientT& inner() {
+    return inner_;
+  }
+
+  int connect(const char* host, uint16_t port) {
+    Clock::sleep(pathDelay());
+    reset_ = false;
+    requestOpen_ = false;
+    return inner_.connect(host, port);
+  }
+
+  size_t write(uint8_t b) {
+    return write(&b, 1);
+  }
+
+  size_t write(const uint8_t* buf, size_t size) {
+    if (reset_) {
+      return 0;
+    }
+    // The first write of a request starts the round trip its response waits for
+    if (!requestOpen_) {
+      requestOpen_ = true;
+      releaseAt_ = Clock::now() + pathDelay();
+    }
+    return inner_.write(buf, size);
+  }
+
+  int available() {
+    if (reset_) {
+      return 0;
+    }
+    unsigned long now = Clock::now();
+    if ((long)(releaseAt_ - now) > 0) {
+      doubaoClockWake<Clock>(releaseAt_);
+      return 0;
+    }
+    int n = inner_.available();
+    if (n <= 0) {
+      return n;
+    }
+    if (impairment_.lorisMs > 0) {
+      return 1;
+    }
+    if (impairment_.bytesPerSecond == 0) {
+      return n;
+    }
+    refill(now);
+    if (credit_ < 1000) {
+      unsigned long wait = (unsigned long)((1000 - credit_ + impairment_.bytesPerSecond - 1) / impairment_.bytesPerSecond);
+      doubaoClockWake<Clock>(now + wait);
+      return 0;
+    }
+    return (int)min((uint64_t)n, credit_ / 1000);
+  }
+
+  int read() {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+  }
+
+  int read(uint8_t* buf, size_t size) {
+    int allowed = available();
+    if (allowed <= 0) {
+      return 0;
+    }
+    int n = inner_.read(buf, min(size, (size_t)allowed));
+    if (n <= 0) {
+      return n;
+    }
+    requestOpen_ = false;
+    stats_.bytes += n;
+    unsigned long now = Clock::now();
+    if (impairment_.bytesPerSecond > 0) {
+      credit_ -= (uint64_t)n * 1000;
+    }
+    if (impairment_.lorisMs > 0) {
+      releaseAt_ = now + impairment_.lorisMs;
+    }
+    // Faults are drawn once per KB, so they do not depend on how the reader splits its reads
+    received_ += n;
+    while (received_ >= 1024) {
+      received_ -= 1024;
+      if (chance(impairment_.resetChance)) {
+        stats_.resets++;
+        inner_.stop();
+        reset_ = true;
+        break;
+      }
+      if (chance(impairment_.stallChance)) {
+        stats_.stalls++;
+        releaseAt_ = now + impairment_.stallMs;
+      }
+    }
+    return n;
+  }
+
+  uint8_t connected() {
+    return reset_ ? 0 : inner_.connected();
+  }
+
+  void stop() {
+    inner_.stop();
+    reset_ = false;
+    requestOpen_ = false;
+  }
+
+private:
+  // Milli-bytes earned since the last call, capped at one burst
+  void refill(unsigned long now) {
+    uint64_t earned = (uint64_t)(now - lastRefill_) * impairment_.bytesPerSecond;
+    lastRefill_ = now;
+    credit_ = min(credit_ + earned, (uint64_t)DOUBAO_IMPAIR_BURST * 1000);
+  }
+
+  unsigned long pathDelay() {
+    unsigned long delayMs = impairment_.rttMs;
+    if (impairment_.jitterMs > 0) {
+      delayMs += next() % (impairment_.jitterMs + 1);
+    }
+    stats_.delayedMs += delayMs;
+    return delayMs;
+  }
+
+  // xorshift32
+  uint32_t next() {
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 17;
+    random_ ^= random_ << 5;
+    return random_;
+  }
+
+  bool chance(float p) {
+    return p > 0 && (next() >> 8) < (uint32_t)(p * 16777216.0f);
+  }
+
+  ClientT inner_;
+  DoubaoImpairment impairment_;
+  DoubaoImpairmentStats stats_;
+  uint32_t random_ = 1;
+  unsigned long releaseAt_ = 0;     // Nothing is readable before this time
+  unsigned long lastRefill_ = 0;
+  uint64_t credit_ = 0;             // Bandwidth allowance in milli-bytes
+  uint32_t received_ = 0;           // Bytes toward the next fault draw
+  bool requestOpen_ = false;        // A request was written and its response has not started
+  bool reset_ = false;
+};
+
+#endif // DOUBAO_IMPAIR_H
@@ -0,0 +1,307 @@
+#include "doubao_json_path.h"
+
+DoubaoJsonPath::DoubaoJsonPath() : depth_(0) {
+  offsets_[0] = 0;
+}
+
+bool DoubaoJsonPath::compile(const char* path) {
+  names_ = "";
+  depth_ = 0;
+  offsets_[0] = 0;
+  if (path == nullptr || path[0] == '\0') {
+    return true;
+  }
+  if (path[0] != '/') {
+    Serial.println("Error: JSON path must start with '/'");
+    return false;
+  }
+  names_.reserve(strlen(path));
+  const char* p = path + 1;
+  while (true) {
+    if (depth_ == DOUBAO_JSON_MAX_SEGMENTS) {
+      Serial.printf("Error: JSON path deeper than %d segments\n", DOUBAO_JSON_MAX_SEGMENTS);
+      return false;
+    }
+    size_t start = names_.length();
+    for (; *p != '\0' && *p != '/'; p++) {
+      if (*p != '~') {
+        names_ += *p;
+      } else if (p[1] == '0' || p[1] == '1') {
+        names_ += p[1] == '0' ? '~' : '/';
+        p++;
+      } else {
+        Serial.println("Error: Invalid escape in JSON path");
+        return false;
+      }
+    }
+    // Array positions are plain decimal without leading zeros
+    size_t length = names_.length() - start;
+    long index = -1;
+    if (length > 0 && length <= 5 && (names_[start] != '0' || length == 1)) {
+      index = 0;
+      for (size_t i = start; i < names_.length() && index >= 0; i++) {
+        index = isdigit((unsigned char)names_[i]) ? index * 10 + (names_[i] - '0') : -1;
+      }
+    }
+    indexes_[depth_] = index >= 0 && index <= 32767 ? (int16_t)index : -1;
+    offsets_[++depth_] = names_.length();
+    if (*p == '\0') {
+      return true;
+    }
+    p++;
+  }
+}
+
+int DoubaoJsonPath::depth() const {
+  return depth_;
+}
+
+bool DoubaoJsonPath::matchesKey(int segment, DoubaoStringView key) const {
+  size_t length = offsets_[segment + 1] - offsets_[segment];
+  return key.length == length && memcmp(names_.c_str() + offsets_[segment], key.data, length) == 0;
+}
+
+bool DoubaoJsonPath::matchesIndex(int segment, int index) const {
+  return indexes_[segment] == index;
+}
+
+DoubaoJsonExtractor::DoubaoJsonExtractor() : count_(0), foundCount_(0), cursor_(nullptr), end_(nullptr) {
+  memset(found_, 0, sizeof(found_));
+}
+
+int DoubaoJsonExtractor::add(const char* path) {
+  if (count_ == DOUBAO_JSON_MAX_FIELDS) {
+    Serial.printf("Error: Extractor holds at most %d fields\n", DOUBAO_JSON_MAX_FIELDS);
+    return -1;
+  }
+  if (!paths_[count_].compile(path)) {
+    return -1;
+  }
+  found_[count_] = false;
+  return count_++;
+}
+
+void DoubaoJsonExtractor::clear() {
+  count_ = 0;
+  foundCount_ = 0;
+}
+
+bool DoubaoJsonExtractor::extract(DoubaoStringView json) {
+  for (int i = 0; i < count_; i++) {
+    found_[i] = false;
+    results_[i] = DoubaoStringView();
+  }
+  foundCount_ = 0;
+  cursor_ = json.data;
+  end_ = json.data + json.length;
+  if (!scanValue(0, (uint16_t)((1u << count_) - 1))) {
+    return false;
+  }
+  if (count_ > 0 && foundCount_ == count_) {
+    return true;
+  }
+  skipWhitespace();
+  return cursor_ == end_;
+}
+
+int DoubaoJsonExtractor::found() const {
+  return foundCount_;
+}
+
+bool DoubaoJsonExtractor::has(int field) const {
+  return field >= 0 && field < count_ && found_[field];
+}
+
+DoubaoStringView DoubaoJsonExtractor::raw(int field) const {
+  return has(field) ? results_[field] : DoubaoStringView();
+}
+
+static uint8_t hexValue(char c) {
+  return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+static void appendUtf8(String& out, uint32_t codePoint) {
+  if (codePoint < 0x80) {
+    out += (char)codePoint;
+  } else if (codePoint < 0x800) {
+    out += (char)(0xC0 | (codePoint >> 6));
+    out += (char)(0x80 | (codePoint & 0x3F));
+  } else if (codePoint < 0x10000) {
+    out += (char)(0xE0 | (codePoint >> 12));
+    out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+    out += (char)(0x80 | (codePoint & 0x3F));
+  } else {
+    out += (char)(0xF0 | (codePoint >> 18));
+    out += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+    out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+    out += (char)(0x80 | (codePoint & 0x3F));
+  }
+}
+
+String DoubaoJsonExtractor::value(int field) const {
+  DoubaoStringView text = raw(field);
+  String out;
+  if (text.length == 0 || text.data[0] != '"') {
+    out.concat(text.data, text.length);
+    return out;
+  }
+  // scanString() already validated the escapes
+  out.reserve(text.length);
+  const char* p = text.data + 1;
+  const char* end = text.data + text.length - 1;
+  while (p < end) {
+    if (*p != '\\') {
+      out += *p++;
+      continue;
+    }
+    char c = p[1];
+    p += 2;
+    switch (c) {
+      case 'b': out += '\b'; break;
+      case 'f': out += '\f'; break;
+      case 'n': out += '\n'; break;
+      case 'r': out += '\r'; break;
+      case 't': out += '\t'; break;
+      case 'u': {
+        uint32_t codePoint = (hexValue(p[0]) << 12) | (hexValue(p[1]) << 8) | (hexValue(p[2]) << 4) | hexValue(p[3]);
+        p += 4;
+        // Surrogate pair: a high surrogate followed by \uDC00-\uDFFF
+        if (codePoint >= 0xD800 && codePoint < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+          uint32_t low = (hexValue(p[2]) << 12) | (hexValue(p[3]) << 8) | (hexValue(p[4]) << 4) | hexValue(p[5]);
+          if (low >= 0xDC00 && low < 0xE000) {
+            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+            p += 6;
+          }
+        }
+        appendUtf8(out, codePoint);
+        break;
+      }
+      default: out += c; break;
+    }
+  }
+  return out;
+}
+
+void DoubaoJsonExtractor::skipWhitespace() {
+  while (cursor_ < end_ && (*cursor_ == ' ' || *cursor_ == '\n' || *cursor_ == '\r' || *cursor_ == '\t')) {
+    cursor_++;
+  }
+}
+
+bool DoubaoJsonExtractor::scanString(DoubaoStringView* text) {
+  if (cursor_ >= end_ || *cursor_ != '"') {
+    return false;
+  }
+  const char* start = ++cursor_;
+  while (cursor_ < end_ && *cursor_ != '"') {
+    if ((uint8_t)*cursor_ < 0x20) {
+      return false;
+    }
+    if (*cursor_ == '\\') {
+      if (end_ - cursor_ < 2 || cursor_[1] == '\0' || strchr("\"\\/bfnrtu", cursor_[1]) == nullptr) {
+        return false;
+      }
+      if (cursor_[1] == 'u') {
+        if (end_ - cursor_ < 6 || !isxdigit((unsigned char)cursor_[2]) || !isxdigit((unsigned char)cursor_[3]) ||
+            !isxdigit((unsigned char)cursor_[4]) || !isxdigit((unsigned char)cursor_[5])) {
+          return false;
+        }
+        cursor_ += 4;
+      }
+      cursor_++;
+    }
+    cursor_++;
+  }
+  if (cursor_ >= end_) {
+    return false;
+  }
+  *text = DoubaoStringView(start, cursor_ - start);
+  cursor_++;
+  return true;
+}
+
+// candidates: fields whose first `depth` segments match the current position
+bool DoubaoJsonExtractor::scanValue(int depth, uint16_t candidates) {
+  if (depth > DOUBAO_JSON_MAX_DEPTH) {
+    return false;
+  }
+  skipWhitespace();
+  if (cursor_ >= end_) {
+    return false;
+  }
+  const char* start = cursor_;
+  char c = *cursor_;
+  if (c == '{' || c == '[') {
+    bool isObject = c == '{';
+    char close = isObject ? '}' : ']';
+    cursor_++;
+    skipWhitespace();
+    if (cursor_ < end_ && *cursor_ == close) {
+      cursor_++;
+    } else {
+      for (int index = 0;; index++) {
+        DoubaoStringView key;
+        if (isObject) {
+          skipWhitespace();
+          if (!scanString(&key)) {
+            return false;
+          }
+          skipWhitespace();
+          if (cursor_ >= end_ || *cursor_ != ':') {
+            return false;
+          }
+          cursor_++;
+        }
+        uint16_t child = 0;
+        for (int i = 0; i < count_; i++) {
+          if ((candidates & (1u << i)) && !found_[i] && paths_[i].depth() > depth &&
+              (isObject ? paths_[i].matchesKey(depth, key) : paths_[i].matchesIndex(depth, index))) {
+            child |= 1u << i;
+          }
+        }
+        if (!scanValue(depth + 1, child)) {
+          return false;
+        }
+        if (foundCount_ == count_ && count_ > 0) {
+          return true;
+        }
+        skipWhitespace();
+        if (cursor_ < end_ && *cursor_ == ',') {
+          cursor_++;
+          continue;
+        }
+        if (cursor_ < end_ && *cursor_ == close) {
+          cursor_++;
+          break;
+        }
+        return false;
+      }
+    }
+  } else if (c == '"') {
+    DoubaoStringView text;
+    if (!scanString(&text)) {
+      return false;
+    }
+  } else if (c == 't' || c == 'f' || c == 'n') {
+    const char* word = c == 't' ? "true" : c == 'f' ? "false" : "null";
+    size_t length = strlen(word);
+    if ((size_t)(end_ - cursor_) < length || memcmp(cursor_, word, length) != 0) {
+      return false;
+    }
+    cursor_ += length;
+  } else if (c == '-' || isdigit((unsigned char)c)) {
+    while (cursor_ < end_ && (isdigit((unsigned char)*cursor_) || (*cursor_ != '\0' && strchr("+-.eE", *cursor_) != nullptr))) {
+      cursor_++;
+    }
+  } else {
+    return false;
+  }
+  for (int i = 0; i < count_; i++) {
+    if ((candidates & (1u << i)) && !found_[i] && paths_[i].depth() == depth) {
+      results_[i] = DoubaoStringView(start, cursor_ - start);
+      found_[i] = true;
+      foundCount_++;
+    }
+  }
+  return true;
+}
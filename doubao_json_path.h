@@ -0,0 +1,127 @@
+#ifndef DOUBAO_JSON_PATH_H
+#define DOUBAO_JSON_PATH_H
+
+#include <Arduino.h>
+#include "doubao_view.h"
+
+#define DOUBAO_JSON_MAX_SEGMENTS 8   // Segments per path
+#define DOUBAO_JSON_MAX_FIELDS 8     // Paths per extractor
+#define DOUBAO_JSON_MAX_DEPTH 32     // Nesting accepted by the scanner
+
+/*
+ * Paths use JSON Pointer syntax (RFC 6901): "/items/0/name" selects member
+ * "name" of element 0 of member "items". "~1" stands for '/' and "~0" for '~'
+ * inside a segment; "" selects the whole document. A numeric segment also
+ * matches an object member with that name. Member names are compared as they
+ * appear in the text, so names written with escapes do not match.
+ */
+
+/**
+ * JSON Pointer compiled once into segments
+ */
+class DoubaoJsonPath {
+public:
+  DoubaoJsonPath();
+
+  /**
+   * Parse a path
+   * @param path JSON Pointer, e.g. "/items/0/name"
+   * @return true on success, false if malformed or deeper than DOUBAO_JSON_MAX_SEGMENTS
+   */
+  bool compile(const char* path);
+
+  /**
+   * @return Number of segments (0 for the whole document)
+   */
+  int depth() const;
+
+  /**
+   * Check one segment against an object member name
+   * @param segment Segment number
+   * @param key Member name as it appears between the quotes
+   */
+  bool matchesKey(int segment, DoubaoStringView key) const;
+
+  /**
+   * Check one segment against an array position
+   * @param segment Segment number
+   * @param index Element index
+   */
+  bool matchesIndex(int segment, int index) const;
+
+private:
+  String names_;                                // Unescaped segments, back to back
+  uint16_t offsets_[DOUBAO_JSON_MAX_SEGMENTS + 1];
+  int16_t indexes_[DOUBAO_JSON_MAX_SEGMENTS];   // -1 if the segment is not a number
+  uint8_t depth_;
+};
+
+/**
+ * Pulls several fields out of a JSON text in one pass, without building a DOM.
+ * Paths are compiled once with add(); extract() can then be called on any
+ * number of documents and does not allocate. Results are views into the
+ * document, so it must stay valid while raw()/value() are used.
+ */
+class DoubaoJsonExtractor {
+public:
+  DoubaoJsonExtractor();
+
+  /**
+   * Add a field to extract
+   * @param path JSON Pointer, e.g. "/items/0/name"
+   * @return Field number for raw()/value(), -1 if the path is malformed or the extractor is full
+   */
+  int add(const char* path);
+
+  /**
+   * Remove all fields
+   */
+  void clear();
+
+  /**
+   * Scan a document; stops early once every field has been found
+   * @param json Document text
+   * @return true if the text scanned was valid JSON, false otherwise
+   */
+  bool extract(DoubaoStringView json);
+
+  /**
+   * @return Number of fields found by the last extract()
+   */
+  int found() const;
+
+  /**
+   * @param field Field number returned by add()
+   * @return true if the last extract() found the field
+   */
+  bool has(int field) const;
+
+  /**
+   * Field text exactly as it appears in the document (strings keep their quotes)
+   * @param field Field number returned by add()
+   * @return View into the document, empty if not found
+   */
+  DoubaoStringView raw(int field) const;
+
+  /**
+   * Field value: strings unescaped, other values as written
+   * @param field Field number returned by add()
+   * @return Value, "" if not found
+   */
+  String value(int field) const;
+
+private:
+  bool scanValue(int depth, uint16_t candidates);
+  bool scanString(DoubaoStringView* text);
+  void skipWhitespace();
+
+  DoubaoJsonPath paths_[DOUBAO_JSON_MAX_FIELDS];
+  DoubaoStringView results_[DOUBAO_JSON_MAX_FIELDS];
+  bool found_[DOUBAO_JSON_MAX_FIELDS];
+  int count_;
+  int foundCount_;
+  const char* cursor_;
+  const char* end_;
+};
+
+#endif // DOUBAO_JSON_PATH_H
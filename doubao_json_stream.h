@@ -0,0 +1,403 @@
+#ifndef DOUBAO_JSON_STREAM_H
+#define DOUBAO_JSON_STREAM_H
+
+#include <Arduino.h>
+
+#define DOUBAO_STREAM_MAX_DEPTH 8     // Levels whose member name/index is tracked
+#define DOUBAO_STREAM_KEY_LENGTH 24   // Longest member name kept per level
+
+/*
+ * Push JSON tokenizer: bytes are fed as they arrive and events are delivered
+ * to a handler, so a document is never held in memory. Strings arrive byte by
+ * byte with escapes already decoded. The handler is any type with:
+ *
+ *   void onContainerStart(bool isObject);   depth() already includes the new level
+ *   void onContainerEnd(bool isObject);     depth() already excludes it
+ *   void onKey();                           key(depth()) is the member name
+ *   void onStringStart();
+ *   void onStringByte(char c);
+ *   void onStringEnd();
+ *   void onLiteral(const char* text, size_t length);   number, true, false or null
+ *
+ * Levels are numbered from 1 (the root container). For an object level,
+ * key(level) is the member being parsed; for an array level, index(level) is
+ * the element position. Levels deeper than DOUBAO_STREAM_MAX_DEPTH are
+ * parsed but report "" and -1; nesting beyond 64 levels is rejected.
+ */
+template <class Handler>
+class DoubaoJsonStream {
+public:
+  explicit DoubaoJsonStream(Handler& handler) : handler_(handler) {
+    reset();
+  }
+
+  /**
+   * Start a new document
+   */
+  void reset() {
+    state_ = STATE_VALUE;
+    depth_ = 0;
+    objectBits_ = 0;
+    inKey_ = false;
+    literalLength_ = 0;
+    unicodeDigits_ = 0;
+    highSurrogate_ = 0;
+  }
+
+  /**
+   * Feed one byte
+   * @return false once the input is not valid JSON
+   */
+  bool feed(char c) {
+    switch (state_) {
+      case STATE_VALUE:
+      case STATE_VALUE_OR_END:
+        if (isSpace(c)) {
+          return true;
+        }
+        if (state_ == STATE_VALUE_OR_END && c == ']') {
+          return closeContainer(false);
+        }
+        return startValue(c);
+      case STATE_KEY_OR_END:
+        if (c == '}') {
+          return closeContainer(true);
+        }
+        // fall through
+      case STATE_KEY_START:
+        if (isSpace(c)) {
+          return true;
+        }
+        if (c != '"') {
+          return fail();
+        }
+        keyLength_ = 0;
+        inKey_ = true;
+        state_ = STATE_KEY;
+        return true;
+      case STATE_KEY:
+      case STATE_STRING:
+        if (c == '"') {
+          return endString();
+        }
+        if (c == '\\') {
+          escapeReturn_ = state_;
+          state_ = STATE_ESCAPE;
+          return true;
+        }
+        if ((uint8_t)c < 0x20) {
+          return fail();
+        }
+        emit(c);
+        return true;
+      case STATE_ESCAPE:
+        return escape(c);
+      case STATE_UNICODE:
+        return unicode(c);
+      case STATE_COLON:
+        if (isSpace(c)) {
+          return true;
+        }
+        if (c != ':') {
+          return fail();
+        }
+        state_ = STATE_VALUE;
+        return true;
+      case STATE_LITERAL:
+        if (isalnum((unsigned char)c) || c == '+' || c == '-' || c == '.') {
+          if (literalLength_ == sizeof(literal_) - 1) {
+            return fail();
+          }
+          literal_[literalLength_++] = c;
+          return true;
+        }
+        return endLiteral() && feed(c);
+      case STATE_AFTER_VALUE:
+        if (isSpace(c)) {
+          return true;
+        }
+        if (c == ',') {
+          if (topIsObject()) {
+            state_ = STATE_KEY_START;
+          } else {
+            if (depth_ <= DOUBAO_STREAM_MAX_DEPTH) {
+              levels_[depth_ - 1].index++;
+            }
+            state_ = STATE_VALUE;
+          }
+          return true;
+        }
+        if (c == '}' || c == ']') {
+          return closeContainer(c == '}');
+        }
+        return fail();
+      case STATE_DONE:
+        return isSpace(c) || fail();
+      case STATE_FAILED:
+        return false;
+    }
+    return fail();
+  }
+
+  /**
+   * Feed a byte range
+   * @return false once the input is not valid JSON
+   */
+  bool feed(const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      if (!feed(data[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Signal the end of input; completes a number at the end of the document
+   * @return true if exactly one complete value was read
+   */
+  bool finish() {
+    if (state_ == STATE_LITERAL && depth_ == 0) {
+      endLiteral();
+    }
+    return state_ == STATE_DONE;
+  }
+
+  bool failed() const {
+    return state_ == STATE_FAILED;
+  }
+
+  int depth() const {
+    return depth_;
+  }
+
+  const char* key(int level) const {
+    return level >= 1 && level <= depth_ && level <= DOUBAO_STREAM_MAX_DEPTH ? levels_[level - 1].key : "";
+  }
+
+  int index(int level) const {
+    return level >= 1 && level <= depth_ && level <= DOUBAO_STREAM_MAX_DEPTH && !((objectBits_ >> (level - 1)) & 1) ? levels_[level - 1].index : -1;
+  }
+
+private:
+  enum State : uint8_t {
+    STATE_VALUE,
+    STATE_VALUE_OR_END,
+    STATE_KEY_OR_END,
+    STATE_KEY_START,
+    STATE_KEY,
+    STATE_COLON,
+    STATE_STRING,
+    STATE_ESCAPE,
+    STATE_UNICODE,
+    STATE_LITERAL,
+    STATE_AFTER_VALUE,
+    STATE_DONE,
+    STATE_FAILED
+  };
+
+  struct Level {
+    int index;
+    char key[DOUBAO_STREAM_KEY_LENGTH + 1];
+  };
+
+  static bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  bool fail() {
+    state_ = STATE_FAILED;
+    return false;
+  }
+
+  bool topIsObject() const {
+    return (objectBits_ >> (depth_ - 1)) & 1;
+  }
+
+  bool startValue(char c) {
+    if (c == '{' || c == '[') {
+      if (depth_ == 64) {
+        return fail();
+      }
+      depth_++;
+      if (c == '{') {
+        objectBits_ |= 1ULL << (depth_ - 1);
+      } else {
+        objectBits_ &= ~(1ULL << (depth_ - 1));
+      }
+      if (depth_ <= DOUBAO_STREAM_MAX_DEPTH) {
+        levels_[depth_ - 1].index = 0;
+        levels_[depth_ - 1].key[0] = '\0';
+      }
+      state_ = c == '{' ? STATE_KEY_OR_END : STATE_VALUE_OR_END;
+      handler_.onContainerStart(c == '{');
+      return true;
+    }
+    if (c == '"') {
+      state_ = STATE_STRING;
+      handler_.onStringStart();
+      return true;
+    }
+    if (c == '-' || isdigit((unsigned char)c) || c == 't' || c == 'f' || c == 'n') {
+      literal_[0] = c;
+      literalLength_ = 1;
+      state_ = STATE_LITERAL;
+      return true;
+    }
+    return fail();
+  }
+
+  bool closeContainer(bool isObject) {
+    if (depth_ == 0 || topIsObject() != isObject) {
+      return fail();
+    }
+    depth_--;
+    handler_.onContainerEnd(isObject);
+    afterValue();
+    return true;
+  }
+
+  void afterValue() {
+    state_ = depth_ == 0 ? STATE_DONE : STATE_AFTER_VALUE;
+  }
+
+  bool endString() {
+    flushSurrogate();
+    if (inKey_) {
+      inKey_ = false;
+      if (depth_ <= DOUBAO_STREAM_MAX_DEPTH) {
+        // Names too long to keep are reported as "" rather than as a truncated prefix
+        levels_[depth_ - 1].key[keyLength_ <= DOUBAO_STREAM_KEY_LENGTH ? keyLength_ : 0] = '\0';
+      }
+      state_ = STATE_COLON;
+      handler_.onKey();
+      return true;
+    }
+    handler_.onStringEnd();
+    afterValue();
+    return true;
+  }
+
+  bool endLiteral() {
+    literal_[literalLength_] = '\0';
+    bool valid;
+    if (literal_[0] == 't' || literal_[0] == 'f' || literal_[0] == 'n') {
+      valid = strcmp(literal_, "true") == 0 || strcmp(literal_, "false") == 0 || strcmp(literal_, "null") == 0;
+    } else {
+      char* end = nullptr;
+      strtod(literal_, &end);
+      valid = end == literal_ + literalLength_;
+    }
+    if (!valid) {
+      return fail();
+    }
+    handler_.onLiteral(literal_, literalLength_);
+    afterValue();
+    return true;
+  }
+
+  void emit(char c) {
+    if (inKey_) {
+      if (keyLength_ < DOUBAO_STREAM_KEY_LENGTH && depth_ <= DOUBAO_STREAM_MAX_DEPTH) {
+        levels_[depth_ - 1].key[keyLength_] = c;
+      }
+      keyLength_++;
+    } else {
+      handler_.onStringByte(c);
+    }
+  }
+
+  bool escape(char c) {
+    char decoded;
+    switch (c) {
+      case '"': decoded = '"'; break;
+      case '\\': decoded = '\\'; break;
+      case '/': decoded = '/'; break;
+      case 'b': decoded = '\b'; break;
+      case 'f': decoded = '\f'; break;
+      case 'n': decoded = '\n'; break;
+      case 'r': decoded = '\r'; break;
+      case 't': decoded = '\t'; break;
+      case 'u':
+        unicodeDigits_ = 0;
+        unicode_ = 0;
+        state_ = STATE_UNICODE;
+        return true;
+      default:
+        return fail();
+    }
+    flushSurrogate();
+    emit(decoded);
+    state_ = escapeReturn_;
+    return true;
+  }
+
+  bool unicode(char c) {
+    if (!isxdigit((unsigned char)c)) {
+      return fail();
+    }
+    unicode_ = (unicode_ << 4) | (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+    if (++unicodeDigits_ < 4) {
+      return true;
+    }
+    uint32_t codePoint = unicode_;
+    if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+      // High surrogate: wait for the low half
+      flushSurrogate();
+      highSurrogate_ = codePoint;
+      state_ = escapeReturn_;
+      return true;
+    }
+    if (codePoint >= 0xDC00 && codePoint < 0xE000 && highSurrogate_ != 0) {
+      codePoint = 0x10000 + ((highSurrogate_ - 0xD800) << 10) + (codePoint - 0xDC00);
+      highSurrogate_ = 0;
+    } else {
+      flushSurrogate();
+    }
+    emitUtf8(codePoint);
+    state_ = escapeReturn_;
+    return true;
+  }
+
+  // A high surrogate without its low half becomes U+FFFD
+  void flushSurrogate() {
+    if (highSurrogate_ != 0) {
+      highSurrogate_ = 0;
+      emitUtf8(0xFFFD);
+    }
+  }
+
+  void emitUtf8(uint32_t codePoint) {
+    if (codePoint < 0x80) {
+      emit((char)codePoint);
+    } else if (codePoint < 0x800) {
+      emit((char)(0xC0 | (codePoint >> 6)));
+      emit((char)(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+      emit((char)(0xE0 | (codePoint >> 12)));
+      emit((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+      emit((char)(0x80 | (codePoint & 0x3F)));
+    } else {
+      emit((char)(0xF0 | (codePoint >> 18)));
+      emit((char)(0x80 | ((codePoint >> 12) & 0x3F)));
+      emit((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+      emit((char)(0x80 | (codePoint & 0x3F)));
+    }
+  }
+
+  Handler& handler_;
+  State state_;
+  State escapeReturn_;
+  uint8_t depth_;
+  uint64_t objectBits_;   // Bit n set if level n + 1 is an object
+  bool inKey_;
+  Level levels_[DOUBAO_STREAM_MAX_DEPTH];
+  size_t keyLength_;
+  char literal_[32];
+  size_t literalLength_;
+  uint8_t unicodeDigits_;
+  uint32_t unicode_;
+  uint32_t highSurrogate_;
+};
+
+#endif // DOUBAO_JSON_STREAM_H
@@ -0,0 +1,134 @@
+#include "doubao_keys.h"
+#include "doubao_json_path.h"
+#include "doubao_policies.h"
+
+DoubaoKeyPool::DoubaoKeyPool() : count_(0) {
+}
+
+int DoubaoKeyPool::add(const char* apiKey, float requestsPerMinute, float tokensPerMinute) {
+  if (count_ >= DOUBAO_MAX_KEYS || apiKey == nullptr || strlen(apiKey) == 0 || requestsPerMinute <= 0 || tokensPerMinute <= 0) {
+    Serial.println("Error: Cannot add API key");
+    return -1;
+  }
+  DoubaoSpinLock lock(lock_);
+  DoubaoKeyState& k = keys_[count_];
+  k.apiKey = apiKey;
+  k.requestsPerMinute = requestsPerMinute;
+  k.tokensPerMinute = tokensPerMinute;
+  k.requestsLeft = requestsPerMinute;
+  k.tokensLeft = tokensPerMinute;
+  k.lastRefill = DoubaoClock::now();
+  k.benchedUntil = 0;
+  k.throttles = 0;
+  k.requests = 0;
+  k.tokens = 0;
+  k.throttled = 0;
+  return count_++;
+}
+
+int DoubaoKeyPool::size() const {
+  return count_;
+}
+
+const char* DoubaoKeyPool::key(int index) const {
+  return keys_[index].apiKey;
+}
+
+DoubaoKeyState DoubaoKeyPool::state(int index) const {
+  DoubaoSpinLock lock(lock_);
+  return keys_[index];
+}
+
+void DoubaoKeyPool::refill(DoubaoKeyState& k, unsigned long now) {
+  float minutes = (now - k.lastRefill) / 60000.0f;
+  k.lastRefill = now;
+  k.requestsLeft = min(k.requestsPerMinute, k.requestsLeft + minutes * k.requestsPerMinute);
+  k.tokensLeft = min(k.tokensPerMinute, k.tokensLeft + minutes * k.tokensPerMinute);
+}
+
+int DoubaoKeyPool::acquire() {
+  unsigned long now = DoubaoClock::now();
+  DoubaoSpinLock lock(lock_);
+  int best = -1;
+  float bestScore = 0;
+  for (int i = 0; i < count_; i++) {
+    DoubaoKeyState& k = keys_[i];
+    refill(k, now);
+    if (k.benchedUntil != 0 && (long)(now - k.benchedUntil) < 0) {
+      continue;
+    }
+    k.benchedUntil = 0;
+    if (k.requestsLeft < 1 || k.tokensLeft < 1) {
+      continue;
+    }
+    // Fraction of the tighter of the two budgets still available
+    float score = min(k.requestsLeft / k.requestsPerMinute, k.tokensLeft / k.tokensPerMinute);
+    if (best < 0 || score > bestScore) {
+      best = i;
+      bestScore = score;
+    }
+  }
+  if (best >= 0) {
+    keys_[best].requestsLeft -= 1;
+    keys_[best].requests++;
+  }
+  return best;
+}
+
+void DoubaoKeyPool::record(int index, const String& response, const DoubaoResponseMeta& meta) {
+  // Usage is read straight from the raw body; the full parse happens later
+  long tokens = -1;
+  DoubaoJsonExtractor extractor;
+  int usage = extractor.add("/usage/total_tokens");
+  if (meta.status == 200 && extractor.extract(response) && extractor.has(usage)) {
+    tokens = extractor.value(usage).toInt();
+  }
+  unsigned long bench = 0;
+  {
+    DoubaoSpinLock lock(lock_);
+    DoubaoKeyState& k = keys_[index];
+    if (meta.status == 429) {
+      k.throttled++;
+      if (k.throttles < 8) {
+        k.throttles++;
+      }
+      bench = meta.retryAfterMs;
+      if (bench == 0) {
+        bench = min((unsigned long)DOUBAO_KEY_BENCH_MS << (k.throttles - 1), (unsigned long)DOUBAO_KEY_MAX_BENCH_MS);
+      }
+      k.benchedUntil = DoubaoClock::now() + bench;
+      if (k.benchedUntil == 0) {
+        k.benchedUntil = 1;
+      }
+      k.requestsLeft = 0;
+    } else {
+      if (meta.status == 200) {
+        k.throttles = 0;
+      }
+      if (tokens >= 0) {
+        k.tokens += tokens;
+        k.tokensLeft = max(0.0f, k.tokensLeft - tokens);
+      }
+      if (meta.requestsRemaining >= 0) {
+        k.requestsLeft = min((float)meta.requestsRemaining, k.requestsPerMinute);
+      }
+      if (meta.tokensRemaining >= 0) {
+        k.tokensLeft = min((float)meta.tokensRemaining, k.tokensPerMinute);
+      }
+    }
+  }
+  if (bench > 0) {
+    Serial.printf("API key %d throttled, benched for %lu ms\n", index, bench);
+  }
+}
+
+void DoubaoKeyPool::printStatus(Print& out) const {
+  for (int i = 0; i < count_; i++) {
+    DoubaoKeyState k = state(i);
+    size_t length = strlen(k.apiKey);
+    const char* tail = length > 4 ? k.apiKey + length - 4 : k.apiKey;
+    out.printf("key ...%s: %.0f/%.0f req, %.0f/%.0f tokens left, %u requests, %u tokens, %u throttled%s\n", tail,
+               k.requestsLeft, k.requestsPerMinute, k.tokensLeft, k.tokensPerMinute, (unsigned)k.requests,
+               (unsigned)k.tokens, (unsigned)k.throttled, k.benchedUntil != 0 ? ", benched" : "");
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef DOUBAO_KEYS_H
+#define DOUBAO_KEYS_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+#include "doubao_lock.h"
+
+#define DOUBAO_MAX_KEYS 8
+
+// Bench time after HTTP 429 without Retry-After, doubled per consecutive throttle
+#define DOUBAO_KEY_BENCH_MS 2000
+#define DOUBAO_KEY_MAX_BENCH_MS 60000
+
+/*
+ * Each key has a per-minute request and token budget. Remaining quota is
+ * refilled continuously at the configured rate and charged for every request
+ * and its token usage; x-ratelimit-remaining-* response headers replace the
+ * estimate whenever the server sends them. acquire() returns the key with the
+ * largest remaining fraction of its budget, so load spreads across keys in
+ * proportion to their limits. A throttled key is benched for Retry-After, or
+ * an exponential backoff when the server does not say. All methods may be
+ * called from several tasks; each holds a spinlock for its few field updates.
+ */
+struct DoubaoKeyState {
+  const char* apiKey;
+  float requestsPerMinute;
+  float tokensPerMinute;
+  float requestsLeft;
+  float tokensLeft;
+  unsigned long lastRefill;
+  unsigned long benchedUntil;
+  uint8_t throttles;
+  uint32_t requests;
+  uint32_t tokens;
+  uint32_t throttled;
+};
+
+/**
+ * Pool of API keys used for requests made without an explicit key
+ */
+class DoubaoKeyPool {
+public:
+  DoubaoKeyPool();
+
+  /**
+   * Add a key; the string must stay valid while the pool is in use
+   * @param apiKey API key
+   * @param requestsPerMinute Request limit of the key (default: 60)
+   * @param tokensPerMinute Token limit of the key (default: 100000)
+   * @return Key index, -1 if the pool is full
+   */
+  int add(const char* apiKey, float requestsPerMinute = 60, float tokensPerMinute = 100000);
+
+  /**
+   * Pick the key with the most remaining quota and charge one request to it;
+   * keys with no requests or no tokens left are skipped
+   * @return Key index, -1 if every key is benched or out of quota
+   */
+  int acquire();
+
+  /**
+   * Update a key's quota from the outcome of a request
+   * @param index Key index from acquire()
+   * @param response Raw response body or error code
+   * @param meta Response details of the request
+   */
+  void record(int index, const String& response, const DoubaoResponseMeta& meta);
+
+  /**
+   * @param index Key index
+   * @return API key string
+   */
+  const char* key(int index) const;
+
+  /**
+   * @param index Key index
+   * @return Snapshot of the key's quota state
+   */
+  DoubaoKeyState state(int index) const;
+
+  /**
+   * @return Number of keys
+   */
+  int size() const;
+
+  /**
+   * Print quota and usage of every key (keys are shown by their last 4 characters)
+   * @param out Output stream (e.g. Serial)
+   */
+  void printStatus(Print& out) const;
+
+private:
+  void refill(DoubaoKeyState& k, unsigned long now);
+
+  DoubaoKeyState keys_[DOUBAO_MAX_KEYS];
+  int count_;
+  mutable portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif // DOUBAO_KEYS_H
@@ -0,0 +1,279 @@
+#include "doubao_load.h"
+#include "doubao_lock.h"
+#include "doubao_policies.h"
+#include <math.h>
+
+// Open loop: tells a client task to exit
+#define LOAD_STOP 0xFFFFFFFFUL
+
+#ifndef portNUM_PROCESSORS
+#define portNUM_PROCESSORS 1
+#endif
+
+struct LoadRun {
+  const DoubaoLoadConfig* config;
+  unsigned long deadline;
+  QueueHandle_t arrivals;       // Open loop only
+  SemaphoreHandle_t done;
+  portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+  uint32_t requests = 0;
+  uint32_t failures = 0;
+  uint64_t bytes = 0;
+  unsigned long* samples;
+  uint32_t sampleCount = 0;
+  uint32_t random;
+  volatile bool spinning = false;
+  volatile uint32_t spins[portNUM_PROCESSORS];
+};
+
+static uint32_t nextRandom(uint32_t& state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static void recordRequest(LoadRun* run, unsigned long latencyMs, size_t bytes, bool failed) {
+  DoubaoSpinLock lock(run->lock);
+  run->requests++;
+  run->bytes += bytes;
+  if (failed) {
+    run->failures++;
+  }
+  // Reservoir sampling keeps an unbiased DOUBAO_LOAD_MAX_SAMPLES of any number of requests
+  if (run->sampleCount < DOUBAO_LOAD_MAX_SAMPLES) {
+    run->samples[run->sampleCount++] = latencyMs;
+  } else {
+    uint32_t slot = nextRandom(run->random) % run->requests;
+    if (slot < DOUBAO_LOAD_MAX_SAMPLES) {
+      run->samples[slot] = latencyMs;
+    }
+  }
+}
+
+static void clientTask(void* arg) {
+  LoadRun* run = (LoadRun*)arg;
+  const DoubaoLoadConfig& config = *run->config;
+  String path = config.path;
+  for (;;) {
+    unsigned long start;
+    if (run->arrivals != nullptr) {
+      xQueueReceive(run->arrivals, &start, portMAX_DELAY);
+      if (start == LOAD_STOP) {
+        break;
+      }
+    } else {
+      start = DoubaoClock::now();
+      if ((long)(start - run->deadline) >= 0) {
+        break;
+      }
+    }
+    DoubaoResponseMeta meta;
+    String response = sendApiRequest(path, config.payload, config.apiKey, &meta);
+    bool failed = isErrorResponse(response);
+    recordRequest(run, DoubaoClock::now() - start, config.payload.length() + (failed ? 0 : response.length()), failed);
+    if (run->arrivals == nullptr && config.thinkMs > 0) {
+      DoubaoClock::sleep(config.thinkMs);
+    }
+  }
+  xSemaphoreGive(run->done);
+  vTaskDelete(nullptr);
+}
+
+// Counts while nothing else wants this core; yields now and then so the idle task still runs
+static void spinTask(void* arg) {
+  LoadRun* run = (LoadRun*)arg;
+  int core = xPortGetCoreID();
+  while (run->spinning) {
+    run->spins[core]++;
+    if ((run->spins[core] & 0x3FF) == 0) {
+      taskYIELD();
+    }
+  }
+  xSemaphoreGive(run->done);
+  vTaskDelete(nullptr);
+}
+
+static bool startSpinners(LoadRun* run) {
+  run->spinning = true;
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    run->spins[core] = 0;
+    if (xTaskCreatePinnedToCore(spinTask, "doubao_idle", 2048, run, tskIDLE_PRIORITY, nullptr, core) != pdPASS) {
+      run->spinning = false;
+      for (int started = 0; started < core; started++) {
+        xSemaphoreTake(run->done, portMAX_DELAY);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint64_t stopSpinners(LoadRun* run) {
+  run->spinning = false;
+  uint64_t total = 0;
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    xSemaphoreTake(run->done, portMAX_DELAY);
+  }
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    total += run->spins[core];
+  }
+  return total;
+}
+
+static int compareLatency(const void* a, const void* b) {
+  unsigned long x = *(const unsigned long*)a;
+  unsigned long y = *(const unsigned long*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Nearest-rank percentile of a sorted array
+static unsigned long percentile(const unsigned long* sorted, uint32_t count, int p) {
+  if (count == 0) {
+    return 0;
+  }
+  uint32_t rank = (count * p + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+bool doubaoRunLoad(const DoubaoLoadConfig& config, int clients, DoubaoLoadResult* result) {
+  *result = DoubaoLoadResult();
+  result->clients = clients;
+  if (clients < 1 || clients > DOUBAO_LOAD_MAX_CLIENTS) {
+    Serial.printf("Error: Client count must be 1 to %d\n", DOUBAO_LOAD_MAX_CLIENTS);
+    return false;
+  }
+  if (config.payload.length() == 0 || (config.arrival == DOUBAO_OPEN_LOOP && config.requestsPerSecond <= 0)) {
+    Serial.println("Error: Load payload or arrival rate not set");
+    return false;
+  }
+  LoadRun run;
+  run.config = &config;
+  run.random = config.seed != 0 ? config.seed : 1;
+  run.arrivals = nullptr;
+  run.samples = (unsigned long*)malloc(DOUBAO_LOAD_MAX_SAMPLES * sizeof(unsigned long));
+  run.done = xSemaphoreCreateCounting(DOUBAO_LOAD_MAX_CLIENTS + portNUM_PROCESSORS, 0);
+  if (config.arrival == DOUBAO_OPEN_LOOP) {
+    run.arrivals = xQueueCreate(DOUBAO_LOAD_QUEUE_LENGTH, sizeof(unsigned long));
+  }
+  bool ok = run.samples != nullptr && run.done != nullptr && (config.arrival == DOUBAO_CLOSED_LOOP || run.arrivals != nullptr);
+  if (!ok) {
+    Serial.println("Error: Out of memory for load run");
+  }
+
+  // Idle rate without load
+  uint64_t idleSpins = 0;
+  bool measureCpu = ok && config.measureCpu && startSpinners(&run);
+  if (measureCpu) {
+    unsigned long calibrationStart = DoubaoClock::now();
+    DoubaoClock::sleep(DOUBAO_LOAD_CALIBRATION_MS);
+    unsigned long calibrationMs = DoubaoClock::now() - calibrationStart;
+    idleSpins = stopSpinners(&run) * 1000 / max(calibrationMs, 1UL);
+    measureCpu = idleSpins > 0 && startSpinners(&run);
+  }
+
+  int started = 0;
+  unsigned long begun = DoubaoClock::now();
+  run.deadline = begun + config.durationMs;
+  for (; ok && started < clients; started++) {
+    if (xTaskCreate(clientTask, "doubao_load", config.stackSize, &run, config.priority, nullptr) != pdPASS) {
+      Serial.println("Error: Failed to start load client");
+      // Closed-loop clients already running stop at the deadline; stop open-loop ones now
+      run.deadline = DoubaoClock::now();
+      ok = false;
+      break;
+    }
+  }
+  if (ok && config.arrival == DOUBAO_OPEN_LOOP) {
+    // Poisson arrivals: exponential gaps with mean 1000 / requestsPerSecond ms
+    float meanGapMs = 1000.0f / config.requestsPerSecond;
+    float offsetMs = 0;
+    while (offsetMs < config.durationMs) {
+      unsigned long due = begun + (unsigned long)offsetMs;
+      long wait = (long)(due - DoubaoClock::now());
+      if (wait > 0) {
+        DoubaoClock::sleep(wait);
+      }
+      if (xQueueSend(run.arrivals, &due, 0) != pdTRUE) {
+        result->dropped++;
+      }
+      float u = (nextRandom(run.random) >> 8) / 16777216.0f;
+      offsetMs += -logf(1.0f - u) * meanGapMs;
+    }
+  }
+  if (run.arrivals != nullptr) {
+    unsigned long stop = LOAD_STOP;
+    for (int i = 0; i < started; i++) {
+      xQueueSend(run.arrivals, &stop, portMAX_DELAY);
+    }
+  }
+  for (int i = 0; i < started; i++) {
+    xSemaphoreTake(run.done, portMAX_DELAY);
+  }
+  result->elapsedMs = DoubaoClock::now() - begun;
+  uint64_t loadSpins = measureCpu ? stopSpinners(&run) : 0;
+
+  result->requests = run.requests;
+  result->failures = run.failures;
+  if (result->elapsedMs > 0) {
+    result->requestsPerSecond = run.requests * 1000.0f / result->elapsedMs;
+    result->bytesPerSecond = run.bytes * 1000.0f / result->elapsedMs;
+  }
+  if (measureCpu && run.requests > 0) {
+    // Share of the cores' capacity the idle counters lost to the run
+    float busy = 1.0f - (float)loadSpins * 1000 / max(result->elapsedMs, 1UL) / idleSpins;
+    busy = constrain(busy, 0.0f, 1.0f);
+    result->cpuMsPerRequest = busy * portNUM_PROCESSORS * result->elapsedMs / run.requests;
+  }
+  if (run.samples != nullptr) {
+    qsort(run.samples, run.sampleCount, sizeof(unsigned long), compareLatency);
+    result->latencyP50Ms = percentile(run.samples, run.sampleCount, 50);
+    result->latencyP90Ms = percentile(run.samples, run.sampleCount, 90);
+    result->latencyP99Ms = percentile(run.samples, run.sampleCount, 99);
+    result->latencyMaxMs = percentile(run.samples, run.sampleCount, 100);
+    free(run.samples);
+  }
+  if (run.arrivals != nullptr) {
+    vQueueDelete(run.arrivals);
+  }
+  if (run.done != nullptr) {
+    vSemaphoreDelete(run.done);
+  }
+  return ok;
+}
+
+int doubaoLoadSweep(const DoubaoLoadConfig& config, const int* clientCounts, int steps, DoubaoLoadResult* results, Print* out) {
+  if (out != nullptr) {
+    printLoadHeader(*out);
+  }
+  int ran = 0;
+  for (int i = 0; i < steps; i++) {
+    DoubaoLoadResult result;
+    if (!doubaoRunLoad(config, clientCounts[i], &result)) {
+      break;
+    }
+    if (results != nullptr) {
+      results[i] = result;
+    }
+    if (out != nullptr) {
+      printLoadResult(result, *out);
+    }
+    ran++;
+  }
+  return ran;
+}
+
+void printLoadHeader(Print& out) {
+  out.println("clients  requests  failed  dropped   req/s    bytes/s  cpu ms/req   p50 ms   p90 ms   p99 ms   max ms");
+}
+
+void printLoadResult(const DoubaoLoadResult& result, Print& out) {
+  out.printf("%7d  %8u  %6u  %7u  %6.2f  %9.0f  ", result.clients, (unsigned)result.requests, (unsigned)result.failures,
+             (unsigned)result.dropped, result.requestsPerSecond, result.bytesPerSecond);
+  if (result.cpuMsPerRequest >= 0) {
+    out.printf("%10.2f  ", result.cpuMsPerRequest);
+  } else {
+    out.printf("%10s  ", "-");
+  }
+  out.printf("%7lu  %7lu  %7lu  %7lu\n", result.latencyP50Ms, result.latencyP90Ms, result.latencyP99Ms, result.latencyMaxMs);
+}
@@ -0,0 +1,100 @@
+#ifndef DOUBAO_LOAD_H
+#define DOUBAO_LOAD_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+
+// Each client beyond the endpoint's kept-alive connection opens a TLS
+// connection of its own, about 40 KB of heap: more than 4 do not fit
+#define DOUBAO_LOAD_MAX_CLIENTS 4
+#define DOUBAO_LOAD_MAX_SAMPLES 1024        // Latencies kept per run (reservoir sample)
+#define DOUBAO_LOAD_QUEUE_LENGTH 64         // Open loop: arrivals waiting for a free client
+#define DOUBAO_LOAD_CALIBRATION_MS 250      // Idle measurement before each run
+
+/*
+ * Load generator: N client tasks send the same request through
+ * sendApiRequest() at once, so they share the endpoint pool, key pool and
+ * allocator like the tasks of a gateway do. Point sendApiRequest() at a
+ * stand-in server with setEndpointPool() first, and compare runs with growing
+ * N: where requests/s stops growing while CPU per request rises, a shared lock
+ * or the allocator is the bottleneck.
+ *
+ * Arrival models:
+ * - Closed loop: each client sends its next request when the previous one is
+ *   answered (after thinkMs). Throughput is limited by latency.
+ * - Open loop: requests arrive at requestsPerSecond (Poisson, from the
+ *   calling task) whether or not earlier ones are done; latency counts from
+ *   the arrival, so queueing delay shows up instead of being hidden.
+ *
+ * CPU per request comes from idle counting: a lowest-priority task per core
+ * counts while the CPU has nothing else to do, and the drop of its rate
+ * against an unloaded calibration is the CPU the run used.
+ */
+enum DoubaoArrival : uint8_t {
+  DOUBAO_CLOSED_LOOP,
+  DOUBAO_OPEN_LOOP
+};
+
+struct DoubaoLoadConfig {
+  DoubaoArrival arrival = DOUBAO_CLOSED_LOOP;
+  unsigned long thinkMs = 0;           // Closed loop: pause between a response and the client's next request
+  float requestsPerSecond = 10;        // Open loop: total arrival rate of all clients
+  unsigned long durationMs = 10000;    // Time requests are started for, per run
+  const char* path = DOUBAO_CHAT_PATH;
+  String payload;                      // Sent by every request
+  const char* apiKey = nullptr;        // nullptr to use the key pool
+  bool measureCpu = true;
+  uint32_t stackSize = 8192;           // Per client task
+  UBaseType_t priority = 1;
+  uint32_t seed = 1;                   // Arrival times and sampling
+};
+
+struct DoubaoLoadResult {
+  int clients = 0;
+  uint32_t requests = 0;
+  uint32_t failures = 0;
+  uint32_t dropped = 0;                // Open loop: arrivals that found the queue full
+  unsigned long elapsedMs = 0;
+  float requestsPerSecond = 0;
+  float bytesPerSecond = 0;            // Request and response bytes
+  float cpuMsPerRequest = -1;          // -1 if not measured
+  unsigned long latencyP50Ms = 0;
+  unsigned long latencyP90Ms = 0;
+  unsigned long latencyP99Ms = 0;
+  unsigned long latencyMaxMs = 0;
+};
+
+/**
+ * Run one load step
+ * @param config Load settings; must stay valid during the run
+ * @param clients Number of client tasks (1 to DOUBAO_LOAD_MAX_CLIENTS)
+ * @param result Output
+ * @return true on success, false if the run could not be started
+ */
+bool doubaoRunLoad(const DoubaoLoadConfig& config, int clients, DoubaoLoadResult* result);
+
+/**
+ * Run one step per client count, printing each result as it completes
+ * @param config Load settings
+ * @param clientCounts Client counts to run, e.g. {1, 2, 3, 4}
+ * @param steps Number of entries in clientCounts
+ * @param results Output array of steps entries (optional)
+ * @param out Output stream for the table (e.g. Serial), nullptr for none
+ * @return Number of steps that ran
+ */
+int doubaoLoadSweep(const DoubaoLoadConfig& config, const int* clientCounts, int steps, DoubaoLoadResult* results, Print* out);
+
+/**
+ * Print the column headings of printLoadResult()
+ * @param out Output stream
+ */
+void printLoadHeader(Print& out);
+
+/**
+ * Print one result as a table row
+ * @param result Result of doubaoRunLoad()
+ * @param out Output stream
+ */
+void printLoadResult(const DoubaoLoadResult& result, Print& out);
+
+#endif // DOUBAO_LOAD_H
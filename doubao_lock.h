@@ -0,0 +1,49 @@
+#ifndef DOUBAO_LOCK_H
+#define DOUBAO_LOCK_H
+
+#include <Arduino.h>
+
+/*
+ * Scoped locks for state shared between FreeRTOS tasks.
+ *
+ * DoubaoSpinLock guards a few field updates (counters, smoothed averages):
+ * it is a critical section, so nothing inside may block, allocate or log.
+ * DoubaoMutexLock guards longer work (a cache scan, a connection in use) and
+ * lets other tasks run while it waits. A null mutex is not locked, so objects
+ * whose mutex is created in begin() work before that too.
+ */
+class DoubaoSpinLock {
+public:
+  explicit DoubaoSpinLock(portMUX_TYPE& mux) : mux_(mux) {
+    portENTER_CRITICAL(&mux_);
+  }
+  ~DoubaoSpinLock() {
+    portEXIT_CRITICAL(&mux_);
+  }
+  DoubaoSpinLock(const DoubaoSpinLock&) = delete;
+  DoubaoSpinLock& operator=(const DoubaoSpinLock&) = delete;
+
+private:
+  portMUX_TYPE& mux_;
+};
+
+class DoubaoMutexLock {
+public:
+  explicit DoubaoMutexLock(SemaphoreHandle_t mutex) : mutex_(mutex) {
+    if (mutex_ != nullptr) {
+      xSemaphoreTake(mutex_, portMAX_DELAY);
+    }
+  }
+  ~DoubaoMutexLock() {
+    if (mutex_ != nullptr) {
+      xSemaphoreGive(mutex_);
+    }
+  }
+  DoubaoMutexLock(const DoubaoMutexLock&) = delete;
+  DoubaoMutexLock& operator=(const DoubaoMutexLock&) = delete;
+
+private:
+  SemaphoreHandle_t mutex_;
+};
+
+#endif // DOUBAO_LOCK_H
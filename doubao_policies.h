@@ -0,0 +1,238 @@
+#ifndef DOUBAO_POLICIES_H
+#define DOUBAO_POLICIES_H
+
+#include <Arduino.h>
+#include "doubao_lock.h"
+#include "doubao_socket.h"
+
+/*
+ * Compile-time policies for DoubaoClient and the HTTP helpers. A policy is any
+ * type with the members below; calls are resolved statically, so there is no
+ * virtual dispatch and unused policies cost nothing.
+ *
+ *   Clock:     static unsigned long now();            milliseconds
+ *              static void sleep(unsigned long ms);
+ *              static void waitReadable(int socket, unsigned long ms);
+ *                                                     return once socket has data or is closed, or
+ *                                                     ms passed; socket -1: sleep a short interval
+ *   Logger:    static void log(const char* format, ...);  printf style
+ *   Allocator: void* allocate(size_t size);           ArduinoJson allocator concept
+ *              void* reallocate(void* ptr, size_t size);
+ *              void deallocate(void* ptr);
+ */
+
+// millis()/delay(), lwIP select() for sockets
+struct DoubaoMillisClock {
+  static unsigned long now() {
+    return millis();
+  }
+  static void sleep(unsigned long ms) {
+    delay(ms);
+  }
+  static void waitReadable(int socket, unsigned long ms) {
+    if (socket < 0) {
+      delay(min(ms, (unsigned long)DOUBAO_POLL_INTERVAL_MS));
+    } else {
+      doubaoSocketWait(socket, false, ms);
+    }
+  }
+};
+
+/*
+ * Virtual time for host-side tests and benchmarks. now() only moves when code
+ * sleeps or waits, or the test calls set()/advance(), so a 300 s timeout or a
+ * retry backoff passes instantly and every run gives the same latencies.
+ *
+ * A fake connection that has nothing to read yet calls wakeAt() with the time
+ * its next bytes arrive; waitReadable() then jumps to that time instead of to
+ * the end of the wait. Meant for one task: the state is not locked. Use it
+ * only as the explicit Clock parameter of a client, transport or HTTP helper
+ * under test, with connections that never touch a real socket.
+ */
+struct DoubaoVirtualClock {
+  static unsigned long now() {
+    return state().now;
+  }
+  static void sleep(unsigned long ms) {
+    advance(ms);
+  }
+  static void waitReadable(int socket, unsigned long ms) {
+    State& s = state();
+    unsigned long target = s.now + ms;
+    if (s.wakeSet && (long)(s.wake - s.now) > 0 && (long)(s.wake - target) < 0) {
+      target = s.wake;
+    }
+    set(target);
+  }
+
+  /**
+   * Jump to a point in time; a pending wake-up at or before it is cleared
+   * @param ms New time
+   */
+  static void set(unsigned long ms) {
+    State& s = state();
+    s.now = ms;
+    if (s.wakeSet && (long)(s.wake - ms) <= 0) {
+      s.wakeSet = false;
+    }
+  }
+
+  /**
+   * @param ms Time to move forward
+   */
+  static void advance(unsigned long ms) {
+    set(state().now + ms);
+  }
+
+  /**
+   * Make the next waitReadable() return no later than a point in time; the earliest request wins
+   * @param ms Time something becomes readable
+   */
+  static void wakeAt(unsigned long ms) {
+    State& s = state();
+    if (!s.wakeSet || (long)(ms - s.wake) < 0) {
+      s.wake = ms;
+      s.wakeSet = true;
+    }
+  }
+
+  /**
+   * Back to time 0 with no wake-up pending, for the next test
+   */
+  static void reset() {
+    state() = State();
+  }
+
+private:
+  struct State {
+    unsigned long now = 0;
+    unsigned long wake = 0;
+    bool wakeSet = false;
+  };
+  static State& state() {
+    static State s;
+    return s;
+  }
+};
+
+// Tell a clock with wakeAt() (DoubaoVirtualClock) when held-back data becomes readable; other clocks need nothing
+template <class Clock>
+auto doubaoClockWake(unsigned long at, int) -> decltype(Clock::wakeAt(at)) {
+  Clock::wakeAt(at);
+}
+
+template <class Clock>
+void doubaoClockWake(unsigned long at, long) {
+}
+
+template <class Clock>
+void doubaoClockWake(unsigned long at) {
+  doubaoClockWake<Clock>(at, 0);
+}
+
+/*
+ * Library-wide clock: the default Clock policy of the templates, and the time
+ * source of the key pool, endpoint pool, router, spool and other non-template
+ * code. It is always real time: those are shared between tasks, and the
+ * virtual clock is neither locked nor tied to real sockets. Tests select
+ * DoubaoVirtualClock as an explicit Clock parameter instead.
+ */
+typedef DoubaoMillisClock DoubaoClock;
+
+// Serial.printf()
+struct DoubaoSerialLogger {
+  template <typename... Args>
+  static void log(const char* format, Args... args) {
+    Serial.printf(format, args...);
+  }
+};
+
+// Drops all messages
+struct DoubaoNullLogger {
+  template <typename... Args>
+  static void log(const char* format, Args... args) {
+  }
+};
+
+// Internal heap
+struct DoubaoHeapAllocator {
+  void* allocate(size_t size) {
+    return malloc(size);
+  }
+  void* reallocate(void* ptr, size_t size) {
+    return realloc(ptr, size);
+  }
+  void deallocate(void* ptr) {
+    free(ptr);
+  }
+};
+
+// External PSRAM, keeps large JSON documents off the internal heap
+struct DoubaoPsramAllocator {
+  void* allocate(size_t size) {
+    return ps_malloc(size);
+  }
+  void* reallocate(void* ptr, size_t size) {
+    return ps_realloc(ptr, size);
+  }
+  void deallocate(void* ptr) {
+    free(ptr);
+  }
+};
+
+// Totals for the allocations made through DoubaoCountingAllocator; updates
+// from several tasks are serialized, reads are a best-effort snapshot
+struct DoubaoAllocationStats {
+  uint32_t count = 0;          // Allocations and reallocations
+  uint32_t largeCount = 0;     // Of those, at least largeThreshold bytes
+  size_t largeThreshold = 0;   // 0 disables largeCount
+  size_t bytes = 0;            // Sum of requested sizes
+  size_t largest = 0;          // Largest single request
+  portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+  void reset(size_t threshold = 0) {
+    DoubaoSpinLock guard(lock);
+    count = 0;
+    largeCount = 0;
+    largeThreshold = threshold;
+    bytes = 0;
+    largest = 0;
+  }
+
+  void record(size_t size) {
+    DoubaoSpinLock guard(lock);
+    count++;
+    bytes += size;
+    if (size > largest) {
+      largest = size;
+    }
+    if (largeThreshold > 0 && size >= largeThreshold) {
+      largeCount++;
+    }
+  }
+};
+
+// Process-wide counters shared by every DoubaoCountingAllocator
+inline DoubaoAllocationStats& doubaoAllocationStats() {
+  static DoubaoAllocationStats stats;
+  return stats;
+}
+
+// Counts allocations into doubaoAllocationStats(), then defers to Base
+template <class Base = DoubaoHeapAllocator>
+struct DoubaoCountingAllocator {
+  void* allocate(size_t size) {
+    doubaoAllocationStats().record(size);
+    return base.allocate(size);
+  }
+  void* reallocate(void* ptr, size_t size) {
+    doubaoAllocationStats().record(size);
+    return base.reallocate(ptr, size);
+  }
+  void deallocate(void* ptr) {
+    base.deallocate(ptr);
+  }
+  Base base;
+};
+
+#endif // DOUBAO_POLICIES_H
@@ -0,0 +1,456 @@
+#include "doubao_roi.h"
+#include "doubao_lock.h"
+#include <img_converters.h>
+#include <esp_jpg_decode.h>
+#include <base64.h>
+
+#define ROI_GRID_BLOCKS (DOUBAO_ROI_GRID_COLS * DOUBAO_ROI_GRID_ROWS)
+#define ROI_SAMPLE_STEP 4
+#define ROI_DECODE_MIN_WIDTH (DOUBAO_ROI_GRID_COLS * 4)  // Decoded JPEG width that still gives 4-pixel blocks
+
+static camera_fb_t* defaultFrameSource() {
+  return esp_camera_fb_get();
+}
+
+static void defaultFrameRelease(camera_fb_t* fb) {
+  esp_camera_fb_return(fb);
+}
+
+static DoubaoFrameSource frameSource = defaultFrameSource;
+static DoubaoFrameRelease frameRelease = defaultFrameRelease;
+
+// Block means of the previous frame for motion detection, shared by all callers
+static uint8_t previousGrid[ROI_GRID_BLOCKS];
+static size_t previousWidth = 0;
+static size_t previousHeight = 0;
+static portMUX_TYPE previousLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Raw pixel view of a frame, decoded from JPEG when needed
+struct RawFrame {
+  const uint8_t* buf;
+  size_t width;
+  size_t height;
+  pixformat_t format;
+  uint8_t bytesPerPixel;
+  uint8_t* owned;
+};
+
+void setFrameSource(DoubaoFrameSource source, DoubaoFrameRelease release) {
+  frameSource = source != nullptr ? source : defaultFrameSource;
+  frameRelease = release != nullptr ? release : defaultFrameRelease;
+}
+
+camera_fb_t* captureFrame() {
+  return frameSource();
+}
+
+void releaseFrame(camera_fb_t* fb) {
+  if (fb != nullptr) {
+    frameRelease(fb);
+  }
+}
+
+static uint8_t bytesPerPixel(pixformat_t format) {
+  switch (format) {
+    case PIXFORMAT_GRAYSCALE: return 1;
+    case PIXFORMAT_RGB565: return 2;
+    case PIXFORMAT_RGB888: return 3;
+    default: return 0;
+  }
+}
+
+static uint8_t pixelLuma(const uint8_t* buf, size_t index, pixformat_t format) {
+  if (format == PIXFORMAT_GRAYSCALE) {
+    return buf[index];
+  }
+  if (format == PIXFORMAT_RGB565) {
+    // esp32-camera stores RGB565 big-endian
+    uint16_t px = ((uint16_t)buf[index * 2] << 8) | buf[index * 2 + 1];
+    uint16_t r = (px >> 11) << 3;
+    uint16_t g = ((px >> 5) & 0x3F) << 2;
+    uint16_t b = (px & 0x1F) << 3;
+    return (uint8_t)((r * 77 + g * 150 + b * 29) >> 8);
+  }
+  const uint8_t* p = buf + index * 3;
+  return (uint8_t)((p[2] * 77 + p[1] * 150 + p[0] * 29) >> 8);
+}
+
+// Luma source for the block statistics: a raw frame, or a JPEG frame decoded
+// once into a small grayscale image
+struct LumaFrame {
+  const uint8_t* buf;
+  size_t width;
+  size_t height;
+  pixformat_t format;
+  size_t step;      // Sample every step-th pixel in both directions
+  uint8_t* owned;
+};
+
+// Decoder state shared by the JPEG reader and writer callbacks
+struct JpegLuma {
+  const camera_fb_t* fb;
+  uint8_t* out;
+  size_t width;
+  size_t height;
+};
+
+static size_t readJpeg(void* arg, size_t index, uint8_t* buf, size_t len) {
+  JpegLuma* jpeg = (JpegLuma*)arg;
+  if (buf != nullptr) {
+    memcpy(buf, jpeg->fb->buf + index, len);
+  }
+  return len;
+}
+
+// The decoder hands over RGB888 blocks; only their luma is kept
+static bool writeJpegLuma(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+  JpegLuma* jpeg = (JpegLuma*)arg;
+  if (data == nullptr) {
+    // Start (at 0,0) and end markers; the start carries the output size
+    return x != 0 || y != 0 || (w <= jpeg->width && h <= jpeg->height);
+  }
+  for (uint16_t row = 0; row < h && y + row < jpeg->height; row++) {
+    uint8_t* dst = jpeg->out + (y + row) * jpeg->width + x;
+    const uint8_t* src = data + row * w * 3;
+    for (uint16_t col = 0; col < w && x + col < jpeg->width; col++) {
+      const uint8_t* p = src + col * 3;
+      dst[col] = (uint8_t)((p[0] * 77 + p[1] * 150 + p[2] * 29) >> 8);
+    }
+  }
+  return true;
+}
+
+static bool openLumaFrame(const camera_fb_t* fb, LumaFrame* luma) {
+  luma->owned = nullptr;
+  if (fb == nullptr) {
+    return false;
+  }
+  if (fb->format != PIXFORMAT_JPEG) {
+    luma->buf = fb->buf;
+    luma->width = fb->width;
+    luma->height = fb->height;
+    luma->format = fb->format;
+    luma->step = ROI_SAMPLE_STEP;
+    return bytesPerPixel(fb->format) != 0;
+  }
+  // Largest decoder scale-down that still leaves a few pixels per block
+  int shift = 3;
+  while (shift > 0 && (fb->width >> shift) < ROI_DECODE_MIN_WIDTH) {
+    shift--;
+  }
+  JpegLuma jpeg = {fb, nullptr, fb->width >> shift, fb->height >> shift};
+  jpeg.out = (uint8_t*)calloc(jpeg.width * jpeg.height, 1);
+  if (jpeg.out == nullptr) {
+    Serial.println("Error: Not enough memory to decode frame");
+    return false;
+  }
+  if (esp_jpg_decode(fb->len, (jpg_scale_t)shift, readJpeg, writeJpegLuma, &jpeg) != ESP_OK) {
+    Serial.println("Error: Failed to decode JPEG frame");
+    free(jpeg.out);
+    return false;
+  }
+  luma->buf = jpeg.out;
+  luma->width = jpeg.width;
+  luma->height = jpeg.height;
+  luma->format = PIXFORMAT_GRAYSCALE;
+  luma->step = 1;
+  luma->owned = jpeg.out;
+  return true;
+}
+
+// Per-block mean luma and mean absolute deviation over sampled pixels
+static bool computeBlockStats(const LumaFrame& luma, uint8_t* means, uint8_t* contrast) {
+  size_t blockW = luma.width / DOUBAO_ROI_GRID_COLS;
+  size_t blockH = luma.height / DOUBAO_ROI_GRID_ROWS;
+  if (blockW == 0 || blockH == 0) {
+    return false;
+  }
+  for (int row = 0; row < DOUBAO_ROI_GRID_ROWS; row++) {
+    for (int col = 0; col < DOUBAO_ROI_GRID_COLS; col++) {
+      size_t x0 = col * blockW, x1 = x0 + blockW;
+      size_t y0 = row * blockH, y1 = y0 + blockH;
+      uint32_t sum = 0;
+      uint32_t count = 0;
+      for (size_t y = y0; y < y1; y += luma.step) {
+        for (size_t x = x0; x < x1; x += luma.step) {
+          sum += pixelLuma(luma.buf, y * luma.width + x, luma.format);
+          count++;
+        }
+      }
+      uint8_t mean = count > 0 ? (uint8_t)(sum / count) : 0;
+      int block = row * DOUBAO_ROI_GRID_COLS + col;
+      means[block] = mean;
+      if (contrast != nullptr) {
+        // Second pass over the same samples, so the deviation covers the whole block
+        uint32_t deviation = 0;
+        for (size_t y = y0; y < y1; y += luma.step) {
+          for (size_t x = x0; x < x1; x += luma.step) {
+            deviation += abs((int)pixelLuma(luma.buf, y * luma.width + x, luma.format) - (int)mean);
+          }
+        }
+        contrast[block] = count > 0 ? (uint8_t)(deviation / count) : 0;
+      }
+    }
+  }
+  return true;
+}
+
+static bool maskToRect(const bool* mask, const camera_fb_t* fb, uint16_t padding, DoubaoRect* roi) {
+  int minCol = DOUBAO_ROI_GRID_COLS, maxCol = -1;
+  int minRow = DOUBAO_ROI_GRID_ROWS, maxRow = -1;
+  for (int row = 0; row < DOUBAO_ROI_GRID_ROWS; row++) {
+    for (int col = 0; col < DOUBAO_ROI_GRID_COLS; col++) {
+      if (mask[row * DOUBAO_ROI_GRID_COLS + col]) {
+        minCol = min(minCol, col);
+        maxCol = max(maxCol, col);
+        minRow = min(minRow, row);
+        maxRow = max(maxRow, row);
+      }
+    }
+  }
+  if (maxCol < 0) {
+    return false;
+  }
+  size_t blockW = fb->width / DOUBAO_ROI_GRID_COLS;
+  size_t blockH = fb->height / DOUBAO_ROI_GRID_ROWS;
+  long x0 = (long)(minCol * blockW) - padding;
+  long y0 = (long)(minRow * blockH) - padding;
+  long x1 = (long)((maxCol + 1) * blockW) + padding;
+  long y1 = (long)((maxRow + 1) * blockH) + padding;
+  x0 = max(x0, 0L);
+  y0 = max(y0, 0L);
+  x1 = min(x1, (long)fb->width);
+  y1 = min(y1, (long)fb->height);
+  roi->x = (uint16_t)x0;
+  roi->y = (uint16_t)y0;
+  roi->width = (uint16_t)(x1 - x0);
+  roi->height = (uint16_t)(y1 - y0);
+  return true;
+}
+
+static bool motionROI(const LumaFrame& luma, const camera_fb_t* fb, DoubaoRect* roi, uint8_t threshold, uint16_t padding) {
+  uint8_t means[ROI_GRID_BLOCKS];
+  if (!computeBlockStats(luma, means, nullptr)) {
+    return false;
+  }
+  bool haveReference;
+  bool mask[ROI_GRID_BLOCKS];
+  {
+    // Compare and replace in one step, so each frame is diffed against exactly one predecessor
+    DoubaoSpinLock lock(previousLock);
+    haveReference = previousWidth == fb->width && previousHeight == fb->height;
+    for (int i = 0; i < ROI_GRID_BLOCKS; i++) {
+      mask[i] = haveReference && abs((int)means[i] - (int)previousGrid[i]) >= threshold;
+    }
+    memcpy(previousGrid, means, sizeof(previousGrid));
+    previousWidth = fb->width;
+    previousHeight = fb->height;
+  }
+  return haveReference && maskToRect(mask, fb, padding, roi);
+}
+
+static bool saliencyROI(const LumaFrame& luma, const camera_fb_t* fb, DoubaoRect* roi, uint16_t padding) {
+  uint8_t means[ROI_GRID_BLOCKS];
+  uint8_t contrast[ROI_GRID_BLOCKS];
+  if (!computeBlockStats(luma, means, contrast)) {
+    return false;
+  }
+  uint32_t total = 0;
+  for (int i = 0; i < ROI_GRID_BLOCKS; i++) {
+    total += contrast[i];
+  }
+  // Blocks clearly above the frame's average contrast are treated as salient
+  uint32_t threshold = max((uint32_t)8, (total * 3) / (ROI_GRID_BLOCKS * 2));
+  bool mask[ROI_GRID_BLOCKS];
+  for (int i = 0; i < ROI_GRID_BLOCKS; i++) {
+    mask[i] = contrast[i] >= threshold;
+  }
+  return maskToRect(mask, fb, padding, roi);
+}
+
+bool computeMotionROI(const camera_fb_t* fb, DoubaoRect* roi, uint8_t threshold, uint16_t padding) {
+  LumaFrame luma;
+  if (roi == nullptr || !openLumaFrame(fb, &luma)) {
+    return false;
+  }
+  bool found = motionROI(luma, fb, roi, threshold, padding);
+  free(luma.owned);
+  return found;
+}
+
+bool computeSaliencyROI(const camera_fb_t* fb, DoubaoRect* roi, uint16_t padding) {
+  LumaFrame luma;
+  if (roi == nullptr || !openLumaFrame(fb, &luma)) {
+    return false;
+  }
+  bool found = saliencyROI(luma, fb, roi, padding);
+  free(luma.owned);
+  return found;
+}
+
+static DoubaoRect clampRect(DoubaoRect r, size_t width, size_t height) {
+  if (r.x >= width) {
+    r.x = 0;
+  }
+  if (r.y >= height) {
+    r.y = 0;
+  }
+  if (r.width == 0 || r.x + r.width > width) {
+    r.width = width - r.x;
+  }
+  if (r.height == 0 || r.y + r.height > height) {
+    r.height = height - r.y;
+  }
+  return r;
+}
+
+static bool openRawFrame(const camera_fb_t* fb, RawFrame* raw) {
+  raw->width = fb->width;
+  raw->height = fb->height;
+  raw->owned = nullptr;
+  if (fb->format != PIXFORMAT_JPEG) {
+    raw->buf = fb->buf;
+    raw->format = fb->format;
+    raw->bytesPerPixel = bytesPerPixel(fb->format);
+    return raw->bytesPerPixel != 0;
+  }
+  raw->owned = (uint8_t*)malloc(fb->width * fb->height * 3);
+  if (raw->owned == nullptr) {
+    Serial.println("Error: Not enough memory to decode frame");
+    return false;
+  }
+  if (!fmt2rgb888(fb->buf, fb->len, fb->format, raw->owned)) {
+    Serial.println("Error: Failed to decode JPEG frame");
+    free(raw->owned);
+    raw->owned = nullptr;
+    return false;
+  }
+  raw->buf = raw->owned;
+  raw->format = PIXFORMAT_RGB888;
+  raw->bytesPerPixel = 3;
+  return true;
+}
+
+static bool encodeRegion(const RawFrame* raw, DoubaoRect r, uint8_t quality, uint8_t** out, size_t* outLen) {
+  size_t rowBytes = r.width * raw->bytesPerPixel;
+  if (r.x == 0 && r.y == 0 && r.width == raw->width && r.height == raw->height) {
+    return fmt2jpg((uint8_t*)raw->buf, rowBytes * r.height, r.width, r.height, raw->format, quality, out, outLen);
+  }
+  uint8_t* crop = (uint8_t*)malloc(rowBytes * r.height);
+  if (crop == nullptr) {
+    Serial.println("Error: Not enough memory to crop frame");
+    return false;
+  }
+  for (size_t row = 0; row < r.height; row++) {
+    const uint8_t* src = raw->buf + ((r.y + row) * raw->width + r.x) * raw->bytesPerPixel;
+    memcpy(crop + row * rowBytes, src, rowBytes);
+  }
+  bool ok = fmt2jpg(crop, rowBytes * r.height, r.width, r.height, raw->format, quality, out, outLen);
+  free(crop);
+  return ok;
+}
+
+bool cropFrameToJpeg(const camera_fb_t* fb, DoubaoRect roi, uint8_t quality, uint8_t** out, size_t* outLen) {
+  if (fb == nullptr || out == nullptr || outLen == nullptr) {
+    return false;
+  }
+  RawFrame raw;
+  if (!openRawFrame(fb, &raw)) {
+    return false;
+  }
+  bool ok = encodeRegion(&raw, clampRect(roi, raw.width, raw.height), quality, out, outLen);
+  free(raw.owned);
+  return ok;
+}
+
+int encodeFrameTiles(const camera_fb_t* fb, DoubaoRect roi, uint8_t cols, uint8_t rows, uint8_t quality, String* tiles) {
+  if (fb == nullptr || tiles == nullptr || cols == 0 || rows == 0) {
+    return 0;
+  }
+  DoubaoRect region = clampRect(roi, fb->width, fb->height);
+  // A whole JPEG frame is sent as captured instead of decoded and encoded again
+  if (fb->format == PIXFORMAT_JPEG && cols == 1 && rows == 1 && region.width == fb->width && region.height == fb->height) {
+    tiles[0] = base64::encode(fb->buf, fb->len);
+    return tiles[0].length() > 0 ? 1 : 0;
+  }
+  RawFrame raw;
+  if (!openRawFrame(fb, &raw)) {
+    return 0;
+  }
+  uint16_t tileW = region.width / cols;
+  uint16_t tileH = region.height / rows;
+  int count = 0;
+  if (tileW > 0 && tileH > 0) {
+    for (uint8_t row = 0; row < rows; row++) {
+      for (uint8_t col = 0; col < cols; col++) {
+        DoubaoRect tile;
+        tile.x = region.x + col * tileW;
+        tile.y = region.y + row * tileH;
+        // Last column/row absorbs the remainder of the division
+        tile.width = col == cols - 1 ? region.width - col * tileW : tileW;
+        tile.height = row == rows - 1 ? region.height - row * tileH : tileH;
+        uint8_t* jpg = nullptr;
+        size_t jpgLen = 0;
+        if (!encodeRegion(&raw, tile, quality, &jpg, &jpgLen)) {
+          Serial.printf("Error: Failed to encode tile %d\n", count);
+          count = 0;
+          break;
+        }
+        tiles[count++] = base64::encode(jpg, jpgLen);
+        free(jpg);
+      }
+    }
+  }
+  free(raw.owned);
+  return count;
+}
+
+String getGPTAnswer_cameraROI(const String& inputText, DoubaoRect roi, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, uint8_t tileCols, uint8_t tileRows, uint8_t quality) {
+  if (!validateConfig(apiKey, modelId, temp)) {
+    return ERROR_INVALID_INPUT;
+  }
+  if (inputText.length() == 0) {
+    Serial.println("Error: Input text is empty");
+    return ERROR_INVALID_INPUT;
+  }
+  tileCols = max(tileCols, (uint8_t)1);
+  tileRows = max(tileRows, (uint8_t)1);
+  if (tileCols * tileRows > DOUBAO_ROI_MAX_TILES) {
+    Serial.printf("Error: Too many tiles (max %d)\n", DOUBAO_ROI_MAX_TILES);
+    return ERROR_INVALID_INPUT;
+  }
+  camera_fb_t* fb = captureFrame();
+  if (fb == nullptr) {
+    Serial.println("Failed to capture image");
+    return ERROR_CAMERA;
+  }
+  DoubaoRect region = roi;
+  if (region.width == 0 || region.height == 0) {
+    // One decode of a JPEG frame serves both detectors
+    LumaFrame luma;
+    bool found = openLumaFrame(fb, &luma) &&
+                 (motionROI(luma, fb, &region, DOUBAO_ROI_MOTION_THRESHOLD, DOUBAO_ROI_PADDING) ||
+                  saliencyROI(luma, fb, &region, DOUBAO_ROI_PADDING));
+    free(luma.owned);
+    if (!found) {
+      region.x = 0;
+      region.y = 0;
+      region.width = fb->width;
+      region.height = fb->height;
+    }
+  }
+  region = clampRect(region, fb->width, fb->height);
+  size_t frameArea = fb->width * fb->height;
+  String tiles[DOUBAO_ROI_MAX_TILES];
+  int tileCount = encodeFrameTiles(fb, region, tileCols, tileRows, quality, tiles);
+  releaseFrame(fb);
+  if (tileCount == 0) {
+    Serial.println("Failed to encode region of interest");
+    return ERROR_CAMERA;
+  }
+  Serial.printf("ROI %ux%u at (%u,%u), %u%% of frame, %d tile(s)\n", region.width, region.height, region.x, region.y,
+                (unsigned)(frameArea > 0 ? (size_t)region.width * region.height * 100 / frameArea : 100), tileCount);
+  String payload = buildPayloadMultiImage(inputText, modelId, systemPrompt, temp, tiles, tileCount, "jpg");
+  Serial.printf("Send camera ROI request, payload length: %d\n", payload.length());
+  return sendHttpRequestWithRetry(payload, apiKey);
+}
@@ -0,0 +1,109 @@
+#ifndef DOUBAO_ROI_H
+#define DOUBAO_ROI_H
+
+#include <Arduino.h>
+#include <esp_camera.h>
+#include "doubao_api.h"
+
+// Motion/saliency block grid used for automatic ROI selection
+#define DOUBAO_ROI_GRID_COLS 16
+#define DOUBAO_ROI_GRID_ROWS 12
+
+// Defaults of the automatic ROI selection
+#define DOUBAO_ROI_MOTION_THRESHOLD 24   // Mean luma change per block that counts as motion
+#define DOUBAO_ROI_PADDING 16            // Pixels added around a detected region
+
+// Upper bound on tiles per request (cols * rows)
+#define DOUBAO_ROI_MAX_TILES 9
+
+// Crop rectangle in frame pixel coordinates. A zero width or height means
+// "select automatically" where an ROI is accepted.
+struct DoubaoRect {
+  uint16_t x;
+  uint16_t y;
+  uint16_t width;
+  uint16_t height;
+};
+
+// Frame capture hooks, defaults to esp_camera_fb_get()/esp_camera_fb_return()
+typedef camera_fb_t* (*DoubaoFrameSource)();
+typedef void (*DoubaoFrameRelease)(camera_fb_t* fb);
+
+/**
+ * Replace the frame source used by the ROI functions
+ * @param source Function returning a captured frame (nullptr on failure)
+ * @param release Function handing the frame back to the driver
+ */
+void setFrameSource(DoubaoFrameSource source, DoubaoFrameRelease release);
+
+/**
+ * Capture a frame from the configured frame source
+ * @return Captured frame, nullptr on failure; hand back with releaseFrame()
+ */
+camera_fb_t* captureFrame();
+
+/**
+ * Return a frame obtained from captureFrame()
+ * @param fb Frame to release
+ */
+void releaseFrame(camera_fb_t* fb);
+
+/**
+ * Compute an ROI from the difference against the previous frame
+ * @param fb Frame (RGB565, RGB888, grayscale, or JPEG decoded at reduced scale)
+ * @param roi Output rectangle covering the changed blocks
+ * @param threshold Mean luma change per block that counts as motion (default: 24)
+ * @param padding Pixels added around the detected region (default: 16)
+ * @return true if motion was found, false otherwise (first frame or no motion)
+ */
+bool computeMotionROI(const camera_fb_t* fb, DoubaoRect* roi, uint8_t threshold = DOUBAO_ROI_MOTION_THRESHOLD, uint16_t padding = DOUBAO_ROI_PADDING);
+
+/**
+ * Compute an ROI from per-block contrast (cheap saliency estimate)
+ * @param fb Frame (RGB565, RGB888, grayscale, or JPEG decoded at reduced scale)
+ * @param roi Output rectangle covering the high-contrast blocks
+ * @param padding Pixels added around the detected region (default: 16)
+ * @return true if a salient region was found, false otherwise
+ */
+bool computeSaliencyROI(const camera_fb_t* fb, DoubaoRect* roi, uint16_t padding = DOUBAO_ROI_PADDING);
+
+/**
+ * Crop a frame region and encode it as JPEG
+ * @param fb Source frame (raw or JPEG; JPEG frames are decoded first)
+ * @param roi Region to keep, clamped to the frame bounds
+ * @param quality JPEG quality (1-100)
+ * @param out Output buffer allocated with malloc(), caller frees
+ * @param outLen Output buffer length
+ * @return true on success, false otherwise
+ */
+bool cropFrameToJpeg(const camera_fb_t* fb, DoubaoRect roi, uint8_t quality, uint8_t** out, size_t* outLen);
+
+/**
+ * Split a frame region into a grid of tiles and base64 encode each as JPEG.
+ * A whole JPEG frame in a single tile is sent as captured (quality is ignored).
+ * @param fb Source frame
+ * @param roi Region to split, clamped to the frame bounds
+ * @param cols Tile columns
+ * @param rows Tile rows
+ * @param quality JPEG quality (1-100)
+ * @param tiles Output array of at least cols * rows entries
+ * @return Number of tiles encoded, 0 on failure
+ */
+int encodeFrameTiles(const camera_fb_t* fb, DoubaoRect roi, uint8_t cols, uint8_t rows, uint8_t quality, String* tiles);
+
+/**
+ * Get GPT answer for a camera photo, uploading only a region of interest
+ * @param inputText Text message to send
+ * @param roi Region to upload; zero width/height selects it from motion, then saliency, then the full frame
+ * @param apiKey API key for authentication
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @param tileCols Tile columns for detail-heavy scenes (default: 1)
+ * @param tileRows Tile rows for detail-heavy scenes (default: 1)
+ * @param quality JPEG quality (default: 80)
+ * @return AI response or error code
+ */
+String getGPTAnswer_cameraROI(const String& inputText, DoubaoRect roi, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, uint8_t tileCols = 1, uint8_t tileRows = 1, uint8_t quality = 80);
+
+#endif // DOUBAO_ROI_H
@@ -0,0 +1,207 @@
+#include "doubao_router.h"
+#include "doubao_policies.h"
+
+// NLMS step size; small enough that one slow outlier does not wreck the fit
+static const float LEARNING_RATE = 0.1f;
+static const float ERROR_ALPHA = 0.1f;
+
+// Rough token count for mixed Chinese/English text (about 3 UTF-8 bytes per token)
+static int estimateTokens(const String& text) {
+  return text.length() / 3 + 1;
+}
+
+static void initStats(DoubaoModelStats& stats, float base, float perInputToken, float perOutputToken) {
+  stats.base = base;
+  stats.perInputToken = perInputToken;
+  stats.perOutputToken = perOutputToken;
+  stats.errorRate = 0;
+  stats.costPer1kTokens = 0;
+  stats.requests = 0;
+  stats.failures = 0;
+  stats.consecutiveFailures = 0;
+  stats.cooldownUntil = 0;
+}
+
+DoubaoModelRouter::DoubaoModelRouter(const String& liteModelId, const String& proModelId)
+    : sloMs_(5000), complexityThreshold_(0.5f) {
+  modelIds_[0] = liteModelId;
+  modelIds_[1] = proModelId;
+  initStats(stats_[0], 400, 0.2f, 15);
+  initStats(stats_[1], 800, 0.4f, 35);
+  totalTokens_[0] = 0;
+  totalTokens_[1] = 0;
+}
+
+void DoubaoModelRouter::setLatencySLO(unsigned long sloMs) {
+  DoubaoSpinLock lock(lock_);
+  sloMs_ = sloMs;
+}
+
+void DoubaoModelRouter::setComplexityThreshold(float score) {
+  DoubaoSpinLock lock(lock_);
+  complexityThreshold_ = score;
+}
+
+void DoubaoModelRouter::setCosts(float liteCost, float proCost) {
+  DoubaoSpinLock lock(lock_);
+  stats_[0].costPer1kTokens = liteCost;
+  stats_[1].costPer1kTokens = proCost;
+}
+
+const String& DoubaoModelRouter::modelId(int model) const {
+  return modelIds_[model];
+}
+
+DoubaoModelStats DoubaoModelRouter::stats(int model) const {
+  DoubaoSpinLock lock(lock_);
+  return stats_[model];
+}
+
+float DoubaoModelRouter::complexity(const String& inputText) {
+  static const char* const cues[] = {
+    "why", "explain", "compare", "analy", "step", "prove", "code", "plan",
+    "为什么", "解释", "分析", "比较", "推理", "步骤", "代码", "计划"
+  };
+  String lower = inputText;
+  lower.toLowerCase();
+  float score = min(1.0f, inputText.length() / 600.0f);
+  for (size_t i = 0; i < sizeof(cues) / sizeof(cues[0]); i++) {
+    if (lower.indexOf(cues[i]) >= 0) {
+      score += 0.25f;
+    }
+  }
+  int questions = 0;
+  for (unsigned int i = 0; i < inputText.length(); i++) {
+    if (inputText[i] == '?') {
+      questions++;
+    }
+  }
+  if (questions > 1) {
+    score += 0.15f;
+  }
+  return min(1.0f, score);
+}
+
+float DoubaoModelRouter::estimateLatency(int model, int inputTokens, int outputTokens) const {
+  DoubaoSpinLock lock(lock_);
+  return predict(model, inputTokens, outputTokens);
+}
+
+// Caller holds lock_
+float DoubaoModelRouter::predict(int model, int inputTokens, int outputTokens) const {
+  const DoubaoModelStats& s = stats_[model];
+  return s.base + s.perInputToken * inputTokens + s.perOutputToken * outputTokens;
+}
+
+// Caller holds lock_
+bool DoubaoModelRouter::available(int model) const {
+  return (long)(DoubaoClock::now() - stats_[model].cooldownUntil) >= 0 || stats_[model].cooldownUntil == 0;
+}
+
+int DoubaoModelRouter::choose(const String& inputText, int expectedOutputTokens, unsigned long sloMs) {
+  // Text analysis runs before taking the lock
+  int inputTokens = estimateTokens(inputText);
+  float score = complexity(inputText);
+  DoubaoSpinLock lock(lock_);
+  if (sloMs == 0) {
+    sloMs = sloMs_;
+  }
+  bool liteUp = available(0);
+  bool proUp = available(1);
+  if (liteUp != proUp) {
+    return liteUp ? 0 : 1;
+  }
+  bool wantPro = score >= complexityThreshold_;
+  if (wantPro && predict(1, inputTokens, expectedOutputTokens) <= sloMs) {
+    return 1;
+  }
+  // Lite misses the SLO and often errors while pro would still meet it
+  if (predict(0, inputTokens, expectedOutputTokens) > sloMs &&
+      predict(1, inputTokens, expectedOutputTokens) <= sloMs) {
+    return 1;
+  }
+  if (stats_[0].errorRate > 0.5f && stats_[1].errorRate < stats_[0].errorRate) {
+    return 1;
+  }
+  return 0;
+}
+
+void DoubaoModelRouter::record(int model, const String& result, const DoubaoResponseMeta& meta) {
+  bool failed = isErrorResponse(result);
+  bool coolingDown = false;
+  {
+    DoubaoSpinLock lock(lock_);
+    DoubaoModelStats& s = stats_[model];
+    s.requests++;
+    s.errorRate += ERROR_ALPHA * ((failed ? 1.0f : 0.0f) - s.errorRate);
+    if (failed) {
+      s.failures++;
+      s.consecutiveFailures++;
+      if (result == ERROR_OVERLOADED || s.consecutiveFailures >= DOUBAO_ROUTER_MAX_FAILURES) {
+        s.cooldownUntil = DoubaoClock::now() + DOUBAO_ROUTER_COOLDOWN_MS;
+        if (s.cooldownUntil == 0) {
+          s.cooldownUntil = 1;
+        }
+        coolingDown = true;
+      }
+    } else {
+      s.consecutiveFailures = 0;
+      s.cooldownUntil = 0;
+      totalTokens_[model] += meta.promptTokens + meta.completionTokens;
+      if (meta.latencyMs > 0 && meta.completionTokens > 0) {
+        // Normalised LMS update; token counts are scaled to hundreds so the
+        // intercept learns at a similar rate to the per-token terms
+        float x[3] = {1.0f, meta.promptTokens / 100.0f, meta.completionTokens / 100.0f};
+        float err = (float)meta.latencyMs - predict(model, meta.promptTokens, meta.completionTokens);
+        float norm = x[0] * x[0] + x[1] * x[1] + x[2] * x[2];
+        float step = LEARNING_RATE * err / norm;
+        s.base = max(0.0f, s.base + step * x[0]);
+        s.perInputToken = max(0.0f, s.perInputToken + step * x[1] / 100.0f);
+        s.perOutputToken = max(0.0f, s.perOutputToken + step * x[2] / 100.0f);
+      }
+    }
+  }
+  if (coolingDown) {
+    Serial.printf("Router: %s cooling down\n", modelIds_[model].c_str());
+  }
+}
+
+void DoubaoModelRouter::printStats(Print& out) const {
+  for (int i = 0; i < 2; i++) {
+    DoubaoModelStats s;
+    uint32_t tokens;
+    {
+      DoubaoSpinLock lock(lock_);
+      s = stats_[i];
+      tokens = totalTokens_[i];
+    }
+    out.printf("%s: %.0f + %.2f/in + %.2f/out ms, errors %.0f%%, %u/%u failed, %u tokens, cost %.4f\n",
+               modelIds_[i].c_str(), s.base, s.perInputToken, s.perOutputToken, s.errorRate * 100,
+               (unsigned)s.failures, (unsigned)s.requests, (unsigned)tokens,
+               tokens * s.costPer1kTokens / 1000.0f);
+  }
+}
+
+String getGPTAnswerRouted(DoubaoModelRouter& router, const String& inputText, const char* apiKey, const String& systemPrompt, float temp, int expectedOutputTokens, unsigned long sloMs) {
+  if (!validateConfig(apiKey, router.modelId(0), temp) || !validateConfig(apiKey, router.modelId(1), temp)) {
+    return ERROR_INVALID_INPUT;
+  }
+  if (inputText.length() == 0) {
+    Serial.println("Error: Input text is empty");
+    return ERROR_INVALID_INPUT;
+  }
+  int model = router.choose(inputText, expectedOutputTokens, sloMs);
+  String result;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    Serial.printf("Routing to %s\n", router.modelId(model).c_str());
+    String payload = buildPayload(inputText, router.modelId(model), systemPrompt, temp, "", "");
+    DoubaoResponseMeta meta;
+    result = sendHttpRequest(payload, apiKey, &meta);
+    router.record(model, result, meta);
+    if (result != ERROR_NETWORK && result != ERROR_TIMEOUT && result != ERROR_OVERLOADED) {
+      break;
+    }
+    model = 1 - model;
+  }
+  return result;
+}
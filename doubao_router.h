@@ -0,0 +1,141 @@
+#ifndef DOUBAO_ROUTER_H
+#define DOUBAO_ROUTER_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+#include "doubao_lock.h"
+
+// Failures in a row that take a model out of rotation for the cooldown period
+#define DOUBAO_ROUTER_MAX_FAILURES 3
+#define DOUBAO_ROUTER_COOLDOWN_MS 30000
+
+/*
+ * Per model the router keeps an online linear latency model
+ *   latencyMs ~= base + perInputToken * inputTokens + perOutputToken * outputTokens
+ * fitted with normalised LMS from every completed request (token counts come
+ * from the response usage block), plus an EWMA error rate. A request goes to
+ * the lite model unless the prompt looks complex; the pro model is only used
+ * if its predicted latency still meets the SLO. Models answering HTTP 429/5xx
+ * or failing repeatedly are skipped until their cooldown expires. One router
+ * may serve several tasks: the statistics are guarded by a spinlock.
+ */
+struct DoubaoModelStats {
+  float base;
+  float perInputToken;
+  float perOutputToken;
+  float errorRate;
+  float costPer1kTokens;
+  uint32_t requests;
+  uint32_t failures;
+  uint8_t consecutiveFailures;
+  unsigned long cooldownUntil;
+};
+
+/**
+ * Picks between a fast "lite" and a capable "pro" model per request
+ */
+class DoubaoModelRouter {
+public:
+  /**
+   * @param liteModelId Fast, cheap model ID
+   * @param proModelId Capable, slower model ID
+   */
+  DoubaoModelRouter(const String& liteModelId, const String& proModelId);
+
+  /**
+   * Set the default latency target
+   * @param sloMs Target end-to-end latency in milliseconds (default: 5000)
+   */
+  void setLatencySLO(unsigned long sloMs);
+
+  /**
+   * Set when a prompt counts as complex enough for the pro model
+   * @param score Complexity score from 0 to 1 (default: 0.5)
+   */
+  void setComplexityThreshold(float score);
+
+  /**
+   * Set the price of each model, used to report spend
+   * @param liteCost Cost per 1000 tokens of the lite model
+   * @param proCost Cost per 1000 tokens of the pro model
+   */
+  void setCosts(float liteCost, float proCost);
+
+  /**
+   * Estimate how demanding a prompt is
+   * @param inputText Prompt text
+   * @return Score from 0 (trivial) to 1 (complex)
+   */
+  static float complexity(const String& inputText);
+
+  /**
+   * Choose the model for a request
+   * @param inputText Prompt text
+   * @param expectedOutputTokens Expected answer length in tokens
+   * @param sloMs Latency target, 0 for the default
+   * @return 0 for the lite model, 1 for the pro model
+   */
+  int choose(const String& inputText, int expectedOutputTokens, unsigned long sloMs = 0);
+
+  /**
+   * Predict the latency of a request
+   * @param model 0 for lite, 1 for pro
+   * @param inputTokens Prompt tokens
+   * @param outputTokens Answer tokens
+   * @return Predicted latency in milliseconds
+   */
+  float estimateLatency(int model, int inputTokens, int outputTokens) const;
+
+  /**
+   * Feed the outcome of a request back into the model
+   * @param model 0 for lite, 1 for pro
+   * @param result Response text or error code
+   * @param meta Response details filled by sendHttpRequest()
+   */
+  void record(int model, const String& result, const DoubaoResponseMeta& meta);
+
+  /**
+   * @param model 0 for lite, 1 for pro
+   * @return Model ID
+   */
+  const String& modelId(int model) const;
+
+  /**
+   * @param model 0 for lite, 1 for pro
+   * @return Snapshot of the model's statistics
+   */
+  DoubaoModelStats stats(int model) const;
+
+  /**
+   * Print latency model, error rate and spend per model
+   * @param out Output stream (e.g. Serial)
+   */
+  void printStats(Print& out) const;
+
+private:
+  bool available(int model) const;
+  float predict(int model, int inputTokens, int outputTokens) const;
+
+  String modelIds_[2];
+  DoubaoModelStats stats_[2];
+  unsigned long sloMs_;
+  float complexityThreshold_;
+  uint32_t totalTokens_[2];
+  mutable portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+};
+
+/**
+ * Get GPT answer from the model the router picks, falling back to the other
+ * model if the first one fails or is overloaded
+ * @param router Model router
+ * @param inputText Text message to send
+ * @param apiKey API key for authentication
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @param expectedOutputTokens Expected answer length in tokens (default: 64)
+ * @param sloMs Latency target, 0 for the router default
+ * @return AI response or error code
+ */
+String getGPTAnswerRouted(DoubaoModelRouter& router, const String& inputText, const char* apiKey, const String& systemPrompt, float temp, int expectedOutputTokens = 64, unsigned long sloMs = 0);
+
+#endif // DOUBAO_ROUTER_H
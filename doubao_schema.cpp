@@ -0,0 +1,343 @@
+#include "doubao_schema.h"
+#include "doubao_client.h"
+#include <errno.h>
+#include <limits.h>
+
+static const char* const fieldTypeNames[] = {"string", "integer", "number", "boolean"};
+
+String doubaoSchemaJson(const DoubaoSchema& schema) {
+  String json;
+  json.reserve(96 + schema.count * 64);
+  json = "{\"type\":\"object\",\"properties\":{";
+  for (int i = 0; i < schema.count; i++) {
+    const DoubaoSchemaField& field = schema.fields[i];
+    if (i > 0) {
+      json += ",";
+    }
+    json += "\"";
+    json += field.name;
+    json += "\":{\"type\":";
+    // Strict mode lists every field as required; optional ones may be null instead
+    if (field.required) {
+      json += "\"" + String(fieldTypeNames[field.type]) + "\"";
+    } else {
+      json += "[\"" + String(fieldTypeNames[field.type]) + "\",\"null\"]";
+    }
+    if (field.type == DOUBAO_FIELD_STRING) {
+      json += ",\"maxLength\":" + String(field.size - 1);
+    }
+    if (field.description != nullptr) {
+      json += ",\"description\":\"" + jsonEscape(field.description) + "\"";
+    }
+    json += "}";
+  }
+  json += "},\"required\":[";
+  for (int i = 0; i < schema.count; i++) {
+    json += i > 0 ? ",\"" : "\"";
+    json += schema.fields[i].name;
+    json += "\"";
+  }
+  json += "],\"additionalProperties\":false}";
+  return json;
+}
+
+String buildStructuredPayload(const String& inputText, const String& modelId, const String& systemPrompt, float temp, const DoubaoSchema& schema) {
+  String payload = buildPayload(inputText, modelId, systemPrompt, temp);
+  // Reopen the top-level object to add response_format
+  payload.remove(payload.length() - 1);
+  payload += ",\"response_format\":{\"type\":\"json_schema\",\"json_schema\":{\"name\":\"";
+  payload += schema.name;
+  payload += "\",\"strict\":true,\"schema\":";
+  payload += doubaoSchemaJson(schema);
+  payload += "}}}";
+  return payload;
+}
+
+DoubaoStructDecoder::DoubaoStructDecoder(const DoubaoSchema& schema, void* target)
+    : schema_(schema), target_((uint8_t*)target), envelopeHandler_{this}, contentHandler_{this},
+      envelope_(envelopeHandler_), content_(contentHandler_) {
+  reset();
+}
+
+void DoubaoStructDecoder::reset() {
+  memset(target_, 0, schema_.size);
+  envelope_.reset();
+  content_.reset();
+  length_ = 0;
+  inContent_ = false;
+  contentSeen_ = false;
+  inFinishReason_ = false;
+  finishReason_[0] = '\0';
+  finishLength_ = 0;
+  promptTokens_ = 0;
+  completionTokens_ = 0;
+  field_ = -1;
+  stringLength_ = 0;
+  set_ = 0;
+  violations_ = 0;
+  error_[0] = '\0';
+}
+
+// Nothing to preallocate: the body is never stored
+void DoubaoStructDecoder::reserve(size_t size) {
+}
+
+bool DoubaoStructDecoder::append(DoubaoStringView data) {
+  length_ += data.length;
+  return envelope_.feed(data.data, data.length);
+}
+
+size_t DoubaoStructDecoder::length() const {
+  return length_;
+}
+
+bool DoubaoStructDecoder::finish() {
+  if (envelope_.failed()) {
+    violation("response is not valid JSON%s", "");
+  } else if (!envelope_.finish()) {
+    violation("response ended early%s", "");
+  } else if (!contentSeen_) {
+    violation("response has no message content%s", "");
+  } else if (!content_.failed()) {
+    for (int i = 0; i < schema_.count; i++) {
+      if (schema_.fields[i].required && !(set_ & (1UL << i))) {
+        violation("missing field '%s'", schema_.fields[i].name);
+      }
+    }
+  }
+  return violations_ == 0;
+}
+
+int DoubaoStructDecoder::violations() const {
+  return violations_;
+}
+
+const char* DoubaoStructDecoder::error() const {
+  return error_;
+}
+
+uint32_t DoubaoStructDecoder::fieldsSet() const {
+  return set_;
+}
+
+void DoubaoStructDecoder::fillMeta(DoubaoResponseMeta* meta) const {
+  meta->promptTokens = promptTokens_;
+  meta->completionTokens = completionTokens_;
+  meta->finishReason = finishReason_;
+}
+
+void DoubaoStructDecoder::violation(const char* format, const char* name) {
+  char message[DOUBAO_SCHEMA_ERROR_LENGTH];
+  snprintf(message, sizeof(message), format, name);
+  if (violations_++ == 0) {
+    strcpy(error_, message);
+  }
+  Serial.printf("Schema violation: %s\n", message);
+}
+
+// Reports a violation if the value seen for the current field has the wrong type
+bool DoubaoStructDecoder::expect(DoubaoFieldType seen) {
+  const DoubaoSchemaField& field = schema_.fields[field_];
+  if (field.type == seen) {
+    return true;
+  }
+  char format[DOUBAO_SCHEMA_ERROR_LENGTH];
+  snprintf(format, sizeof(format), "field '%%s' should be %s", fieldTypeNames[field.type]);
+  violation(format, field.name);
+  return false;
+}
+
+void DoubaoStructDecoder::writeLiteral(const DoubaoSchemaField& field, const char* text) {
+  uint8_t* out = target_ + field.offset;
+  bool isBool = strcmp(text, "true") == 0 || strcmp(text, "false") == 0;
+  if (field.type == DOUBAO_FIELD_BOOLEAN) {
+    if (!isBool) {
+      expect(DOUBAO_FIELD_INTEGER);
+      return;
+    }
+    *(bool*)out = text[0] == 't';
+  } else if (field.type == DOUBAO_FIELD_NUMBER) {
+    if (isBool) {
+      expect(DOUBAO_FIELD_BOOLEAN);
+      return;
+    }
+    double value = strtod(text, nullptr);
+    if (field.size == sizeof(float)) {
+      *(float*)out = (float)value;
+    } else {
+      *(double*)out = value;
+    }
+  } else if (field.type == DOUBAO_FIELD_INTEGER) {
+    char* end = nullptr;
+    errno = 0;
+    long long value = strtoll(text, &end, 10);
+    if (isBool || *end != '\0') {
+      violation("field '%s' should be integer", field.name);
+      return;
+    }
+    long long limit = field.size >= sizeof(long long) ? LLONG_MAX : (1LL << (field.size * 8 - 1)) - 1;
+    if (errno == ERANGE || value > limit || value < -limit - 1) {
+      violation("field '%s' is out of range", field.name);
+      return;
+    }
+    switch (field.size) {
+      case 1: *(int8_t*)out = (int8_t)value; break;
+      case 2: *(int16_t*)out = (int16_t)value; break;
+      case 4: *(int32_t*)out = (int32_t)value; break;
+      default: *(int64_t*)out = (int64_t)value; break;
+    }
+  } else {
+    expect(isBool ? DOUBAO_FIELD_BOOLEAN : DOUBAO_FIELD_NUMBER);
+    return;
+  }
+  set_ |= 1UL << field_;
+}
+
+// choices[0].message.content and choices[0].finish_reason
+static bool isFirstChoice(const DoubaoJsonStream<DoubaoStructDecoder::Envelope>& s) {
+  return strcmp(s.key(1), "choices") == 0 && s.index(2) == 0;
+}
+
+void DoubaoStructDecoder::Envelope::onStringStart() {
+  const DoubaoJsonStream<Envelope>& s = decoder->envelope_;
+  if (s.depth() == 4 && isFirstChoice(s) && strcmp(s.key(3), "message") == 0 && strcmp(s.key(4), "content") == 0) {
+    decoder->inContent_ = true;
+    decoder->content_.reset();
+  } else if (s.depth() == 3 && isFirstChoice(s) && strcmp(s.key(3), "finish_reason") == 0) {
+    decoder->inFinishReason_ = true;
+    decoder->finishLength_ = 0;
+  }
+}
+
+void DoubaoStructDecoder::Envelope::onStringByte(char c) {
+  if (decoder->inContent_) {
+    if (!decoder->content_.failed() && !decoder->content_.feed(c)) {
+      decoder->violation("content is not valid JSON%s", "");
+    }
+  } else if (decoder->inFinishReason_ && decoder->finishLength_ < sizeof(decoder->finishReason_) - 1) {
+    decoder->finishReason_[decoder->finishLength_++] = c;
+  }
+}
+
+void DoubaoStructDecoder::Envelope::onStringEnd() {
+  if (decoder->inContent_) {
+    decoder->inContent_ = false;
+    decoder->contentSeen_ = true;
+    if (!decoder->content_.failed() && !decoder->content_.finish()) {
+      decoder->violation("content ended early%s", "");
+    }
+  } else if (decoder->inFinishReason_) {
+    decoder->inFinishReason_ = false;
+    decoder->finishReason_[decoder->finishLength_] = '\0';
+  }
+}
+
+void DoubaoStructDecoder::Envelope::onLiteral(const char* text, size_t length) {
+  const DoubaoJsonStream<Envelope>& s = decoder->envelope_;
+  if (s.depth() == 2 && strcmp(s.key(1), "usage") == 0) {
+    if (strcmp(s.key(2), "prompt_tokens") == 0) {
+      decoder->promptTokens_ = atoi(text);
+    } else if (strcmp(s.key(2), "completion_tokens") == 0) {
+      decoder->completionTokens_ = atoi(text);
+    }
+  }
+}
+
+void DoubaoStructDecoder::Content::onContainerStart(bool isObject) {
+  int depth = decoder->content_.depth();
+  if (depth == 1 && !isObject) {
+    decoder->violation("content is not a JSON object%s", "");
+  } else if (depth == 2 && decoder->field_ >= 0) {
+    const DoubaoSchemaField& field = decoder->schema_.fields[decoder->field_];
+    char format[DOUBAO_SCHEMA_ERROR_LENGTH];
+    snprintf(format, sizeof(format), "field '%%s' should be %s, not %s", fieldTypeNames[field.type], isObject ? "object" : "array");
+    decoder->violation(format, field.name);
+    decoder->field_ = -1;
+  }
+}
+
+void DoubaoStructDecoder::Content::onKey() {
+  const DoubaoJsonStream<Content>& s = decoder->content_;
+  if (s.depth() != 1) {
+    return;
+  }
+  decoder->field_ = -1;
+  for (int i = 0; i < decoder->schema_.count; i++) {
+    if (strcmp(decoder->schema_.fields[i].name, s.key(1)) == 0) {
+      decoder->field_ = i;
+      return;
+    }
+  }
+  decoder->violation("unexpected field '%s'", s.key(1));
+}
+
+void DoubaoStructDecoder::Content::onStringStart() {
+  int depth = decoder->content_.depth();
+  if (depth == 0) {
+    decoder->violation("content is not a JSON object%s", "");
+  } else if (depth == 1 && decoder->field_ >= 0) {
+    if (decoder->expect(DOUBAO_FIELD_STRING)) {
+      decoder->stringLength_ = 0;
+    } else {
+      decoder->field_ = -1;
+    }
+  }
+}
+
+// Bytes go straight into the struct's char array
+void DoubaoStructDecoder::Content::onStringByte(char c) {
+  if (decoder->content_.depth() != 1 || decoder->field_ < 0) {
+    return;
+  }
+  const DoubaoSchemaField& field = decoder->schema_.fields[decoder->field_];
+  if (decoder->stringLength_ < (size_t)field.size - 1) {
+    decoder->target_[field.offset + decoder->stringLength_] = c;
+  }
+  decoder->stringLength_++;
+}
+
+void DoubaoStructDecoder::Content::onStringEnd() {
+  if (decoder->content_.depth() != 1 || decoder->field_ < 0) {
+    return;
+  }
+  const DoubaoSchemaField& field = decoder->schema_.fields[decoder->field_];
+  size_t capacity = field.size - 1;
+  decoder->target_[field.offset + min(decoder->stringLength_, capacity)] = '\0';
+  if (decoder->stringLength_ > capacity) {
+    char format[DOUBAO_SCHEMA_ERROR_LENGTH];
+    snprintf(format, sizeof(format), "field '%%s' is longer than %u bytes", (unsigned)capacity);
+    decoder->violation(format, field.name);
+  } else {
+    decoder->set_ |= 1UL << decoder->field_;
+  }
+  decoder->field_ = -1;
+}
+
+void DoubaoStructDecoder::Content::onLiteral(const char* text, size_t length) {
+  int depth = decoder->content_.depth();
+  if (depth == 0) {
+    decoder->violation("content is not a JSON object%s", "");
+    return;
+  }
+  if (depth != 1 || decoder->field_ < 0) {
+    return;
+  }
+  const DoubaoSchemaField& field = decoder->schema_.fields[decoder->field_];
+  if (strcmp(text, "null") == 0) {
+    // Optional fields are sent as null when absent; the struct keeps its zero value
+    if (field.required) {
+      decoder->violation("field '%s' is null", field.name);
+    }
+  } else {
+    decoder->writeLiteral(field, text);
+  }
+  decoder->field_ = -1;
+}
+
+String getGPTAnswerStructured(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, const DoubaoSchema& schema, void* out, DoubaoResponseMeta* meta) {
+  DoubaoDefaultClient client;
+  if (!client.begin(apiKey, modelId) || !validateSettings(modelId, temp)) {
+    return ERROR_INVALID_INPUT;
+  }
+  return client.askStructured(inputText, systemPrompt, temp, schema, out, meta);
+}
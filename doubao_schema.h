@@ -0,0 +1,254 @@
+#ifndef DOUBAO_SCHEMA_H
+#define DOUBAO_SCHEMA_H
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <type_traits>
+#include "doubao_api.h"
+#include "doubao_json_stream.h"
+#include "doubao_view.h"
+
+// Fields per schema (tracked in a 32-bit mask)
+#define DOUBAO_SCHEMA_MAX_FIELDS 32
+
+// First violation kept by DoubaoStructDecoder::error()
+#define DOUBAO_SCHEMA_ERROR_LENGTH 80
+
+enum DoubaoFieldType : uint8_t {
+  DOUBAO_FIELD_STRING,    // char[N], NUL-terminated, at most N - 1 bytes
+  DOUBAO_FIELD_INTEGER,   // Signed integer of any width
+  DOUBAO_FIELD_NUMBER,    // float or double
+  DOUBAO_FIELD_BOOLEAN    // bool
+};
+
+// One struct member, produced by DOUBAO_FIELD / DOUBAO_OPTIONAL_FIELD
+struct DoubaoSchemaField {
+  const char* name;
+  DoubaoFieldType type;
+  bool required;
+  uint16_t offset;
+  uint16_t size;
+  const char* description;
+};
+
+// Flat struct described as a list of fields, produced by DOUBAO_SCHEMA
+struct DoubaoSchema {
+  const char* name;
+  const DoubaoSchemaField* fields;
+  uint8_t count;
+  size_t size;
+};
+
+// Maps a member type to its JSON type; fails to compile for anything else
+template <class T>
+struct DoubaoFieldTraits {
+  static_assert(std::is_arithmetic<T>::value, "Schema fields must be char arrays, bool, integers or floating point");
+  static_assert(std::is_same<T, bool>::value || std::is_floating_point<T>::value || std::is_signed<T>::value,
+                "Integer schema fields must be signed");
+  static constexpr DoubaoFieldType type = std::is_same<T, bool>::value ? DOUBAO_FIELD_BOOLEAN
+                                          : std::is_floating_point<T>::value ? DOUBAO_FIELD_NUMBER
+                                                                             : DOUBAO_FIELD_INTEGER;
+};
+
+template <size_t N>
+struct DoubaoFieldTraits<char[N]> {
+  static constexpr DoubaoFieldType type = DOUBAO_FIELD_STRING;
+};
+
+/**
+ * Schema of a struct; specialized by DOUBAO_SCHEMA
+ */
+template <class T>
+const DoubaoSchema& doubaoSchemaOf() {
+  static_assert(sizeof(T) == 0, "Describe the struct with DOUBAO_SCHEMA first");
+  static const DoubaoSchema none = {};
+  return none;
+}
+
+/*
+ * Describe a flat struct at global scope, once, after its definition:
+ *
+ *   struct LightCommand {
+ *     char room[24];
+ *     int brightness;
+ *     bool on;
+ *     float confidence;
+ *   };
+ *   DOUBAO_SCHEMA(LightCommand,
+ *     DOUBAO_FIELD(LightCommand, room, "Room name"),
+ *     DOUBAO_FIELD(LightCommand, brightness, "0-100"),
+ *     DOUBAO_FIELD(LightCommand, on, nullptr),
+ *     DOUBAO_OPTIONAL_FIELD(LightCommand, confidence, "0-1"))
+ *
+ * Field names are the member names; JSON types and string capacities are
+ * taken from the member types at compile time.
+ */
+#define DOUBAO_FIELD(Type, member, description) \
+  { #member, DoubaoFieldTraits<decltype(((Type*)nullptr)->member)>::type, true, offsetof(Type, member), sizeof(((Type*)nullptr)->member), description }
+
+#define DOUBAO_OPTIONAL_FIELD(Type, member, description) \
+  { #member, DoubaoFieldTraits<decltype(((Type*)nullptr)->member)>::type, false, offsetof(Type, member), sizeof(((Type*)nullptr)->member), description }
+
+#define DOUBAO_SCHEMA(Type, ...)                                                                            \
+  template <>                                                                                               \
+  inline const DoubaoSchema& doubaoSchemaOf<Type>() {                                                       \
+    static const DoubaoSchemaField fields[] = {__VA_ARGS__};                                                \
+    static_assert(sizeof(fields) / sizeof(fields[0]) <= DOUBAO_SCHEMA_MAX_FIELDS, "Too many schema fields"); \
+    static const DoubaoSchema schema = {#Type, fields, (uint8_t)(sizeof(fields) / sizeof(fields[0])), sizeof(Type)}; \
+    return schema;                                                                                          \
+  }
+
+/**
+ * Render a schema as a JSON Schema object
+ * @param schema Schema from doubaoSchemaOf<T>()
+ * @return {"type":"object","properties":{...},"required":[...],"additionalProperties":false}
+ */
+String doubaoSchemaJson(const DoubaoSchema& schema);
+
+/**
+ * Build a chat payload that asks for JSON matching a schema (response_format json_schema)
+ * @param inputText Text message to send
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @param schema Schema from doubaoSchemaOf<T>()
+ * @return JSON payload string
+ */
+String buildStructuredPayload(const String& inputText, const String& modelId, const String& systemPrompt, float temp, const DoubaoSchema& schema);
+
+/**
+ * Decodes a chat completions response straight into a struct as the bytes
+ * arrive. The message content is unescaped on the fly and parsed by a second
+ * tokenizer that writes each field into the struct; no String holds the body
+ * or the content. Usable as a body sink (reserve/append/length).
+ */
+class DoubaoStructDecoder {
+public:
+  /**
+   * @param schema Schema of the target struct
+   * @param target Struct to fill; zeroed by reset()
+   */
+  DoubaoStructDecoder(const DoubaoSchema& schema, void* target);
+
+  /**
+   * Zero the target and start a new response
+   */
+  void reset();
+
+  void reserve(size_t size);
+
+  /**
+   * Feed response body bytes
+   * @return false once the body is not valid JSON
+   */
+  bool append(DoubaoStringView data);
+
+  /**
+   * @return Body bytes fed so far
+   */
+  size_t length() const;
+
+  /**
+   * Check the end of the response: complete JSON, content found, required fields present
+   * @return true if the struct was filled without violations
+   */
+  bool finish();
+
+  /**
+   * @return Number of schema violations seen
+   */
+  int violations() const;
+
+  /**
+   * @return First violation, "" if none
+   */
+  const char* error() const;
+
+  /**
+   * @return Bit n set if field n was written
+   */
+  uint32_t fieldsSet() const;
+
+  /**
+   * Copy usage and finish_reason from the response
+   * @param meta Output
+   */
+  void fillMeta(DoubaoResponseMeta* meta) const;
+
+  // DoubaoJsonStream handler for the response envelope
+  struct Envelope {
+    DoubaoStructDecoder* decoder;
+    void onContainerStart(bool isObject) {
+    }
+    void onContainerEnd(bool isObject) {
+    }
+    void onKey() {
+    }
+    void onStringStart();
+    void onStringByte(char c);
+    void onStringEnd();
+    void onLiteral(const char* text, size_t length);
+  };
+
+  // DoubaoJsonStream handler for the JSON inside message.content
+  struct Content {
+    DoubaoStructDecoder* decoder;
+    void onContainerStart(bool isObject);
+    void onContainerEnd(bool isObject) {
+    }
+    void onKey();
+    void onStringStart();
+    void onStringByte(char c);
+    void onStringEnd();
+    void onLiteral(const char* text, size_t length);
+  };
+
+private:
+  void violation(const char* format, const char* name);
+  bool expect(DoubaoFieldType seen);
+  void writeLiteral(const DoubaoSchemaField& field, const char* text);
+
+  const DoubaoSchema& schema_;
+  uint8_t* target_;
+  Envelope envelopeHandler_;
+  Content contentHandler_;
+  DoubaoJsonStream<Envelope> envelope_;
+  DoubaoJsonStream<Content> content_;
+  size_t length_;
+  bool inContent_;
+  bool contentSeen_;
+  bool inFinishReason_;
+  char finishReason_[16];
+  uint8_t finishLength_;
+  int promptTokens_;
+  int completionTokens_;
+  int field_;           // Field whose value is being parsed, -1 if none
+  size_t stringLength_;
+  uint32_t set_;
+  int violations_;
+  char error_[DOUBAO_SCHEMA_ERROR_LENGTH];
+};
+
+/**
+ * Get a structured answer decoded into a struct described with DOUBAO_SCHEMA
+ * @param inputText Text message to send
+ * @param apiKey API key for authentication
+ * @param modelId Model ID to use (must support response_format json_schema)
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @param schema Schema of out
+ * @param out Struct to fill
+ * @param meta Optional output for status, timing and token usage
+ * @return "" on success, ERROR_SCHEMA if the answer did not match the schema, or another error code
+ */
+String getGPTAnswerStructured(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, const DoubaoSchema& schema, void* out, DoubaoResponseMeta* meta = nullptr);
+
+/**
+ * Typed form of getGPTAnswerStructured(); the schema comes from DOUBAO_SCHEMA(T, ...)
+ */
+template <class T>
+String getGPTAnswerStruct(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, T* out, DoubaoResponseMeta* meta = nullptr) {
+  return getGPTAnswerStructured(inputText, apiKey, modelId, systemPrompt, temp, doubaoSchemaOf<T>(), out, meta);
+}
+
+#endif // DOUBAO_SCHEMA_H
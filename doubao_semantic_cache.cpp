@@ -0,0 +1,222 @@
+#include "doubao_semantic_cache.h"
+#include <new>
+
+static uint32_t fnv1a(const char* data, size_t len, uint32_t hash = 2166136261u) {
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (uint8_t)data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+DoubaoSemanticCache::DoubaoSemanticCache(int capacity, int dim, float threshold)
+    : capacity_(capacity), dim_(dim), threshold_(threshold), count_(0), clock_(0),
+      entries_(nullptr), vectors_(nullptr), query_(nullptr), lock_(nullptr) {
+}
+
+DoubaoSemanticCache::~DoubaoSemanticCache() {
+  delete[] entries_;
+  free(vectors_);
+  free(query_);
+  if (lock_ != nullptr) {
+    vSemaphoreDelete(lock_);
+  }
+}
+
+bool DoubaoSemanticCache::begin() {
+  if (entries_ != nullptr) {
+    return true;
+  }
+  if (capacity_ <= 0 || dim_ <= 0) {
+    Serial.println("Error: Invalid semantic cache size");
+    return false;
+  }
+  if (lock_ == nullptr) {
+    lock_ = xSemaphoreCreateMutex();
+  }
+  vectors_ = (int8_t*)malloc((size_t)capacity_ * dim_);
+  query_ = (int8_t*)malloc(dim_);
+  entries_ = new (std::nothrow) Entry[capacity_];
+  if (vectors_ == nullptr || query_ == nullptr || entries_ == nullptr || lock_ == nullptr) {
+    Serial.println("Error: Not enough memory for semantic cache");
+    delete[] entries_;
+    free(vectors_);
+    free(query_);
+    entries_ = nullptr;
+    vectors_ = nullptr;
+    query_ = nullptr;
+    return false;
+  }
+  clear();
+  return true;
+}
+
+void DoubaoSemanticCache::clear() {
+  if (entries_ == nullptr) {
+    return;
+  }
+  DoubaoMutexLock lock(lock_);
+  for (int i = 0; i < capacity_; i++) {
+    entries_[i].used = false;
+    entries_[i].prompt = "";
+    entries_[i].answer = "";
+  }
+  count_ = 0;
+}
+
+int DoubaoSemanticCache::size() const {
+  DoubaoMutexLock lock(lock_);
+  return count_;
+}
+
+int DoubaoSemanticCache::dimensions() const {
+  return dim_;
+}
+
+uint32_t DoubaoSemanticCache::contextHash(const String& modelId, const String& systemPrompt) {
+  uint32_t hash = fnv1a(modelId.c_str(), modelId.length());
+  hash = fnv1a("\n", 1, hash);
+  return fnv1a(systemPrompt.c_str(), systemPrompt.length(), hash);
+}
+
+bool DoubaoSemanticCache::lookupExact(const String& prompt, uint32_t context, String& answer) {
+  if (entries_ == nullptr) {
+    return false;
+  }
+  uint32_t hash = fnv1a(prompt.c_str(), prompt.length());
+  DoubaoMutexLock lock(lock_);
+  for (int i = 0; i < capacity_; i++) {
+    Entry& entry = entries_[i];
+    // The hash only filters; the stored prompt decides, so a collision cannot return another prompt's answer
+    if (entry.used && entry.context == context && entry.promptHash == hash && entry.prompt == prompt) {
+      entry.lastUsed = ++clock_;
+      answer = entry.answer;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DoubaoSemanticCache::lookup(const float* embedding, int dim, uint32_t context, String& answer, float* similarity) {
+  if (entries_ == nullptr) {
+    return false;
+  }
+  dim = min(dim, dim_);
+  // query_ is shared scratch space, so the whole scan holds the lock
+  DoubaoMutexLock lock(lock_);
+  if (count_ == 0) {
+    return false;
+  }
+  float queryScale = quantizeEmbedding(embedding, dim, query_);
+  if (queryScale <= 0.0f) {
+    return false;
+  }
+  int best = -1;
+  float bestSimilarity = -1.0f;
+  for (int i = 0; i < capacity_; i++) {
+    const Entry& entry = entries_[i];
+    if (!entry.used || entry.context != context) {
+      continue;
+    }
+    int32_t dot = dotProductInt8(query_, vectors_ + (size_t)i * dim_, dim);
+    float cosine = dot / (queryScale * entry.scale);
+    if (cosine > bestSimilarity) {
+      bestSimilarity = cosine;
+      best = i;
+    }
+  }
+  if (similarity != nullptr) {
+    *similarity = bestSimilarity;
+  }
+  if (best < 0 || bestSimilarity < threshold_) {
+    return false;
+  }
+  entries_[best].lastUsed = ++clock_;
+  answer = entries_[best].answer;
+  return true;
+}
+
+int DoubaoSemanticCache::findSlot() {
+  int oldest = 0;
+  for (int i = 0; i < capacity_; i++) {
+    if (!entries_[i].used) {
+      return i;
+    }
+    if (entries_[i].lastUsed < entries_[oldest].lastUsed) {
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+void DoubaoSemanticCache::insert(const String& prompt, const float* embedding, int dim, uint32_t context, const String& answer) {
+  if (entries_ == nullptr) {
+    return;
+  }
+  dim = min(dim, dim_);
+  DoubaoMutexLock lock(lock_);
+  // Quantize into the scratch vector first, so a failure leaves the victim entry intact
+  float scale = quantizeEmbedding(embedding, dim, query_);
+  if (scale <= 0.0f) {
+    return;
+  }
+  int slot = findSlot();
+  int8_t* vector = vectors_ + (size_t)slot * dim_;
+  memcpy(vector, query_, dim);
+  memset(vector + dim, 0, dim_ - dim);
+  Entry& entry = entries_[slot];
+  if (!entry.used) {
+    count_++;
+  }
+  entry.used = true;
+  entry.promptHash = fnv1a(prompt.c_str(), prompt.length());
+  entry.prompt = prompt;
+  entry.context = context;
+  entry.lastUsed = ++clock_;
+  entry.scale = scale;
+  entry.answer = answer;
+}
+
+String getGPTAnswerCached(DoubaoSemanticCache& cache, const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, const String& embeddingModelId) {
+  if (!validateConfig(apiKey, modelId, temp)) {
+    return ERROR_INVALID_INPUT;
+  }
+  if (inputText.length() == 0) {
+    Serial.println("Error: Input text is empty");
+    return ERROR_INVALID_INPUT;
+  }
+  uint32_t context = DoubaoSemanticCache::contextHash(modelId, systemPrompt);
+  String cached;
+  unsigned long start = micros();
+  if (cache.lookupExact(inputText, context, cached)) {
+    Serial.printf("Semantic cache hit (exact) in %lu us\n", micros() - start);
+    return cached;
+  }
+  int dim = cache.dimensions();
+  float* embedding = (float*)malloc(sizeof(float) * dim);
+  if (embedding == nullptr) {
+    Serial.println("Error: Not enough memory for embedding");
+    return getGPTAnswer(inputText, apiKey, modelId, systemPrompt, temp);
+  }
+  int embeddingDim = getEmbedding(inputText, apiKey, embeddingModelId, embedding, dim);
+  if (embeddingDim == 0) {
+    Serial.println("Embedding failed, bypassing semantic cache");
+    free(embedding);
+    return getGPTAnswer(inputText, apiKey, modelId, systemPrompt, temp);
+  }
+  float similarity = 0.0f;
+  start = micros();
+  bool hit = cache.lookup(embedding, embeddingDim, context, cached, &similarity);
+  unsigned long lookupTime = micros() - start;
+  if (hit) {
+    Serial.printf("Semantic cache hit (similarity %.3f) in %lu us\n", similarity, lookupTime);
+    free(embedding);
+    return cached;
+  }
+  String result = getGPTAnswer(inputText, apiKey, modelId, systemPrompt, temp);
+  if (!isErrorResponse(result)) {
+    cache.insert(inputText, embedding, embeddingDim, context, result);
+  }
+  free(embedding);
+  return result;
+}
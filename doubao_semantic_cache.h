@@ -0,0 +1,124 @@
+#ifndef DOUBAO_SEMANTIC_CACHE_H
+#define DOUBAO_SEMANTIC_CACHE_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+#include "doubao_embeddings.h"
+#include "doubao_lock.h"
+
+/**
+ * Bounded answer cache keyed by prompt meaning.
+ * Prompts are stored as normalized int8 embeddings; a lookup returns the
+ * answer of the most similar stored prompt above the similarity threshold.
+ * Exact repeats are matched by prompt (hash first, then the stored text)
+ * without an embeddings round trip.
+ * The least recently used entry is evicted when the cache is full.
+ * Lookups and inserts from several tasks are serialized by a mutex.
+ */
+class DoubaoSemanticCache {
+public:
+  /**
+   * @param capacity Maximum number of cached answers
+   * @param dim Embedding dimensions stored per entry (longer vectors are truncated)
+   * @param threshold Minimum cosine similarity for a hit (0-1)
+   */
+  DoubaoSemanticCache(int capacity = 32, int dim = 2048, float threshold = 0.92);
+  ~DoubaoSemanticCache();
+
+  /**
+   * Allocate the index storage
+   * @return true on success, false if memory is insufficient
+   */
+  bool begin();
+
+  /**
+   * Look up an answer for an exact prompt repeat
+   * @param prompt User prompt
+   * @param context Hash of model and system prompt (see contextHash)
+   * @param answer Output answer on hit
+   * @return true on hit, false otherwise
+   */
+  bool lookupExact(const String& prompt, uint32_t context, String& answer);
+
+  /**
+   * Look up the answer of the most similar cached prompt
+   * @param embedding Float embedding of the prompt
+   * @param dim Number of dimensions in embedding
+   * @param context Hash of model and system prompt (see contextHash)
+   * @param answer Output answer on hit
+   * @param similarity Optional output cosine similarity of the best entry
+   * @return true on hit, false otherwise
+   */
+  bool lookup(const float* embedding, int dim, uint32_t context, String& answer, float* similarity = nullptr);
+
+  /**
+   * Store an answer, evicting the least recently used entry when full
+   * @param prompt User prompt
+   * @param embedding Float embedding of the prompt
+   * @param dim Number of dimensions in embedding
+   * @param context Hash of model and system prompt (see contextHash)
+   * @param answer Answer to cache
+   */
+  void insert(const String& prompt, const float* embedding, int dim, uint32_t context, const String& answer);
+
+  /**
+   * Remove all entries
+   */
+  void clear();
+
+  /**
+   * @return Number of cached entries
+   */
+  int size() const;
+
+  /**
+   * @return Embedding dimensions stored per entry
+   */
+  int dimensions() const;
+
+  /**
+   * Hash the request context so answers are only reused for the same model and system prompt
+   * @param modelId Model ID
+   * @param systemPrompt System prompt/role
+   * @return Context hash
+   */
+  static uint32_t contextHash(const String& modelId, const String& systemPrompt);
+
+private:
+  struct Entry {
+    uint32_t promptHash;
+    uint32_t context;
+    uint32_t lastUsed;
+    float scale;
+    bool used;
+    String prompt;
+    String answer;
+  };
+
+  int findSlot();
+
+  int capacity_;
+  int dim_;
+  float threshold_;
+  int count_;
+  uint32_t clock_;
+  Entry* entries_;
+  int8_t* vectors_;
+  int8_t* query_;
+  SemaphoreHandle_t lock_;   // Held by lookups, insert() and clear()
+};
+
+/**
+ * Get GPT answer for text message through a semantic cache
+ * @param cache Initialized semantic cache
+ * @param inputText Text message to send
+ * @param apiKey API key for authentication
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @param embeddingModelId Embedding model ID used for cache keys
+ * @return Cached or fresh AI response, or error code
+ */
+String getGPTAnswerCached(DoubaoSemanticCache& cache, const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, const String& embeddingModelId);
+
+#endif // DOUBAO_SEMANTIC_CACHE_H
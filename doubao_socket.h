@@ -0,0 +1,64 @@
+#ifndef DOUBAO_SOCKET_H
+#define DOUBAO_SOCKET_H
+
+#include <Arduino.h>
+#include <lwip/sockets.h>
+
+// Sleep between checks when a connection does not expose its socket
+#define DOUBAO_POLL_INTERVAL_MS 10
+
+/*
+ * Waiting for socket readiness. Instead of checking available() every few
+ * milliseconds, the reading task blocks in lwIP select() and is woken as soon
+ * as data (or a close) arrives; the CPU is free and the idle task keeps the
+ * watchdog fed in between.
+ *
+ * The socket of a connection is found through its fd() member (WiFiClient,
+ * DoubaoTlsClient). Connections without one, or reached only through the
+ * Client base class, fall back to sleeping DOUBAO_POLL_INTERVAL_MS per check.
+ * Bytes a client has already buffered are not visible to select(), so callers
+ * check available() first and only wait when it is 0.
+ */
+
+/**
+ * Block until a socket is ready or a timeout passes
+ * @param socket lwIP socket descriptor
+ * @param write Wait until it can be written instead of read
+ * @param timeoutMs Longest wait
+ * @return true if the socket is ready (readable also means closed by the peer), false on timeout or error
+ */
+inline bool doubaoSocketWait(int socket, bool write, unsigned long timeoutMs) {
+  fd_set fds;
+  FD_ZERO(&fds);
+  FD_SET(socket, &fds);
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  int rv = select(socket + 1, write ? nullptr : &fds, write ? &fds : nullptr, nullptr, &tv);
+  if (rv < 0) {
+    // Bad or closed descriptor: do not let the caller spin
+    delay(DOUBAO_POLL_INTERVAL_MS);
+  }
+  return rv > 0;
+}
+
+template <class ClientT>
+auto doubaoSocketOf(ClientT& client, int) -> decltype(client.fd()) {
+  return client.fd();
+}
+
+template <class ClientT>
+int doubaoSocketOf(ClientT& client, long) {
+  return -1;
+}
+
+/**
+ * @param client Connection
+ * @return Its socket descriptor, -1 if the type does not expose one or it is not connected
+ */
+template <class ClientT>
+int doubaoSocketOf(ClientT& client) {
+  return doubaoSocketOf(client, 0);
+}
+
+#endif // DOUBAO_SOCKET_H
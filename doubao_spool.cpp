@@ -0,0 +1,424 @@
+#include "doubao_spool.h"
+#include "doubao_policies.h"
+#include "doubao_roi.h"
+#include <WiFi.h>
+#include <img_converters.h>
+
+#define SPOOL_KIND_TEXT 0
+#define SPOOL_KIND_JPEG 1
+#define SPOOL_MAX_FIELD (512 * 1024)
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length) {
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static bool readField(File& file, String& out, uint32_t length, uint32_t* crc) {
+  char buf[128];
+  out = "";
+  out.reserve(length);
+  while (length > 0) {
+    size_t n = file.read((uint8_t*)buf, min((size_t)length, sizeof(buf)));
+    if (n == 0) {
+      return false;
+    }
+    *crc = crc32Update(*crc, (const uint8_t*)buf, n);
+    out.concat(buf, n);
+    length -= n;
+  }
+  return true;
+}
+
+// Offset of the first record header at or after from, or size if there is none.
+// Only the magic is matched; the caller's CRC check rejects false matches.
+static uint32_t findRecord(File& file, uint32_t from, size_t size) {
+  uint8_t buf[256];
+  uint32_t offset = from;
+  while (offset + sizeof(uint32_t) <= size && file.seek(offset)) {
+    size_t n = file.read(buf, min(sizeof(buf), size - offset));
+    if (n < sizeof(uint32_t)) {
+      break;
+    }
+    for (size_t i = 0; i + sizeof(uint32_t) <= n; i++) {
+      uint32_t magic;
+      memcpy(&magic, buf + i, sizeof(magic));
+      if (magic == DOUBAO_SPOOL_MAGIC) {
+        return offset + i;
+      }
+    }
+    // Overlap by three bytes so a magic split across two reads is still found
+    offset += n - (sizeof(uint32_t) - 1);
+  }
+  return size;
+}
+
+DoubaoSpool::DoubaoSpool(const char* path)
+    : path_(path), positionPath_(String(path) + ".pos"), fs_(nullptr), apiKey_(nullptr),
+      callback_(nullptr), context_(nullptr), nextId_(1), rate_(1.0f), burst_(4.0f), tokens_(4.0f),
+      lastRefill_(0), lock_(nullptr), task_(nullptr) {
+}
+
+DoubaoSpool::~DoubaoSpool() {
+  if (task_ != nullptr) {
+    vTaskDelete(task_);
+  }
+  if (lock_ != nullptr) {
+    vSemaphoreDelete(lock_);
+  }
+}
+
+bool DoubaoSpool::begin(const char* apiKey, DoubaoSpoolCallback callback, void* context, fs::FS& fs) {
+  if (!hasApiKey(apiKey)) {
+    Serial.println("Error: API key not set");
+    return false;
+  }
+  fs_ = &fs;
+  apiKey_ = apiKey;
+  callback_ = callback;
+  context_ = context;
+  if (lock_ == nullptr) {
+    lock_ = xSemaphoreCreateMutex();
+  }
+  // Continue numbering after the last record left from a previous run, stepping over damaged ones
+  File file = fs_->open(path_.c_str(), FILE_READ);
+  if (file) {
+    size_t size = file.size();
+    DoubaoSpoolRecord record;
+    uint32_t position = 0;
+    while (position < size && file.seek(position)) {
+      uint64_t next = position + sizeof(record);
+      bool valid = file.read((uint8_t*)&record, sizeof(record)) == sizeof(record) && record.magic == DOUBAO_SPOOL_MAGIC;
+      if (valid) {
+        next += (uint64_t)record.modelLength + record.promptLength + record.inputLength + record.imageLength;
+        valid = next <= size;
+      }
+      if (valid) {
+        nextId_ = max(nextId_, record.id + 1);
+        position = next;
+      } else {
+        position = findRecord(file, position + 1, size);
+      }
+    }
+    file.close();
+  }
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  removeIfDrained();
+  xSemaphoreGive(lock_);
+  lastRefill_ = DoubaoClock::now();
+  Serial.printf("Spool ready, %u bytes pending\n", (unsigned)pendingBytes());
+  return lock_ != nullptr;
+}
+
+void DoubaoSpool::setRate(float requestsPerSecond, int burst) {
+  rate_ = max(requestsPerSecond, 0.01f);
+  burst_ = max(burst, 1);
+  tokens_ = min(tokens_, burst_);
+}
+
+uint32_t DoubaoSpool::append(uint8_t kind, const String& inputText, const uint8_t* image, size_t imageLength, const String& modelId, const String& systemPrompt, float temp) {
+  if (fs_ == nullptr) {
+    Serial.println("Error: Spool not started");
+    return 0;
+  }
+  if (inputText.length() == 0) {
+    Serial.println("Error: Input text is empty");
+    return 0;
+  }
+  DoubaoSpoolRecord record;
+  memset(&record, 0, sizeof(record));
+  record.magic = DOUBAO_SPOOL_MAGIC;
+  record.kind = kind;
+  record.temp = temp;
+  record.modelLength = modelId.length();
+  record.promptLength = systemPrompt.length();
+  record.inputLength = inputText.length();
+  record.imageLength = imageLength;
+  uint32_t crc = crc32Update(0, (const uint8_t*)modelId.c_str(), modelId.length());
+  crc = crc32Update(crc, (const uint8_t*)systemPrompt.c_str(), systemPrompt.length());
+  crc = crc32Update(crc, (const uint8_t*)inputText.c_str(), inputText.length());
+  crc = crc32Update(crc, image, imageLength);
+  record.crc = crc;
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  record.id = nextId_++;
+  File file = fs_->open(path_.c_str(), FILE_APPEND);
+  bool ok = file && file.write((const uint8_t*)&record, sizeof(record)) == sizeof(record) &&
+            file.write((const uint8_t*)modelId.c_str(), modelId.length()) == modelId.length() &&
+            file.write((const uint8_t*)systemPrompt.c_str(), systemPrompt.length()) == systemPrompt.length() &&
+            file.write((const uint8_t*)inputText.c_str(), inputText.length()) == inputText.length() &&
+            file.write(image, imageLength) == imageLength;
+  if (file) {
+    file.close();
+  }
+  xSemaphoreGive(lock_);
+  if (!ok) {
+    Serial.println("Error: Failed to write spool record");
+    return 0;
+  }
+  Serial.printf("Spooled request %u (%u bytes)\n", record.id, (unsigned)(sizeof(record) + record.modelLength + record.promptLength + record.inputLength + record.imageLength));
+  return record.id;
+}
+
+uint32_t DoubaoSpool::enqueueText(const String& inputText, const String& modelId, const String& systemPrompt, float temp) {
+  return append(SPOOL_KIND_TEXT, inputText, nullptr, 0, modelId, systemPrompt, temp);
+}
+
+uint32_t DoubaoSpool::enqueueJpeg(const String& inputText, const uint8_t* jpg, size_t jpgLength, const String& modelId, const String& systemPrompt, float temp) {
+  if (jpg == nullptr || jpgLength == 0) {
+    Serial.println("Error: Image is empty");
+    return 0;
+  }
+  return append(SPOOL_KIND_JPEG, inputText, jpg, jpgLength, modelId, systemPrompt, temp);
+}
+
+uint32_t DoubaoSpool::enqueueCamera(const String& inputText, const String& modelId, const String& systemPrompt, float temp) {
+  camera_fb_t* fb = captureFrame();
+  if (fb == nullptr) {
+    Serial.println("Failed to capture image");
+    return 0;
+  }
+  uint32_t id = 0;
+  if (fb->format == PIXFORMAT_JPEG) {
+    id = enqueueJpeg(inputText, fb->buf, fb->len, modelId, systemPrompt, temp);
+  } else {
+    uint8_t* jpg = nullptr;
+    size_t jpgLength = 0;
+    if (frame2jpg(fb, 80, &jpg, &jpgLength)) {
+      id = enqueueJpeg(inputText, jpg, jpgLength, modelId, systemPrompt, temp);
+      free(jpg);
+    } else {
+      Serial.println("Failed to encode image");
+    }
+  }
+  releaseFrame(fb);
+  return id;
+}
+
+uint32_t DoubaoSpool::readPosition() {
+  uint32_t position = 0;
+  File file = fs_->open(positionPath_.c_str(), FILE_READ);
+  if (file) {
+    if (file.read((uint8_t*)&position, sizeof(position)) != sizeof(position)) {
+      position = 0;
+    }
+    file.close();
+  }
+  return position;
+}
+
+void DoubaoSpool::writePosition(uint32_t position) {
+  File file = fs_->open(positionPath_.c_str(), FILE_WRITE);
+  if (file) {
+    file.write((const uint8_t*)&position, sizeof(position));
+    file.close();
+  }
+}
+
+// Caller holds lock_; appends take it too, so the size cannot grow in between
+void DoubaoSpool::removeIfDrained() {
+  File file = fs_->open(path_.c_str(), FILE_READ);
+  if (!file) {
+    return;
+  }
+  size_t size = file.size();
+  file.close();
+  if (readPosition() >= size) {
+    // Fully drained: drop the files so the spool does not grow forever
+    fs_->remove(path_.c_str());
+    fs_->remove(positionPath_.c_str());
+  }
+}
+
+size_t DoubaoSpool::pendingBytes() {
+  if (fs_ == nullptr) {
+    return 0;
+  }
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  size_t pending = 0;
+  File file = fs_->open(path_.c_str(), FILE_READ);
+  if (file) {
+    size_t size = file.size();
+    file.close();
+    uint32_t position = readPosition();
+    pending = size > position ? size - position : 0;
+  }
+  xSemaphoreGive(lock_);
+  return pending;
+}
+
+bool DoubaoSpool::takeToken() {
+  unsigned long now = DoubaoClock::now();
+  tokens_ = min(burst_, tokens_ + (now - lastRefill_) * rate_ / 1000.0f);
+  lastRefill_ = now;
+  if (tokens_ < 1.0f) {
+    return false;
+  }
+  tokens_ -= 1.0f;
+  return true;
+}
+
+// Returns false when nothing more can be delivered right now
+bool DoubaoSpool::deliverNext(bool* delivered) {
+  *delivered = false;
+  DoubaoSpoolRecord record;
+  String modelId;
+  String systemPrompt;
+  String inputText;
+  uint8_t* image = nullptr;
+  uint32_t position;
+  uint32_t next;
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  File file = fs_->open(path_.c_str(), FILE_READ);
+  if (!file) {
+    xSemaphoreGive(lock_);
+    return false;
+  }
+  size_t size = file.size();
+  position = readPosition();
+  if (position >= size) {
+    file.close();
+    removeIfDrained();
+    xSemaphoreGive(lock_);
+    return false;
+  }
+  bool valid = file.seek(position) && file.read((uint8_t*)&record, sizeof(record)) == sizeof(record) &&
+               record.magic == DOUBAO_SPOOL_MAGIC && record.modelLength < SPOOL_MAX_FIELD &&
+               record.promptLength < SPOOL_MAX_FIELD && record.inputLength < SPOOL_MAX_FIELD;
+  next = position + sizeof(record);
+  if (valid) {
+    uint64_t end = (uint64_t)next + record.modelLength + record.promptLength + record.inputLength + record.imageLength;
+    valid = end <= size;
+    next = (uint32_t)end;
+  }
+  if (valid) {
+    uint32_t crc = 0;
+    valid = readField(file, modelId, record.modelLength, &crc) &&
+            readField(file, systemPrompt, record.promptLength, &crc) &&
+            readField(file, inputText, record.inputLength, &crc);
+    if (valid && record.imageLength > 0) {
+      image = (uint8_t*)malloc(record.imageLength);
+      valid = image != nullptr && file.read(image, record.imageLength) == record.imageLength;
+      if (valid) {
+        crc = crc32Update(crc, image, record.imageLength);
+      }
+    }
+    valid = valid && crc == record.crc;
+  }
+  if (!valid) {
+    // Torn or corrupt record: resume at the next record header; records appended after it are kept
+    uint32_t resume = findRecord(file, position + 1, size);
+    file.close();
+    Serial.printf("Skipping %u bytes of corrupt spool data at offset %u\n", (unsigned)(resume - position), position);
+    writePosition(resume);
+    removeIfDrained();
+    xSemaphoreGive(lock_);
+    free(image);
+    return true;
+  }
+  file.close();
+  xSemaphoreGive(lock_);
+
+  // One allocation for the whole payload; the image is base64-encoded straight into it
+  DoubaoBuffer payload;
+  bool built = record.kind == SPOOL_KIND_JPEG
+                   ? buildPayloadInto(payload, inputText, modelId, systemPrompt, record.temp, image, record.imageLength, "jpg")
+                   : buildPayloadInto(payload, inputText, modelId, systemPrompt, record.temp);
+  free(image);
+  if (!built) {
+    // Keep the record; memory may be free on the next poll
+    Serial.println("Error: Not enough memory for spooled payload");
+    return false;
+  }
+  Serial.printf("Draining spooled request %u, payload length: %u\n", record.id, (unsigned)payload.length());
+  DoubaoResponseMeta meta;
+  String response = sendApiRequestOn(client_, DOUBAO_CHAT_PATH, payload.view(), apiKey_, true, &meta);
+  // ERROR_OVERLOADED comes without a status when every pooled key is throttled locally
+  if (response == ERROR_NETWORK || response == ERROR_TIMEOUT || response == ERROR_OVERLOADED ||
+      meta.status == 429 || meta.status >= 500) {
+    // Keep the record; the next poll retries once connectivity is back or the service recovers
+    return false;
+  }
+  // Other failures are final: the callback gets the error code, or the server's error body
+  String result = meta.status == 200 ? parseChatResponse(response) : response;
+  xSemaphoreTake(lock_, portMAX_DELAY);
+  writePosition(next);
+  removeIfDrained();
+  xSemaphoreGive(lock_);
+  *delivered = true;
+  if (callback_ != nullptr) {
+    callback_(record.id, result, meta.status, context_);
+  }
+  return true;
+}
+
+int DoubaoSpool::poll() {
+  if (fs_ == nullptr) {
+    return 0;
+  }
+  if (WiFi.status() != WL_CONNECTED) {
+    client_.stop();
+    return 0;
+  }
+  int count = 0;
+  while (pendingBytes() > 0 && takeToken()) {
+    bool delivered = false;
+    if (!deliverNext(&delivered)) {
+      break;
+    }
+    if (delivered) {
+      count++;
+    } else {
+      tokens_ += 1.0f;
+    }
+  }
+  return count;
+}
+
+void DoubaoSpool::drainTask(void* arg) {
+  DoubaoSpool* spool = (DoubaoSpool*)arg;
+  for (;;) {
+    spool->poll();
+    vTaskDelay(pdMS_TO_TICKS(200));
+  }
+}
+
+bool DoubaoSpool::startBackgroundDrain(uint32_t stackSize, UBaseType_t priority) {
+  if (task_ != nullptr) {
+    return true;
+  }
+  if (fs_ == nullptr) {
+    Serial.println("Error: Spool not started");
+    return false;
+  }
+  return xTaskCreate(drainTask, "doubao_spool", stackSize, this, priority, &task_) == pdPASS;
+}
+
+String getGPTAnswerSpooled(DoubaoSpool& spool, const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, uint32_t* spoolId) {
+  if (!validateConfig(apiKey, modelId, temp)) {
+    return ERROR_INVALID_INPUT;
+  }
+  if (inputText.length() == 0) {
+    Serial.println("Error: Input text is empty");
+    return ERROR_INVALID_INPUT;
+  }
+  if (WiFi.status() == WL_CONNECTED) {
+    String payload = buildPayload(inputText, modelId, systemPrompt, temp);
+    String result = sendHttpRequestWithRetry(payload, apiKey, 1);
+    if (result != ERROR_NETWORK && result != ERROR_TIMEOUT && result != ERROR_OVERLOADED) {
+      return result;
+    }
+  }
+  uint32_t id = spool.enqueueText(inputText, modelId, systemPrompt, temp);
+  if (id == 0) {
+    return ERROR_NETWORK;
+  }
+  if (spoolId != nullptr) {
+    *spoolId = id;
+  }
+  return ERROR_SPOOLED;
+}
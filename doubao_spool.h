@@ -0,0 +1,144 @@
+#ifndef DOUBAO_SPOOL_H
+#define DOUBAO_SPOOL_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include "doubao_api.h"
+
+#define DOUBAO_SPOOL_PATH "/doubao_spool.bin"
+#define DOUBAO_SPOOL_MAGIC 0x50534244  // "DBSP"
+
+/*
+ * Spool file: append-only sequence of records, each a DoubaoSpoolRecord
+ * header followed by modelId, systemPrompt, inputText and (for camera records)
+ * the raw JPEG bytes. The CRC covers everything after the header, so a record
+ * torn by a power loss is detected and skipped: draining resumes at the next
+ * record header, so records appended after a damaged one are still delivered.
+ * The offset of the first undelivered record is kept in "<path>.pos"; both
+ * files are removed once the spool is fully drained.
+ */
+struct DoubaoSpoolRecord {
+  uint32_t magic;
+  uint8_t kind;
+  uint8_t reserved[3];
+  uint32_t id;
+  float temp;
+  uint32_t modelLength;
+  uint32_t promptLength;
+  uint32_t inputLength;
+  uint32_t imageLength;
+  uint32_t crc;
+};
+
+/**
+ * Called with the answer of each drained request
+ * @param id Id returned when the request was spooled
+ * @param result AI response when status is 200; otherwise the server's error body, or an error code
+ *               if no response was received (never ERROR_NETWORK/ERROR_TIMEOUT/ERROR_OVERLOADED, those stay queued)
+ * @param status HTTP status of the response, 0 if none was received
+ * @param context User pointer given to begin()
+ */
+typedef void (*DoubaoSpoolCallback)(uint32_t id, const String& result, int status, void* context);
+
+/**
+ * Durable outbox for requests made while the network is down
+ */
+class DoubaoSpool {
+public:
+  DoubaoSpool(const char* path = DOUBAO_SPOOL_PATH);
+  ~DoubaoSpool();
+
+  /**
+   * Open the spool; the filesystem must already be mounted
+   * @param apiKey API key used when draining
+   * @param callback Receives drained results
+   * @param context User pointer passed to callback
+   * @param fs Filesystem holding the spool (default: LittleFS)
+   * @return true on success, false otherwise
+   */
+  bool begin(const char* apiKey, DoubaoSpoolCallback callback, void* context = nullptr, fs::FS& fs = LittleFS);
+
+  /**
+   * Limit the drain rate
+   * @param requestsPerSecond Sustained drain rate
+   * @param burst Requests allowed back to back after an idle period
+   */
+  void setRate(float requestsPerSecond, int burst);
+
+  /**
+   * Append a text request
+   * @return Request id, 0 on failure
+   */
+  uint32_t enqueueText(const String& inputText, const String& modelId, const String& systemPrompt, float temp);
+
+  /**
+   * Append a request with a JPEG image stored as raw bytes
+   * @return Request id, 0 on failure
+   */
+  uint32_t enqueueJpeg(const String& inputText, const uint8_t* jpg, size_t jpgLength, const String& modelId, const String& systemPrompt, float temp);
+
+  /**
+   * Capture a camera frame and append it as a JPEG request
+   * @return Request id, 0 on failure
+   */
+  uint32_t enqueueCamera(const String& inputText, const String& modelId, const String& systemPrompt, float temp);
+
+  /**
+   * Deliver spooled requests while connected and within the rate limit; call from loop()
+   * @return Number of requests delivered
+   */
+  int poll();
+
+  /**
+   * Drain from a background task instead of poll()
+   * @param stackSize Task stack size in bytes (default: 8192)
+   * @param priority Task priority (default: 1)
+   * @return true if the task was started
+   */
+  bool startBackgroundDrain(uint32_t stackSize = 8192, UBaseType_t priority = 1);
+
+  /**
+   * @return Bytes of undelivered records
+   */
+  size_t pendingBytes();
+
+private:
+  uint32_t append(uint8_t kind, const String& inputText, const uint8_t* image, size_t imageLength, const String& modelId, const String& systemPrompt, float temp);
+  bool deliverNext(bool* delivered);
+  uint32_t readPosition();
+  void writePosition(uint32_t position);
+  void removeIfDrained();
+  bool takeToken();
+  static void drainTask(void* arg);
+
+  String path_;
+  String positionPath_;
+  fs::FS* fs_;
+  const char* apiKey_;
+  DoubaoSpoolCallback callback_;
+  void* context_;
+  uint32_t nextId_;
+  float rate_;
+  float burst_;
+  float tokens_;
+  unsigned long lastRefill_;
+  WiFiClientSecure client_;
+  SemaphoreHandle_t lock_;
+  TaskHandle_t task_;
+};
+
+/**
+ * Get GPT answer, spooling the request when the network is unavailable
+ * @param spool Opened spool
+ * @param inputText Text message to send
+ * @param apiKey API key for authentication
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @param spoolId Output request id when the request was spooled (optional)
+ * @return AI response, ERROR_SPOOLED if queued for later delivery, or error code
+ */
+String getGPTAnswerSpooled(DoubaoSpool& spool, const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, uint32_t* spoolId = nullptr);
+
+#endif // DOUBAO_SPOOL_H
@@ -0,0 +1,334 @@
+#include "doubao_tls.h"
+#include <mbedtls/md.h>
+#include <mbedtls/version.h>
+#include "doubao_socket.h"
+
+DoubaoTlsConfig::DoubaoTlsConfig()
+    : ready_(false), hasCA_(false), fragmentLength_(DOUBAO_TLS_FRAGMENT_LENGTH), pinCount_(0) {
+  lock_ = xSemaphoreCreateMutex();
+  mbedtls_entropy_init(&entropy_);
+  mbedtls_ctr_drbg_init(&drbg_);
+  mbedtls_x509_crt_init(&ca_);
+  mbedtls_ssl_config_init(&conf_);
+}
+
+DoubaoTlsConfig::~DoubaoTlsConfig() {
+  mbedtls_ssl_config_free(&conf_);
+  mbedtls_x509_crt_free(&ca_);
+  mbedtls_ctr_drbg_free(&drbg_);
+  mbedtls_entropy_free(&entropy_);
+  if (lock_ != nullptr) {
+    vSemaphoreDelete(lock_);
+  }
+}
+
+bool DoubaoTlsConfig::addCACert(const char* pem) {
+  DoubaoMutexLock lock(lock_);
+  if (ready_ || pem == nullptr) {
+    Serial.println("Error: TLS config already in use");
+    return false;
+  }
+  int rv = mbedtls_x509_crt_parse(&ca_, (const unsigned char*)pem, strlen(pem) + 1);
+  if (rv != 0) {
+    Serial.printf("Error: Invalid CA certificate (-0x%04x)\n", -rv);
+    return false;
+  }
+  hasCA_ = true;
+  return true;
+}
+
+bool DoubaoTlsConfig::addPinnedKey(const char* sha256Hex) {
+  DoubaoMutexLock lock(lock_);
+  if (ready_ || pinCount_ >= DOUBAO_TLS_MAX_PINS || sha256Hex == nullptr || strlen(sha256Hex) != 64) {
+    Serial.println("Error: Cannot add pinned key");
+    return false;
+  }
+  for (int i = 0; i < 32; i++) {
+    char byte[3] = {sha256Hex[i * 2], sha256Hex[i * 2 + 1], 0};
+    char* end;
+    pins_[pinCount_][i] = (uint8_t)strtoul(byte, &end, 16);
+    if (*end != 0) {
+      Serial.println("Error: Pinned key must be hex");
+      return false;
+    }
+  }
+  pinCount_++;
+  return true;
+}
+
+bool DoubaoTlsConfig::setMaxFragmentLength(uint16_t bytes) {
+  DoubaoMutexLock lock(lock_);
+  if (ready_ || (bytes != 0 && bytes != 512 && bytes != 1024 && bytes != 2048 && bytes != 4096)) {
+    Serial.println("Error: Invalid max fragment length");
+    return false;
+  }
+  fragmentLength_ = bytes;
+  return true;
+}
+
+bool DoubaoTlsConfig::begin() {
+  // Clients connecting from several tasks at once must not seed the RNG twice
+  DoubaoMutexLock lock(lock_);
+  if (ready_) {
+    return true;
+  }
+  const char* personalization = "doubao_tls";
+  int rv = mbedtls_ctr_drbg_seed(&drbg_, mbedtls_entropy_func, &entropy_, (const unsigned char*)personalization, strlen(personalization));
+  if (rv == 0) {
+    rv = mbedtls_ssl_config_defaults(&conf_, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (rv != 0) {
+    Serial.printf("Error: TLS setup failed (-0x%04x)\n", -rv);
+    return false;
+  }
+  mbedtls_ssl_conf_rng(&conf_, mbedtls_ctr_drbg_random, &drbg_);
+  if (hasCA_) {
+    mbedtls_ssl_conf_ca_chain(&conf_, &ca_, nullptr);
+    mbedtls_ssl_conf_authmode(&conf_, MBEDTLS_SSL_VERIFY_REQUIRED);
+  } else {
+    // Same as WiFiClientSecure::setInsecure(); pinned keys still apply
+    mbedtls_ssl_conf_authmode(&conf_, MBEDTLS_SSL_VERIFY_NONE);
+  }
+#ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+  unsigned char code = MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
+  switch (fragmentLength_) {
+    case 512: code = MBEDTLS_SSL_MAX_FRAG_LEN_512; break;
+    case 1024: code = MBEDTLS_SSL_MAX_FRAG_LEN_1024; break;
+    case 2048: code = MBEDTLS_SSL_MAX_FRAG_LEN_2048; break;
+    case 4096: code = MBEDTLS_SSL_MAX_FRAG_LEN_4096; break;
+  }
+  mbedtls_ssl_conf_max_frag_len(&conf_, code);
+#endif
+  ready_ = true;
+  return true;
+}
+
+const mbedtls_ssl_config* DoubaoTlsConfig::config() const {
+  return &conf_;
+}
+
+bool DoubaoTlsConfig::checkPin(const mbedtls_x509_crt* peer) const {
+  if (pinCount_ == 0) {
+    return true;
+  }
+  if (peer == nullptr) {
+    return false;
+  }
+  // The key is written at the end of the buffer
+  unsigned char der[800];
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+  mbedtls_pk_context* key = (mbedtls_pk_context*)&peer->MBEDTLS_PRIVATE(pk);
+#else
+  mbedtls_pk_context* key = (mbedtls_pk_context*)&peer->pk;
+#endif
+  int length = mbedtls_pk_write_pubkey_der(key, der, sizeof(der));
+  if (length <= 0) {
+    return false;
+  }
+  uint8_t hash[32];
+  mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), der + sizeof(der) - length, length, hash);
+  for (int i = 0; i < pinCount_; i++) {
+    if (memcmp(hash, pins_[i], 32) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void DoubaoTlsConfig::printInfo(Print& out) const {
+  out.printf("TLS record buffers: %u in / %u out", (unsigned)MBEDTLS_SSL_IN_CONTENT_LEN, (unsigned)MBEDTLS_SSL_OUT_CONTENT_LEN);
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER
+  out.print(" (dynamic)");
+#endif
+  out.printf(", max fragment %u, %s, %d pinned keys\n", fragmentLength_,
+             hasCA_ ? "CA verified" : "unverified", pinCount_);
+}
+
+DoubaoTlsConfig& doubaoTlsConfig() {
+  static DoubaoTlsConfig config;
+  return config;
+}
+
+DoubaoTlsClient::DoubaoTlsClient(DoubaoTlsConfig& config)
+    : config_(config), hasSession_(false), active_(false), open_(false), peeked_(-1) {
+  mbedtls_ssl_session_init(&session_);
+}
+
+DoubaoTlsClient::~DoubaoTlsClient() {
+  stop();
+  mbedtls_ssl_session_free(&session_);
+}
+
+// Sleeps until the socket is ready in the direction mbedTLS asked for, at most until deadline
+static void waitForSocket(int socket, int rv, unsigned long deadline) {
+  long remaining = (long)(deadline - millis());
+  if (remaining > 0) {
+    doubaoSocketWait(socket, rv == MBEDTLS_ERR_SSL_WANT_WRITE, remaining);
+  }
+}
+
+int DoubaoTlsClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port);
+}
+
+int DoubaoTlsClient::connect(const char* host, uint16_t port) {
+  stop();
+  if (!config_.begin()) {
+    return 0;
+  }
+  char portText[8];
+  snprintf(portText, sizeof(portText), "%u", port);
+  mbedtls_net_init(&net_);
+  mbedtls_ssl_init(&ssl_);
+  active_ = true;
+  int rv = mbedtls_net_connect(&net_, host, portText, MBEDTLS_NET_PROTO_TCP);
+  if (rv == 0) {
+    mbedtls_net_set_nonblock(&net_);
+    rv = mbedtls_ssl_setup(&ssl_, config_.config());
+  }
+  if (rv == 0) {
+    rv = mbedtls_ssl_set_hostname(&ssl_, host);
+  }
+  if (rv != 0) {
+    Serial.printf("TLS connect to %s failed (-0x%04x)\n", host, -rv);
+    stop();
+    return 0;
+  }
+  mbedtls_ssl_set_bio(&ssl_, &net_, mbedtls_net_send, mbedtls_net_recv, nullptr);
+  if (hasSession_ && sessionHost_ == host) {
+    mbedtls_ssl_set_session(&ssl_, &session_);
+  }
+  unsigned long deadline = millis() + DOUBAO_TLS_HANDSHAKE_TIMEOUT_MS;
+  while ((rv = mbedtls_ssl_handshake(&ssl_)) != 0) {
+    if ((rv != MBEDTLS_ERR_SSL_WANT_READ && rv != MBEDTLS_ERR_SSL_WANT_WRITE) || (long)(millis() - deadline) >= 0) {
+      Serial.printf("TLS handshake with %s failed (-0x%04x)\n", host, -rv);
+      stop();
+      return 0;
+    }
+    waitForSocket(net_.fd, rv, deadline);
+  }
+  if (!config_.checkPin(mbedtls_ssl_get_peer_cert(&ssl_))) {
+    Serial.printf("Error: %s key is not pinned\n", host);
+    stop();
+    return 0;
+  }
+  mbedtls_ssl_session_free(&session_);
+  mbedtls_ssl_session_init(&session_);
+  hasSession_ = mbedtls_ssl_get_session(&ssl_, &session_) == 0;
+  sessionHost_ = host;
+  open_ = true;
+  return 1;
+}
+
+size_t DoubaoTlsClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t DoubaoTlsClient::write(const uint8_t* buf, size_t size) {
+  size_t written = 0;
+  unsigned long deadline = millis() + DOUBAO_TLS_HANDSHAKE_TIMEOUT_MS;
+  while (open_ && written < size) {
+    int rv = mbedtls_ssl_write(&ssl_, buf + written, size - written);
+    if (rv > 0) {
+      written += rv;
+    } else if ((rv == MBEDTLS_ERR_SSL_WANT_READ || rv == MBEDTLS_ERR_SSL_WANT_WRITE) && (long)(millis() - deadline) < 0) {
+      waitForSocket(net_.fd, rv, deadline);
+    } else {
+      open_ = false;
+    }
+  }
+  return written;
+}
+
+// Pulls one byte into peeked_ so available() can report data without blocking
+bool DoubaoTlsClient::fill() {
+  if (peeked_ >= 0) {
+    return true;
+  }
+  if (!open_) {
+    return false;
+  }
+  unsigned char b;
+  int rv = mbedtls_ssl_read(&ssl_, &b, 1);
+  if (rv == 1) {
+    peeked_ = b;
+    return true;
+  }
+  if (rv != MBEDTLS_ERR_SSL_WANT_READ && rv != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    // 0 or MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY: closed by the server
+    open_ = false;
+  }
+  return false;
+}
+
+int DoubaoTlsClient::available() {
+  if (!fill()) {
+    return 0;
+  }
+  return 1 + (open_ ? mbedtls_ssl_get_bytes_avail(&ssl_) : 0);
+}
+
+int DoubaoTlsClient::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int DoubaoTlsClient::read(uint8_t* buf, size_t size) {
+  if (size == 0 || !fill()) {
+    return 0;
+  }
+  buf[0] = (uint8_t)peeked_;
+  peeked_ = -1;
+  int count = 1;
+  if (size > 1 && open_ && mbedtls_ssl_get_bytes_avail(&ssl_) > 0) {
+    int rv = mbedtls_ssl_read(&ssl_, buf + 1, size - 1);
+    if (rv > 0) {
+      count += rv;
+    }
+  }
+  return count;
+}
+
+int DoubaoTlsClient::peek() {
+  return fill() ? peeked_ : -1;
+}
+
+void DoubaoTlsClient::flush() {
+}
+
+void DoubaoTlsClient::stop() {
+  if (active_) {
+    if (open_) {
+      mbedtls_ssl_close_notify(&ssl_);
+    }
+    mbedtls_ssl_free(&ssl_);
+    mbedtls_net_free(&net_);
+  }
+  active_ = false;
+  open_ = false;
+  peeked_ = -1;
+}
+
+uint8_t DoubaoTlsClient::connected() {
+  fill();
+  return open_ || peeked_ >= 0;
+}
+
+int DoubaoTlsClient::fd() const {
+  return active_ ? net_.fd : -1;
+}
+
+DoubaoTlsClient::operator bool() {
+  return connected();
+}
+
+size_t DoubaoTlsClient::fragmentLength() {
+  if (!open_) {
+    return 0;
+  }
+#ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+  return mbedtls_ssl_get_output_max_frag_len(&ssl_);
+#else
+  return MBEDTLS_SSL_OUT_CONTENT_LEN;
+#endif
+}
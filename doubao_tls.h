@@ -0,0 +1,147 @@
+#ifndef DOUBAO_TLS_H
+#define DOUBAO_TLS_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+#include "doubao_lock.h"
+
+// Requested maximum fragment length (512, 1024, 2048 or 4096; 0 disables the extension)
+#define DOUBAO_TLS_FRAGMENT_LENGTH 4096
+#define DOUBAO_TLS_MAX_PINS 4
+#define DOUBAO_TLS_HANDSHAKE_TIMEOUT_MS 15000
+
+/*
+ * Memory layout of a TLS connection:
+ * - DoubaoTlsConfig holds everything that can be shared: the RNG, the parsed
+ *   CA chain, pinned key hashes and the mbedTLS ssl_config. It is set up once
+ *   and then only read, so any number of clients (and tasks) can use it.
+ *   Setup runs under a mutex on first connect; the RNG relies on mbedTLS
+ *   threading support (MBEDTLS_THREADING_C, enabled in ESP-IDF) for its own lock.
+ * - DoubaoTlsClient holds only the per-connection ssl_context and socket.
+ *   Record buffer sizes come from the mbedTLS build (MBEDTLS_SSL_IN/OUT_CONTENT_LEN;
+ *   asymmetric 16 KB/4 KB in the Arduino core). When the server accepts the
+ *   max fragment length extension, its records are limited to
+ *   DOUBAO_TLS_FRAGMENT_LENGTH, and builds with CONFIG_MBEDTLS_DYNAMIC_BUFFER
+ *   then size the receive buffer to that instead of 16 KB.
+ * - The last session of each client is kept for resumption, which skips the
+ *   certificate exchange and its allocations on reconnect.
+ */
+class DoubaoTlsConfig {
+public:
+  DoubaoTlsConfig();
+  ~DoubaoTlsConfig();
+
+  /**
+   * Add trusted CA certificates; enables certificate verification
+   * @param pem PEM encoded certificate(s)
+   * @return true on success, false if invalid or the config is already in use
+   */
+  bool addCACert(const char* pem);
+
+  /**
+   * Pin a server public key
+   * @param sha256Hex SHA-256 of the DER SubjectPublicKeyInfo as 64 hex digits
+   * @return true on success, false if invalid, full or the config is already in use
+   */
+  bool addPinnedKey(const char* sha256Hex);
+
+  /**
+   * Set the requested maximum fragment length
+   * @param bytes 512, 1024, 2048 or 4096; 0 disables the extension
+   * @return true on success, false if invalid or the config is already in use
+   */
+  bool setMaxFragmentLength(uint16_t bytes);
+
+  /**
+   * Seed the RNG and build the shared ssl_config; called on first connect
+   * @return true on success, false otherwise
+   */
+  bool begin();
+
+  /**
+   * @return Shared ssl_config, valid after begin()
+   */
+  const mbedtls_ssl_config* config() const;
+
+  /**
+   * Check a server certificate against the pinned keys
+   * @param peer Server certificate
+   * @return true if no keys are pinned or the certificate key is pinned
+   */
+  bool checkPin(const mbedtls_x509_crt* peer) const;
+
+  /**
+   * Print record buffer sizes and TLS settings
+   * @param out Output stream (e.g. Serial)
+   */
+  void printInfo(Print& out) const;
+
+private:
+  SemaphoreHandle_t lock_;
+  bool ready_;
+  bool hasCA_;
+  uint16_t fragmentLength_;
+  int pinCount_;
+  uint8_t pins_[DOUBAO_TLS_MAX_PINS][32];
+  mbedtls_entropy_context entropy_;
+  mbedtls_ctr_drbg_context drbg_;
+  mbedtls_x509_crt ca_;
+  mbedtls_ssl_config conf_;
+};
+
+/**
+ * @return TLS config shared by all clients that do not get their own
+ */
+DoubaoTlsConfig& doubaoTlsConfig();
+
+/**
+ * TLS client using a shared DoubaoTlsConfig
+ */
+class DoubaoTlsClient final : public Client {
+public:
+  DoubaoTlsClient(DoubaoTlsConfig& config = doubaoTlsConfig());
+  ~DoubaoTlsClient();
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override;
+
+  /**
+   * @return Socket descriptor for select(), -1 if not connected
+   */
+  int fd() const;
+
+  /**
+   * @return Negotiated maximum record size, 0 if not connected
+   */
+  size_t fragmentLength();
+
+private:
+  bool fill();
+
+  DoubaoTlsConfig& config_;
+  mbedtls_ssl_context ssl_;
+  mbedtls_net_context net_;
+  mbedtls_ssl_session session_;
+  String sessionHost_;
+  bool hasSession_;
+  bool active_;
+  bool open_;
+  int peeked_;
+};
+
+#endif // DOUBAO_TLS_H
@@ -0,0 +1,388 @@
+#include "doubao_tools.h"
+#include "doubao_client.h"
+
+DoubaoToolSet::DoubaoToolSet() : count_(0), jsonValid_(false), jobs_(nullptr), done_(nullptr), workerCount_(0) {
+}
+
+DoubaoToolSet::~DoubaoToolSet() {
+  stopWorkers();
+}
+
+bool DoubaoToolSet::add(const char* name, const char* description, const char* parameters, DoubaoToolHandler handler,
+                        void* context, bool parallel) {
+  if (name == nullptr || name[0] == '\0' || strlen(name) > DOUBAO_TOOL_NAME_LENGTH || handler == nullptr) {
+    Serial.println("Error: Tool needs a name and a handler");
+    return false;
+  }
+  if (find(name) >= 0) {
+    Serial.printf("Error: Tool %s already added\n", name);
+    return false;
+  }
+  if (count_ == DOUBAO_TOOL_MAX_TOOLS) {
+    Serial.printf("Error: Tool set holds at most %d tools\n", DOUBAO_TOOL_MAX_TOOLS);
+    return false;
+  }
+  tools_[count_++] = {name, description, parameters, handler, context, parallel};
+  jsonValid_ = false;
+  return true;
+}
+
+int DoubaoToolSet::count() const {
+  return count_;
+}
+
+int DoubaoToolSet::find(const char* name) const {
+  for (int i = 0; i < count_; i++) {
+    if (strcmp(tools_[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const String& DoubaoToolSet::json() {
+  if (jsonValid_) {
+    return json_;
+  }
+  size_t size = 2;
+  for (int i = 0; i < count_; i++) {
+    size += 80 + strlen(tools_[i].name) + (tools_[i].description != nullptr ? strlen(tools_[i].description) + 8 : 0) +
+            (tools_[i].parameters != nullptr ? strlen(tools_[i].parameters) : 40);
+  }
+  json_ = "";
+  json_.reserve(size);
+  json_ += "[";
+  for (int i = 0; i < count_; i++) {
+    const DoubaoTool& tool = tools_[i];
+    if (i > 0) {
+      json_ += ",";
+    }
+    json_ += "{\"type\":\"function\",\"function\":{\"name\":\"";
+    json_ += tool.name;
+    json_ += "\"";
+    if (tool.description != nullptr) {
+      json_ += ",\"description\":\"" + jsonEscape(tool.description) + "\"";
+    }
+    json_ += ",\"parameters\":";
+    json_ += tool.parameters != nullptr ? tool.parameters : "{\"type\":\"object\",\"properties\":{}}";
+    json_ += "}}";
+  }
+  json_ += "]";
+  jsonValid_ = true;
+  return json_;
+}
+
+bool DoubaoToolSet::startWorkers(int workers, uint32_t stackSize, UBaseType_t priority) {
+  if (workerCount_ > 0) {
+    return true;
+  }
+  if (workers < 1 || workers > DOUBAO_TOOL_MAX_WORKERS) {
+    Serial.printf("Error: Worker count must be 1 to %d\n", DOUBAO_TOOL_MAX_WORKERS);
+    return false;
+  }
+  jobs_ = xQueueCreate(DOUBAO_TOOL_MAX_CALLS, sizeof(DoubaoToolCall*));
+  done_ = xSemaphoreCreateCounting(DOUBAO_TOOL_MAX_CALLS + DOUBAO_TOOL_MAX_WORKERS, 0);
+  if (jobs_ == nullptr || done_ == nullptr) {
+    Serial.println("Error: Failed to create tool worker queue");
+    stopWorkers();
+    return false;
+  }
+  for (int i = 0; i < workers; i++) {
+    if (xTaskCreate(workerTask, "doubao_tool", stackSize, this, priority, &workers_[i]) != pdPASS) {
+      Serial.println("Error: Failed to start tool worker");
+      stopWorkers();
+      return false;
+    }
+    workerCount_++;
+  }
+  return true;
+}
+
+void DoubaoToolSet::stopWorkers() {
+  // A null job tells a worker to exit; it signals done_ on its way out
+  DoubaoToolCall* stop = nullptr;
+  for (int i = 0; i < workerCount_; i++) {
+    xQueueSend(jobs_, &stop, portMAX_DELAY);
+  }
+  for (int i = 0; i < workerCount_; i++) {
+    xSemaphoreTake(done_, portMAX_DELAY);
+  }
+  workerCount_ = 0;
+  if (jobs_ != nullptr) {
+    vQueueDelete(jobs_);
+    jobs_ = nullptr;
+  }
+  if (done_ != nullptr) {
+    vSemaphoreDelete(done_);
+    done_ = nullptr;
+  }
+}
+
+void DoubaoToolSet::workerTask(void* arg) {
+  DoubaoToolSet* set = (DoubaoToolSet*)arg;
+  DoubaoToolCall* call;
+  for (;;) {
+    xQueueReceive(set->jobs_, &call, portMAX_DELAY);
+    if (call == nullptr) {
+      break;
+    }
+    set->execute(*call);
+    xSemaphoreGive(set->done_);
+  }
+  xSemaphoreGive(set->done_);
+  vTaskDelete(nullptr);
+}
+
+void DoubaoToolSet::execute(DoubaoToolCall& call) {
+  unsigned long start = DoubaoClock::now();
+  int tool = find(call.name);
+  if (tool < 0) {
+    Serial.printf("Error: Model called unknown tool %s\n", call.name);
+    call.result = "{\"error\":\"unknown tool\"}";
+  } else {
+    call.result = tools_[tool].handler(call.arguments.length() > 0 ? call.arguments : String("{}"), tools_[tool].context);
+  }
+  call.durationMs = DoubaoClock::now() - start;
+}
+
+int DoubaoToolSet::run(DoubaoToolCall* calls, int count) {
+  int queued = 0;
+  if (workerCount_ > 0) {
+    for (int i = 0; i < count; i++) {
+      int tool = find(calls[i].name);
+      if (tool >= 0 && tools_[tool].parallel) {
+        DoubaoToolCall* job = &calls[i];
+        xQueueSend(jobs_, &job, portMAX_DELAY);
+        queued++;
+      }
+    }
+  }
+  // Everything not handed to a worker runs here, in the order the model asked
+  for (int i = 0; i < count; i++) {
+    int tool = find(calls[i].name);
+    if (workerCount_ == 0 || tool < 0 || !tools_[tool].parallel) {
+      execute(calls[i]);
+    }
+  }
+  for (int i = 0; i < queued; i++) {
+    xSemaphoreTake(done_, portMAX_DELAY);
+  }
+  return queued;
+}
+
+DoubaoToolCallDecoder::DoubaoToolCallDecoder(DoubaoToolCall* calls, int capacity)
+    : calls_(calls), capacity_(capacity), handler_{this}, stream_(handler_) {
+  reset();
+}
+
+void DoubaoToolCallDecoder::reset() {
+  stream_.reset();
+  length_ = 0;
+  count_ = 0;
+  current_ = -1;
+  target_ = TARGET_NONE;
+  targetLength_ = 0;
+  content_ = "";
+  finishReason_[0] = '\0';
+  promptTokens_ = 0;
+  completionTokens_ = 0;
+}
+
+// The body is never stored; only the content and arguments are kept
+void DoubaoToolCallDecoder::reserve(size_t size) {
+}
+
+bool DoubaoToolCallDecoder::append(DoubaoStringView data) {
+  length_ += data.length;
+  return stream_.feed(data.data, data.length);
+}
+
+size_t DoubaoToolCallDecoder::length() const {
+  return length_;
+}
+
+bool DoubaoToolCallDecoder::finish() {
+  if (!stream_.finish()) {
+    Serial.println("Error: Tool call response is not valid JSON");
+    return false;
+  }
+  return true;
+}
+
+int DoubaoToolCallDecoder::count() const {
+  return count_;
+}
+
+const String& DoubaoToolCallDecoder::content() const {
+  return content_;
+}
+
+void DoubaoToolCallDecoder::fillMeta(DoubaoResponseMeta* meta) const {
+  meta->promptTokens = promptTokens_;
+  meta->completionTokens = completionTokens_;
+  meta->finishReason = finishReason_;
+}
+
+// choices[0].message
+static bool isFirstMessage(const DoubaoJsonStream<DoubaoToolCallDecoder::Handler>& s) {
+  return strcmp(s.key(1), "choices") == 0 && s.index(2) == 0 && strcmp(s.key(3), "message") == 0;
+}
+
+void DoubaoToolCallDecoder::Handler::onContainerStart(bool isObject) {
+  const DoubaoJsonStream<Handler>& s = decoder->stream_;
+  // choices[0].message.tool_calls[i] starts a call
+  if (s.depth() == 6 && isObject && isFirstMessage(s) && strcmp(s.key(4), "tool_calls") == 0) {
+    if (decoder->count_ == decoder->capacity_) {
+      Serial.printf("Error: More than %d tool calls, extra calls dropped\n", decoder->capacity_);
+      decoder->current_ = -1;
+      return;
+    }
+    DoubaoToolCall& call = decoder->calls_[decoder->count_];
+    call.id[0] = '\0';
+    call.name[0] = '\0';
+    call.arguments = "";
+    call.result = "";
+    call.durationMs = 0;
+    decoder->current_ = decoder->count_++;
+  }
+}
+
+void DoubaoToolCallDecoder::Handler::onStringStart() {
+  const DoubaoJsonStream<Handler>& s = decoder->stream_;
+  decoder->target_ = TARGET_NONE;
+  decoder->targetLength_ = 0;
+  if (s.depth() == 3 && strcmp(s.key(1), "choices") == 0 && s.index(2) == 0 && strcmp(s.key(3), "finish_reason") == 0) {
+    decoder->target_ = TARGET_FINISH_REASON;
+  } else if (s.depth() == 4 && isFirstMessage(s) && strcmp(s.key(4), "content") == 0) {
+    decoder->target_ = TARGET_CONTENT;
+  } else if (decoder->current_ >= 0 && s.depth() >= 6 && isFirstMessage(s) && strcmp(s.key(4), "tool_calls") == 0) {
+    if (s.depth() == 6 && strcmp(s.key(6), "id") == 0) {
+      decoder->target_ = TARGET_ID;
+    } else if (s.depth() == 7 && strcmp(s.key(6), "function") == 0) {
+      if (strcmp(s.key(7), "name") == 0) {
+        decoder->target_ = TARGET_NAME;
+      } else if (strcmp(s.key(7), "arguments") == 0) {
+        decoder->target_ = TARGET_ARGUMENTS;
+      }
+    }
+  }
+}
+
+void DoubaoToolCallDecoder::Handler::onStringByte(char c) {
+  size_t& length = decoder->targetLength_;
+  switch (decoder->target_) {
+    case TARGET_CONTENT:
+      decoder->content_ += c;
+      break;
+    case TARGET_FINISH_REASON:
+      if (length < sizeof(decoder->finishReason_) - 1) {
+        decoder->finishReason_[length++] = c;
+      }
+      break;
+    case TARGET_ID:
+      if (length < DOUBAO_TOOL_ID_LENGTH) {
+        decoder->calls_[decoder->current_].id[length++] = c;
+      }
+      break;
+    case TARGET_NAME:
+      if (length < DOUBAO_TOOL_NAME_LENGTH) {
+        decoder->calls_[decoder->current_].name[length++] = c;
+      }
+      break;
+    case TARGET_ARGUMENTS:
+      decoder->calls_[decoder->current_].arguments += c;
+      break;
+    case TARGET_NONE:
+      break;
+  }
+}
+
+void DoubaoToolCallDecoder::Handler::onStringEnd() {
+  size_t length = decoder->targetLength_;
+  switch (decoder->target_) {
+    case TARGET_FINISH_REASON:
+      decoder->finishReason_[length] = '\0';
+      break;
+    case TARGET_ID:
+      decoder->calls_[decoder->current_].id[length] = '\0';
+      break;
+    case TARGET_NAME:
+      decoder->calls_[decoder->current_].name[length] = '\0';
+      break;
+    default:
+      break;
+  }
+  decoder->target_ = TARGET_NONE;
+}
+
+void DoubaoToolCallDecoder::Handler::onLiteral(const char* text, size_t length) {
+  const DoubaoJsonStream<Handler>& s = decoder->stream_;
+  if (s.depth() == 2 && strcmp(s.key(1), "usage") == 0) {
+    if (strcmp(s.key(2), "prompt_tokens") == 0) {
+      decoder->promptTokens_ = atoi(text);
+    } else if (strcmp(s.key(2), "completion_tokens") == 0) {
+      decoder->completionTokens_ = atoi(text);
+    }
+  }
+}
+
+String buildToolMessages(const String& systemPrompt, const String& inputText) {
+  String messages;
+  messages.reserve(systemPrompt.length() + inputText.length() + 64);
+  messages = "{\"role\":\"system\",\"content\":\"" + jsonEscape(systemPrompt) + "\"},";
+  messages += "{\"role\":\"user\",\"content\":\"" + jsonEscape(inputText) + "\"}";
+  return messages;
+}
+
+void appendToolResults(String& messages, const DoubaoToolCall* calls, int count) {
+  size_t size = messages.length() + 64;
+  for (int i = 0; i < count; i++) {
+    size += 2 * (strlen(calls[i].id) + strlen(calls[i].name)) + calls[i].arguments.length() * 2 + calls[i].result.length() * 2 + 128;
+  }
+  messages.reserve(size);
+  messages += ",{\"role\":\"assistant\",\"content\":\"\",\"tool_calls\":[";
+  for (int i = 0; i < count; i++) {
+    if (i > 0) {
+      messages += ",";
+    }
+    messages += "{\"id\":\"";
+    messages += calls[i].id;
+    messages += "\",\"type\":\"function\",\"function\":{\"name\":\"";
+    messages += calls[i].name;
+    messages += "\",\"arguments\":\"" + jsonEscape(calls[i].arguments) + "\"}}";
+  }
+  messages += "]}";
+  for (int i = 0; i < count; i++) {
+    messages += ",{\"role\":\"tool\",\"tool_call_id\":\"";
+    messages += calls[i].id;
+    messages += "\",\"content\":\"" + jsonEscape(calls[i].result) + "\"}";
+  }
+}
+
+String buildToolPayload(const String& messages, const String& modelId, float temp, DoubaoToolSet& tools) {
+  const String& toolsJson = tools.json();
+  String payload;
+  payload.reserve(messages.length() + toolsJson.length() + modelId.length() + 80);
+  payload = "{\"model\":\"" + modelId + "\",";
+  payload += "\"messages\":[";
+  payload += messages;
+  payload += "],\"tools\":";
+  payload += toolsJson;
+  payload += ",\"temperature\":" + String(temp);
+  payload += "}";
+  return payload;
+}
+
+String getGPTAnswerWithTools(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp,
+                             DoubaoToolSet& tools, DoubaoToolStats* stats) {
+  if (!validateConfig(apiKey, modelId, temp)) {
+    return ERROR_INVALID_INPUT;
+  }
+  DoubaoClient<DoubaoKeepAliveTransport<>> client;
+  if (!client.begin(apiKey, modelId)) {
+    return ERROR_INVALID_INPUT;
+  }
+  String result = client.askWithTools(inputText, systemPrompt, temp, tools, stats);
+  client.transport().stop();
+  return result;
+}
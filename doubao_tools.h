@@ -0,0 +1,253 @@
+#ifndef DOUBAO_TOOLS_H
+#define DOUBAO_TOOLS_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+#include "doubao_json_stream.h"
+#include "doubao_view.h"
+
+#define DOUBAO_TOOL_MAX_TOOLS 16      // Tools per DoubaoToolSet
+#define DOUBAO_TOOL_MAX_CALLS 8       // Tool calls handled per model turn
+#define DOUBAO_TOOL_MAX_WORKERS 4     // Worker tasks per DoubaoToolSet
+#define DOUBAO_TOOL_MAX_ROUNDS 4      // Default model turns per askWithTools()
+#define DOUBAO_TOOL_ID_LENGTH 48
+#define DOUBAO_TOOL_NAME_LENGTH 32
+
+/**
+ * Runs one tool call
+ * @param arguments Arguments chosen by the model, a JSON object as text
+ * @param context User pointer given to DoubaoToolSet::add()
+ * @return Result for the model (plain text or JSON)
+ */
+typedef String (*DoubaoToolHandler)(const String& arguments, void* context);
+
+struct DoubaoTool {
+  const char* name;
+  const char* description;
+  const char* parameters;   // JSON Schema of the arguments object, nullptr for none
+  DoubaoToolHandler handler;
+  void* context;
+  bool parallel;            // May run on a worker task alongside other calls
+};
+
+// One tool call requested by the model, and its result
+struct DoubaoToolCall {
+  char id[DOUBAO_TOOL_ID_LENGTH + 1];
+  char name[DOUBAO_TOOL_NAME_LENGTH + 1];
+  String arguments;
+  String result;
+  unsigned long durationMs;
+};
+
+// Wall time of an askWithTools() loop, split by phase
+struct DoubaoToolStats {
+  int rounds = 0;                  // Model turns
+  int toolCalls = 0;
+  int parallelCalls = 0;           // Calls that ran on worker tasks
+  unsigned long totalMs = 0;       // Whole loop
+  unsigned long buildMs = 0;       // Building payloads
+  unsigned long requestMs = 0;     // Sending, waiting and parsing responses as they arrive
+  unsigned long toolMs = 0;        // Running tools, wall time
+  unsigned long toolBusyMs = 0;    // Running tools, sum of each call's duration
+  int promptTokens = 0;
+  int completionTokens = 0;
+};
+
+/**
+ * Tools offered to the model. The "tools" array is serialized once and cached;
+ * independent calls of one turn run in parallel once workers are started.
+ */
+class DoubaoToolSet {
+public:
+  DoubaoToolSet();
+  ~DoubaoToolSet();
+
+  /**
+   * Add a tool
+   * @param name Function name (letters, digits, '_' and '-')
+   * @param description What the tool does, for the model
+   * @param parameters JSON Schema of the arguments object, nullptr for none; must stay valid
+   * @param handler Called with the arguments of each call
+   * @param context User pointer passed to handler
+   * @param parallel false if the tool must not run alongside others (shared bus, actuator order)
+   * @return true on success, false otherwise
+   */
+  bool add(const char* name, const char* description, const char* parameters, DoubaoToolHandler handler,
+           void* context = nullptr, bool parallel = true);
+
+  /**
+   * @return Number of tools
+   */
+  int count() const;
+
+  /**
+   * @param name Function name
+   * @return Tool index, -1 if not found
+   */
+  int find(const char* name) const;
+
+  /**
+   * @return The "tools" request array, rendered on first use after a change
+   */
+  const String& json();
+
+  /**
+   * Start worker tasks for parallel tool calls; without workers every call runs on the calling task
+   * @param workers Number of worker tasks (1 to DOUBAO_TOOL_MAX_WORKERS)
+   * @param stackSize Stack of each worker, in bytes
+   * @param priority FreeRTOS priority of the workers
+   * @return true on success, false otherwise
+   */
+  bool startWorkers(int workers = 2, uint32_t stackSize = 6144, UBaseType_t priority = 1);
+
+  /**
+   * Stop the worker tasks; calls run on the calling task afterwards
+   */
+  void stopWorkers();
+
+  /**
+   * Run the calls of one model turn and fill their results. Parallel tools go
+   * to the workers while the other calls run here, in order.
+   * @param calls Calls to run
+   * @param count Number of calls
+   * @return Number of calls that ran on worker tasks
+   */
+  int run(DoubaoToolCall* calls, int count);
+
+private:
+  static void workerTask(void* arg);
+  void execute(DoubaoToolCall& call);
+
+  DoubaoTool tools_[DOUBAO_TOOL_MAX_TOOLS];
+  int count_;
+  String json_;
+  bool jsonValid_;
+  QueueHandle_t jobs_;
+  SemaphoreHandle_t done_;
+  TaskHandle_t workers_[DOUBAO_TOOL_MAX_WORKERS];
+  int workerCount_;
+};
+
+/**
+ * Reads the tool calls, content, finish_reason and usage of a chat completions
+ * response while it arrives; tool call arguments are unescaped straight into
+ * their call. Usable as a body sink (reserve/append/length).
+ */
+class DoubaoToolCallDecoder {
+public:
+  /**
+   * @param calls Output array
+   * @param capacity Size of calls; further calls are dropped with a log line
+   */
+  DoubaoToolCallDecoder(DoubaoToolCall* calls, int capacity);
+
+  /**
+   * Start a new response
+   */
+  void reset();
+
+  void reserve(size_t size);
+
+  /**
+   * Feed response body bytes
+   * @return false once the body is not valid JSON
+   */
+  bool append(DoubaoStringView data);
+
+  size_t length() const;
+
+  /**
+   * @return true if the body was complete, valid JSON
+   */
+  bool finish();
+
+  /**
+   * @return Number of tool calls read
+   */
+  int count() const;
+
+  /**
+   * @return Message content, "" when the model only called tools
+   */
+  const String& content() const;
+
+  /**
+   * Copy usage and finish_reason from the response
+   * @param meta Output
+   */
+  void fillMeta(DoubaoResponseMeta* meta) const;
+
+  // DoubaoJsonStream handler
+  struct Handler {
+    DoubaoToolCallDecoder* decoder;
+    void onContainerStart(bool isObject);
+    void onContainerEnd(bool isObject) {
+    }
+    void onKey() {
+    }
+    void onStringStart();
+    void onStringByte(char c);
+    void onStringEnd();
+    void onLiteral(const char* text, size_t length);
+  };
+
+private:
+  enum Target : uint8_t { TARGET_NONE, TARGET_CONTENT, TARGET_FINISH_REASON, TARGET_ID, TARGET_NAME, TARGET_ARGUMENTS };
+
+  DoubaoToolCall* calls_;
+  int capacity_;
+  Handler handler_;
+  DoubaoJsonStream<Handler> stream_;
+  size_t length_;
+  int count_;
+  int current_;           // Call being read, -1 if none or dropped
+  Target target_;
+  size_t targetLength_;
+  String content_;
+  char finishReason_[16];
+  int promptTokens_;
+  int completionTokens_;
+};
+
+/**
+ * Render the opening messages of a tool conversation
+ * @param systemPrompt System prompt/role
+ * @param inputText User message
+ * @return Comma-separated message objects, without the enclosing brackets
+ */
+String buildToolMessages(const String& systemPrompt, const String& inputText);
+
+/**
+ * Append the assistant turn that requested calls, and one tool message per result
+ * @param messages Conversation from buildToolMessages()
+ * @param calls Calls with their results
+ * @param count Number of calls
+ */
+void appendToolResults(String& messages, const DoubaoToolCall* calls, int count);
+
+/**
+ * Build a chat payload offering the tools of a set
+ * @param messages Conversation from buildToolMessages()
+ * @param modelId Model ID to use
+ * @param temp Temperature parameter
+ * @param tools Tool set; its cached "tools" array is copied in
+ * @return JSON payload string
+ */
+String buildToolPayload(const String& messages, const String& modelId, float temp, DoubaoToolSet& tools);
+
+/**
+ * Ask a question and let the model call tools until it answers. All turns go
+ * over one kept-alive connection.
+ * @param inputText Text message to send
+ * @param apiKey API key for authentication
+ * @param modelId Model ID to use (must support function calling)
+ * @param systemPrompt System prompt/role
+ * @param temp Temperature parameter
+ * @param tools Tools offered to the model
+ * @param stats Optional output for the wall-time breakdown
+ * @return AI response or error code (ERROR_TOOL_ROUNDS if the model kept calling tools)
+ */
+String getGPTAnswerWithTools(const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp,
+                             DoubaoToolSet& tools, DoubaoToolStats* stats = nullptr);
+
+#endif // DOUBAO_TOOLS_H
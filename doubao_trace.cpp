@@ -0,0 +1,258 @@
+#include "doubao_trace.h"
+#include "doubao_json_path.h"
+#include "doubao_lock.h"
+#include "doubao_policies.h"
+
+static uint32_t fnv1a(const char* data, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (uint8_t)data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static bool contains(DoubaoStringView text, const char* needle) {
+  size_t n = strlen(needle);
+  for (size_t i = 0; i + n <= text.length; i++) {
+    if (memcmp(text.data + i, needle, n) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Hash of the "model" value; buildPayload() and buildPayloadInto() put it first
+static uint32_t modelHash(DoubaoStringView payload) {
+  static const char key[] = "\"model\":\"";
+  size_t limit = min(payload.length, (size_t)256);
+  for (size_t i = 0; i + sizeof(key) - 1 <= limit; i++) {
+    if (memcmp(payload.data + i, key, sizeof(key) - 1) == 0) {
+      const char* start = payload.data + i + sizeof(key) - 1;
+      const char* end = (const char*)memchr(start, '"', payload.data + payload.length - start);
+      return end != nullptr ? fnv1a(start, end - start) : 0;
+    }
+  }
+  return 0;
+}
+
+static uint16_t clamp16(long value) {
+  return (uint16_t)constrain(value, 0L, 65535L);
+}
+
+DoubaoTraceRecorder::DoubaoTraceRecorder(const char* path)
+    : path_(path), fs_(nullptr), begunAt_(0), buffered_(0), count_(0), lock_(xSemaphoreCreateMutex()) {
+}
+
+DoubaoTraceRecorder::~DoubaoTraceRecorder() {
+  flush();
+  if (lock_ != nullptr) {
+    vSemaphoreDelete(lock_);
+  }
+}
+
+bool DoubaoTraceRecorder::begin(fs::FS& fs) {
+  DoubaoMutexLock lock(lock_);
+  File file = fs.open(path_.c_str(), FILE_WRITE);
+  if (!file) {
+    Serial.println("Error: Failed to create trace file");
+    return false;
+  }
+  DoubaoTraceHeader header = {DOUBAO_TRACE_MAGIC, DOUBAO_TRACE_VERSION, sizeof(DoubaoTraceRecord)};
+  bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+  file.close();
+  if (!ok) {
+    Serial.println("Error: Failed to write trace header");
+    return false;
+  }
+  fs_ = &fs;
+  begunAt_ = DoubaoClock::now();
+  buffered_ = 0;
+  count_ = 0;
+  return true;
+}
+
+void DoubaoTraceRecorder::record(DoubaoStringView payload, const String& response, const DoubaoResponseMeta& meta, unsigned long startMs) {
+  // Everything derived from the payload is computed before taking the lock
+  DoubaoTraceRecord r;
+  memset(&r, 0, sizeof(r));
+  r.requestBytes = payload.length;
+  r.modelHash = modelHash(payload);
+  r.latencyMs = meta.latencyMs;
+  r.ttfbMs = meta.ttfbMs;
+  r.status = clamp16(meta.status);
+  // Called before the response is parsed, so usage is read straight from the raw body
+  DoubaoJsonExtractor extractor;
+  int promptTokens = extractor.add("/usage/prompt_tokens");
+  int completionTokens = extractor.add("/usage/completion_tokens");
+  if (meta.status == 200 && extractor.extract(response)) {
+    if (extractor.has(promptTokens)) {
+      r.promptTokens = clamp16(extractor.value(promptTokens).toInt());
+    }
+    if (extractor.has(completionTokens)) {
+      r.completionTokens = clamp16(extractor.value(completionTokens).toInt());
+    }
+  }
+  if (contains(payload, "\"image_url\"")) {
+    r.flags |= DOUBAO_TRACE_IMAGE;
+  }
+  if (isErrorResponse(response)) {
+    r.flags |= DOUBAO_TRACE_ERROR;
+  } else {
+    r.responseBytes = response.length();
+  }
+  DoubaoMutexLock lock(lock_);
+  if (fs_ == nullptr) {
+    return;
+  }
+  r.startMs = startMs - begunAt_;
+  buffer_[buffered_++] = r;
+  count_++;
+  if (buffered_ == DOUBAO_TRACE_BUFFER) {
+    File file = fs_->open(path_.c_str(), FILE_APPEND);
+    size_t size = buffered_ * sizeof(DoubaoTraceRecord);
+    if (!file || file.write((const uint8_t*)buffer_, size) != size) {
+      Serial.println("Error: Failed to write trace records");
+    }
+    if (file) {
+      file.close();
+    }
+    buffered_ = 0;
+  }
+}
+
+bool DoubaoTraceRecorder::flush() {
+  DoubaoMutexLock lock(lock_);
+  if (fs_ == nullptr || buffered_ == 0) {
+    return true;
+  }
+  File file = fs_->open(path_.c_str(), FILE_APPEND);
+  size_t size = buffered_ * sizeof(DoubaoTraceRecord);
+  bool ok = file && file.write((const uint8_t*)buffer_, size) == size;
+  if (file) {
+    file.close();
+  }
+  buffered_ = 0;
+  if (!ok) {
+    Serial.println("Error: Failed to write trace records");
+  }
+  return ok;
+}
+
+uint32_t DoubaoTraceRecorder::count() const {
+  return count_;
+}
+
+// Payload of about the recorded size: the text is padded to make up the difference
+static String syntheticPayload(const DoubaoTraceRecord& r, const String& modelId) {
+  String base = buildPayload("", modelId, "", 0.7);
+  size_t pad = r.requestBytes > base.length() ? r.requestBytes - base.length() : 0;
+  String filler;
+  filler.reserve(pad);
+  for (size_t i = 0; i < pad; i++) {
+    filler += 'x';
+  }
+  return buildPayload(filler, modelId, "", 0.7);
+}
+
+static int compareLatency(const void* a, const void* b) {
+  unsigned long x = *(const unsigned long*)a;
+  unsigned long y = *(const unsigned long*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Nearest-rank percentile of a sorted array
+static unsigned long percentile(const unsigned long* sorted, uint32_t count, int p) {
+  if (count == 0) {
+    return 0;
+  }
+  uint32_t rank = (count * p + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+bool doubaoReplayTrace(fs::FS& fs, const char* path, const char* apiKey, const String& modelId, float speed, DoubaoReplayReport* report) {
+  *report = DoubaoReplayReport();
+  File file = fs.open(path, FILE_READ);
+  if (!file) {
+    Serial.println("Error: Failed to open trace file");
+    return false;
+  }
+  DoubaoTraceHeader header;
+  if (file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) || header.magic != DOUBAO_TRACE_MAGIC ||
+      header.version != DOUBAO_TRACE_VERSION || header.recordSize != sizeof(DoubaoTraceRecord)) {
+    Serial.println("Error: Not a trace file");
+    file.close();
+    return false;
+  }
+  uint32_t capacity = (file.size() - sizeof(header)) / sizeof(DoubaoTraceRecord);
+  unsigned long* latencies = (unsigned long*)malloc(max(capacity, (uint32_t)1) * 2 * sizeof(unsigned long));
+  if (latencies == nullptr) {
+    Serial.println("Error: Out of memory for replay");
+    file.close();
+    return false;
+  }
+  unsigned long* ttfbs = latencies + capacity;
+  unsigned long begun = DoubaoClock::now();
+  DoubaoTraceRecord r;
+  bool complete = true;
+  for (uint32_t i = 0; i < capacity; i++) {
+    if (file.read((uint8_t*)&r, sizeof(r)) != sizeof(r)) {
+      complete = false;
+      break;
+    }
+    // A synthetic image is not a picture, so a real server would only answer 400
+    if (r.flags & DOUBAO_TRACE_IMAGE) {
+      report->skipped++;
+      continue;
+    }
+    if (speed > 0) {
+      unsigned long due = begun + (unsigned long)(r.startMs / speed);
+      long ahead = (long)(due - DoubaoClock::now());
+      if (ahead > 0) {
+        DoubaoClock::sleep(ahead);
+      } else if (-ahead > DOUBAO_REPLAY_LATE_MS) {
+        report->late++;
+      }
+    }
+    String payload = syntheticPayload(r, modelId);
+    DoubaoResponseMeta meta;
+    unsigned long start = DoubaoClock::now();
+    String response = sendApiRequest(DOUBAO_CHAT_PATH, payload, apiKey, &meta);
+    latencies[report->requests] = DoubaoClock::now() - start;
+    ttfbs[report->requests] = meta.ttfbMs;
+    report->requests++;
+    report->requestBytes += payload.length();
+    if (isErrorResponse(response)) {
+      report->failures++;
+    } else {
+      report->responseBytes += response.length();
+    }
+  }
+  file.close();
+  report->elapsedMs = DoubaoClock::now() - begun;
+  if (report->elapsedMs > 0) {
+    report->requestsPerSecond = report->requests * 1000.0f / report->elapsedMs;
+    report->bytesPerSecond = (report->requestBytes + report->responseBytes) * 1000.0f / report->elapsedMs;
+  }
+  qsort(latencies, report->requests, sizeof(unsigned long), compareLatency);
+  qsort(ttfbs, report->requests, sizeof(unsigned long), compareLatency);
+  report->latencyP50Ms = percentile(latencies, report->requests, 50);
+  report->latencyP90Ms = percentile(latencies, report->requests, 90);
+  report->latencyP99Ms = percentile(latencies, report->requests, 99);
+  report->latencyMaxMs = percentile(latencies, report->requests, 100);
+  report->ttfbP50Ms = percentile(ttfbs, report->requests, 50);
+  report->ttfbP99Ms = percentile(ttfbs, report->requests, 99);
+  free(latencies);
+  return complete;
+}
+
+void printReplayReport(const DoubaoReplayReport& report, Print& out) {
+  out.printf("Replayed %u requests in %lu ms: %u failed, %u started late, %u image requests skipped\n",
+             (unsigned)report.requests, report.elapsedMs, (unsigned)report.failures, (unsigned)report.late,
+             (unsigned)report.skipped);
+  out.printf("Throughput: %.2f requests/s, %.0f bytes/s (%lu sent, %lu received)\n", report.requestsPerSecond,
+             report.bytesPerSecond, (unsigned long)report.requestBytes, (unsigned long)report.responseBytes);
+  out.printf("Latency: p50 %lu ms, p90 %lu ms, p99 %lu ms, max %lu ms\n", report.latencyP50Ms, report.latencyP90Ms,
+             report.latencyP99Ms, report.latencyMaxMs);
+  out.printf("Time to first byte: p50 %lu ms, p99 %lu ms\n", report.ttfbP50Ms, report.ttfbP99Ms);
+}
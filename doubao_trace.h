@@ -0,0 +1,135 @@
+#ifndef DOUBAO_TRACE_H
+#define DOUBAO_TRACE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include "doubao_api.h"
+
+#define DOUBAO_TRACE_PATH "/doubao_trace.bin"
+#define DOUBAO_TRACE_MAGIC 0x43525444  // "DTRC"
+#define DOUBAO_TRACE_VERSION 1
+#define DOUBAO_TRACE_BUFFER 32         // Records held in RAM between file writes
+#define DOUBAO_REPLAY_LATE_MS 100      // A replayed request starting later than this behind schedule counts as late
+
+// DoubaoTraceRecord::flags
+#define DOUBAO_TRACE_IMAGE 0x01        // Payload carried an image
+#define DOUBAO_TRACE_ERROR 0x02        // Request ended in an error code
+
+/*
+ * Trace file: a DoubaoTraceHeader followed by one fixed-size DoubaoTraceRecord
+ * per request. Records hold sizes, timing and status only: no prompt, answer,
+ * API key or host; the model is kept as a hash of its id. A trace can therefore
+ * leave the device, and doubaoReplayTrace() replays its shape with synthetic
+ * text payloads of the same sizes.
+ */
+struct DoubaoTraceHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+};
+
+struct DoubaoTraceRecord {
+  uint32_t startMs;           // Since the recorder began
+  uint32_t requestBytes;      // Payload
+  uint32_t responseBytes;     // Body, 0 on error
+  uint32_t latencyMs;
+  uint32_t ttfbMs;
+  uint32_t modelHash;         // FNV-1a of the model id
+  uint16_t status;            // HTTP status, 0 if none
+  uint16_t promptTokens;
+  uint16_t completionTokens;
+  uint8_t flags;              // DOUBAO_TRACE_IMAGE, DOUBAO_TRACE_ERROR
+  uint8_t reserved;
+};
+
+/**
+ * Records every sendApiRequest(), and so every getGPTAnswer() and sendHttpRequest()
+ * call, once installed with setTraceRecorder()
+ */
+class DoubaoTraceRecorder {
+public:
+  DoubaoTraceRecorder(const char* path = DOUBAO_TRACE_PATH);
+  ~DoubaoTraceRecorder();
+
+  /**
+   * Start a new trace, replacing an existing file; the filesystem must already be mounted
+   * @param fs Filesystem holding the trace (default: LittleFS)
+   * @return true on success, false otherwise
+   */
+  bool begin(fs::FS& fs = LittleFS);
+
+  /**
+   * Add one request; buffered, written every DOUBAO_TRACE_BUFFER records
+   * @param payload Request payload (only its size, model and image use are kept)
+   * @param response Raw response body or error code
+   * @param meta Status and timing of the request
+   * @param startMs DoubaoClock::now() when the request started
+   */
+  void record(DoubaoStringView payload, const String& response, const DoubaoResponseMeta& meta, unsigned long startMs);
+
+  /**
+   * Write buffered records to the file
+   * @return true on success, false otherwise
+   */
+  bool flush();
+
+  /**
+   * @return Records taken so far
+   */
+  uint32_t count() const;
+
+private:
+  String path_;
+  fs::FS* fs_;
+  unsigned long begunAt_;
+  DoubaoTraceRecord buffer_[DOUBAO_TRACE_BUFFER];
+  int buffered_;
+  uint32_t count_;
+  SemaphoreHandle_t lock_;
+};
+
+// Throughput and latency of a replay
+struct DoubaoReplayReport {
+  uint32_t requests = 0;
+  uint32_t failures = 0;
+  uint32_t late = 0;                 // Started more than DOUBAO_REPLAY_LATE_MS behind schedule
+  uint32_t skipped = 0;              // Image requests, which cannot be replayed
+  unsigned long elapsedMs = 0;
+  uint64_t requestBytes = 0;
+  uint64_t responseBytes = 0;
+  float requestsPerSecond = 0;
+  float bytesPerSecond = 0;          // Request and response bytes
+  unsigned long latencyP50Ms = 0;
+  unsigned long latencyP90Ms = 0;
+  unsigned long latencyP99Ms = 0;
+  unsigned long latencyMaxMs = 0;
+  unsigned long ttfbP50Ms = 0;
+  unsigned long ttfbP99Ms = 0;
+};
+
+/**
+ * Send the requests of a trace again through sendApiRequest(), paced as
+ * recorded. Point sendApiRequest() at a stand-in server with
+ * setEndpointPool() first. Requests go one at a time; when one runs past the
+ * start of the next, the next starts at once and counts as late. Image
+ * requests are skipped: the trace keeps no picture, and a made-up one would
+ * only be rejected.
+ * @param fs Filesystem holding the trace
+ * @param path Trace file
+ * @param apiKey API key sent with the requests
+ * @param modelId Model ID put in the synthetic payloads
+ * @param speed Pace relative to the recording (1 original, 2 twice as fast, 0 back to back)
+ * @param report Output
+ * @return true if the trace was read completely, false otherwise
+ */
+bool doubaoReplayTrace(fs::FS& fs, const char* path, const char* apiKey, const String& modelId, float speed, DoubaoReplayReport* report);
+
+/**
+ * Print a replay report
+ * @param report Report from doubaoReplayTrace()
+ * @param out Output stream (e.g. Serial)
+ */
+void printReplayReport(const DoubaoReplayReport& report, Print& out);
+
+#endif // DOUBAO_TRACE_H
@@ -0,0 +1,410 @@
+#include "doubao_vector_index.h"
+#include <esp_partition.h>
+
+#define KMEANS_ITERATIONS 8
+#define MAX_PROBE_LISTS 32
+
+static uint64_t align4(uint64_t n) {
+  return (n + 3) & ~(uint64_t)3;
+}
+
+// Keep ids/scores sorted best first; returns the new result count
+static int insertTopK(int* ids, float* scores, int count, int k, int id, float score) {
+  if (count == k && score <= scores[k - 1]) {
+    return count;
+  }
+  int pos = count < k ? count++ : k - 1;
+  while (pos > 0 && scores[pos - 1] < score) {
+    ids[pos] = ids[pos - 1];
+    scores[pos] = scores[pos - 1];
+    pos--;
+  }
+  ids[pos] = id;
+  scores[pos] = score;
+  return count;
+}
+
+DoubaoVectorIndex::DoubaoVectorIndex()
+    : header_(nullptr), scales_(nullptr), textOffsets_(nullptr), listOffsets_(nullptr),
+      centroidScales_(nullptr), centroids_(nullptr), vectors_(nullptr), text_(nullptr),
+      mapHandle_(0), mapped_(false) {
+}
+
+DoubaoVectorIndex::~DoubaoVectorIndex() {
+  end();
+}
+
+bool DoubaoVectorIndex::begin(const uint8_t* data, size_t length) {
+  header_ = nullptr;
+  if (data == nullptr || length < sizeof(DoubaoVectorIndexHeader) || ((uintptr_t)data & 3) != 0) {
+    Serial.println("Error: Invalid vector index buffer");
+    return false;
+  }
+  const DoubaoVectorIndexHeader* header = (const DoubaoVectorIndexHeader*)data;
+  if (memcmp(header->magic, DOUBAO_VECTOR_INDEX_MAGIC, 4) != 0 || header->version != DOUBAO_VECTOR_INDEX_VERSION) {
+    Serial.println("Error: Not a vector index or unsupported version");
+    return false;
+  }
+  if (header->dim == 0) {
+    Serial.println("Error: Vector index has no dimensions");
+    return false;
+  }
+  // 64-bit sums, so huge counts in a corrupt header cannot wrap around
+  uint64_t offset = sizeof(DoubaoVectorIndexHeader);
+  uint64_t scalesOffset = offset;
+  offset += (uint64_t)header->count * sizeof(float);
+  uint64_t textOffsetsOffset = offset;
+  offset += ((uint64_t)header->count + 1) * sizeof(uint32_t);
+  uint64_t listOffsetsOffset = offset;
+  offset += ((uint64_t)header->nlist + 1) * sizeof(uint32_t);
+  uint64_t centroidScalesOffset = offset;
+  offset += (uint64_t)header->nlist * sizeof(float);
+  uint64_t centroidsOffset = offset;
+  offset = align4(offset + (uint64_t)header->nlist * header->dim);
+  uint64_t vectorsOffset = offset;
+  offset = align4(offset + (uint64_t)header->count * header->dim);
+  uint64_t textOffset = offset;
+  offset += header->textBytes;
+  if (offset > length) {
+    Serial.println("Error: Truncated vector index");
+    return false;
+  }
+  // Every chunk text and IVF list range must lie inside its section
+  const uint32_t* textOffsets = (const uint32_t*)(data + textOffsetsOffset);
+  for (uint32_t i = 0; i < header->count; i++) {
+    if (textOffsets[i] > textOffsets[i + 1]) {
+      Serial.println("Error: Corrupt vector index text offsets");
+      return false;
+    }
+  }
+  if (textOffsets[header->count] > header->textBytes) {
+    Serial.println("Error: Corrupt vector index text offsets");
+    return false;
+  }
+  const uint32_t* listOffsets = (const uint32_t*)(data + listOffsetsOffset);
+  for (uint32_t c = 0; c < header->nlist; c++) {
+    if (listOffsets[c] > listOffsets[c + 1]) {
+      Serial.println("Error: Corrupt vector index list offsets");
+      return false;
+    }
+  }
+  if (header->nlist > 0 && listOffsets[header->nlist] > header->count) {
+    Serial.println("Error: Corrupt vector index list offsets");
+    return false;
+  }
+  header_ = header;
+  scales_ = (const float*)(data + scalesOffset);
+  textOffsets_ = textOffsets;
+  listOffsets_ = listOffsets;
+  centroidScales_ = (const float*)(data + centroidScalesOffset);
+  centroids_ = (const int8_t*)(data + centroidsOffset);
+  vectors_ = (const int8_t*)(data + vectorsOffset);
+  text_ = (const char*)(data + textOffset);
+  Serial.printf("Vector index: %u chunks, %u dims, %u lists\n", header->count, header->dim, header->nlist);
+  return true;
+}
+
+bool DoubaoVectorIndex::beginPartition(const char* partitionLabel) {
+  end();
+  const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel);
+  if (partition == nullptr) {
+    Serial.printf("Error: Partition %s not found\n", partitionLabel);
+    return false;
+  }
+  const void* data = nullptr;
+  esp_partition_mmap_handle_t handle;
+  if (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &data, &handle) != ESP_OK) {
+    Serial.println("Error: Failed to map vector index partition");
+    return false;
+  }
+  mapHandle_ = handle;
+  mapped_ = true;
+  if (!begin((const uint8_t*)data, partition->size)) {
+    end();
+    return false;
+  }
+  return true;
+}
+
+void DoubaoVectorIndex::end() {
+  if (mapped_) {
+    esp_partition_munmap(mapHandle_);
+    mapped_ = false;
+  }
+  header_ = nullptr;
+}
+
+int DoubaoVectorIndex::size() const {
+  return header_ != nullptr ? header_->count : 0;
+}
+
+int DoubaoVectorIndex::dimensions() const {
+  return header_ != nullptr ? header_->dim : 0;
+}
+
+const char* DoubaoVectorIndex::chunkText(int id, size_t* length) const {
+  if (header_ == nullptr || id < 0 || (uint32_t)id >= header_->count) {
+    *length = 0;
+    return nullptr;
+  }
+  *length = textOffsets_[id + 1] - textOffsets_[id];
+  return text_ + textOffsets_[id];
+}
+
+int DoubaoVectorIndex::search(const float* query, int dim, int k, int* ids, float* scores, int nprobe) const {
+  if (header_ == nullptr || header_->count == 0 || k <= 0) {
+    return 0;
+  }
+  k = min(k, DOUBAO_VECTOR_INDEX_MAX_K);
+  int indexDim = header_->dim;
+  int8_t* q = (int8_t*)malloc(indexDim);
+  if (q == nullptr) {
+    return 0;
+  }
+  memset(q, 0, indexDim);
+  float queryScale = quantizeEmbedding(query, min(dim, indexDim), q);
+  if (queryScale <= 0.0f) {
+    free(q);
+    return 0;
+  }
+  // Pick the lists to scan: all chunks for a flat index, nearest centroids for IVF
+  int lists[MAX_PROBE_LISTS];
+  float listScores[MAX_PROBE_LISTS];
+  int listCount = 0;
+  if (header_->nlist == 0) {
+    lists[0] = -1;
+    listCount = 1;
+  } else {
+    int probe = constrain(nprobe, 1, min((int)header_->nlist, MAX_PROBE_LISTS));
+    for (uint32_t c = 0; c < header_->nlist; c++) {
+      int32_t dot = dotProductInt8(q, centroids_ + (size_t)c * indexDim, indexDim);
+      listCount = insertTopK(lists, listScores, listCount, probe, c, dot / centroidScales_[c]);
+    }
+  }
+  float bestScores[DOUBAO_VECTOR_INDEX_MAX_K];
+  int found = 0;
+  for (int l = 0; l < listCount; l++) {
+    uint32_t first = lists[l] < 0 ? 0 : listOffsets_[lists[l]];
+    uint32_t last = lists[l] < 0 ? header_->count : listOffsets_[lists[l] + 1];
+    for (uint32_t i = first; i < last; i++) {
+      int32_t dot = dotProductInt8(q, vectors_ + (size_t)i * indexDim, indexDim);
+      found = insertTopK(ids, bestScores, found, k, i, dot / (queryScale * scales_[i]));
+    }
+  }
+  free(q);
+  if (scores != nullptr) {
+    memcpy(scores, bestScores, found * sizeof(float));
+  }
+  return found;
+}
+
+static void writePadding(Print& out, size_t written) {
+  static const uint8_t zeros[4] = {0, 0, 0, 0};
+  out.write(zeros, align4(written) - written);
+}
+
+// Float centroids are accumulated from dequantized chunk vectors, then
+// quantized the same way as chunks so assignment uses the int8 kernel.
+static void quantizeCentroids(const float* centroids, int nlist, int dim, int8_t* out, float* scales) {
+  for (int c = 0; c < nlist; c++) {
+    scales[c] = quantizeEmbedding(centroids + (size_t)c * dim, dim, out + (size_t)c * dim);
+    if (scales[c] <= 0.0f) {
+      scales[c] = 1.0f;
+    }
+  }
+}
+
+static void assignLists(const int8_t* vectors, int count, int dim, const int8_t* centroids, const float* centroidScales, int nlist, int* assign) {
+  for (int i = 0; i < count; i++) {
+    int best = 0;
+    float bestScore = -1e30f;
+    for (int c = 0; c < nlist; c++) {
+      float score = dotProductInt8(vectors + (size_t)i * dim, centroids + (size_t)c * dim, dim) / centroidScales[c];
+      if (score > bestScore) {
+        bestScore = score;
+        best = c;
+      }
+    }
+    assign[i] = best;
+  }
+}
+
+static void clusterVectors(const int8_t* vectors, const float* scales, int count, int dim, int nlist, int* assign, int8_t* centroids, float* centroidScales) {
+  float* sums = (float*)calloc((size_t)nlist * dim, sizeof(float));
+  int* members = (int*)calloc(nlist, sizeof(int));
+  if (sums == nullptr || members == nullptr) {
+    // Without scratch memory fall back to evenly spread seed centroids
+    Serial.println("Warning: Not enough memory for clustering, using seed centroids");
+  }
+  for (int c = 0; c < nlist; c++) {
+    memcpy(centroids + (size_t)c * dim, vectors + (size_t)(c * count / nlist) * dim, dim);
+    centroidScales[c] = scales[c * count / nlist];
+  }
+  for (int iter = 0; sums != nullptr && members != nullptr && iter < KMEANS_ITERATIONS; iter++) {
+    assignLists(vectors, count, dim, centroids, centroidScales, nlist, assign);
+    memset(sums, 0, (size_t)nlist * dim * sizeof(float));
+    memset(members, 0, nlist * sizeof(int));
+    for (int i = 0; i < count; i++) {
+      float* sum = sums + (size_t)assign[i] * dim;
+      const int8_t* v = vectors + (size_t)i * dim;
+      for (int d = 0; d < dim; d++) {
+        sum[d] += v[d] / scales[i];
+      }
+      members[assign[i]]++;
+    }
+    for (int c = 0; c < nlist; c++) {
+      if (members[c] == 0) {
+        // Empty list keeps its previous centroid
+        const int8_t* old = centroids + (size_t)c * dim;
+        for (int d = 0; d < dim; d++) {
+          sums[(size_t)c * dim + d] = old[d] / centroidScales[c];
+        }
+      }
+    }
+    quantizeCentroids(sums, nlist, dim, centroids, centroidScales);
+  }
+  assignLists(vectors, count, dim, centroids, centroidScales, nlist, assign);
+  free(sums);
+  free(members);
+}
+
+bool buildVectorIndex(const char* const* snippets, int count, const char* apiKey, const String& embeddingModelId, int dim, int nlist, Print& out) {
+  if (snippets == nullptr || count <= 0 || dim <= 0 || dim > 0xFFFF || nlist < 0) {
+    Serial.println("Error: Invalid vector index parameters");
+    return false;
+  }
+  nlist = min(nlist, count);
+  float* embedding = (float*)malloc(sizeof(float) * dim);
+  int8_t* vectors = (int8_t*)malloc((size_t)count * dim);
+  float* scales = (float*)malloc(sizeof(float) * count);
+  int* assign = (int*)calloc(count, sizeof(int));
+  int* order = (int*)malloc(sizeof(int) * count);
+  uint32_t* listOffsets = (uint32_t*)calloc(nlist + 1, sizeof(uint32_t));
+  int8_t* centroids = (int8_t*)malloc((size_t)max(nlist, 1) * dim);
+  float* centroidScales = (float*)malloc(sizeof(float) * max(nlist, 1));
+  bool ok = embedding != nullptr && vectors != nullptr && scales != nullptr && assign != nullptr &&
+            order != nullptr && listOffsets != nullptr && centroids != nullptr && centroidScales != nullptr;
+  if (!ok) {
+    Serial.println("Error: Not enough memory to build vector index");
+  }
+  for (int i = 0; ok && i < count; i++) {
+    memset(embedding, 0, sizeof(float) * dim);
+    if (getEmbedding(String(snippets[i]), apiKey, embeddingModelId, embedding, dim) == 0) {
+      Serial.printf("Error: Failed to embed chunk %d\n", i);
+      ok = false;
+      break;
+    }
+    scales[i] = quantizeEmbedding(embedding, dim, vectors + (size_t)i * dim);
+    if (scales[i] <= 0.0f) {
+      scales[i] = 1.0f;
+    }
+    Serial.printf("Embedded chunk %d/%d\n", i + 1, count);
+  }
+  if (ok) {
+    if (nlist > 0) {
+      clusterVectors(vectors, scales, count, dim, nlist, assign, centroids, centroidScales);
+      // Counting sort groups chunks by list so each list is one contiguous range
+      for (int i = 0; i < count; i++) {
+        listOffsets[assign[i] + 1]++;
+      }
+      for (int c = 0; c < nlist; c++) {
+        listOffsets[c + 1] += listOffsets[c];
+      }
+      uint32_t* cursor = (uint32_t*)malloc(sizeof(uint32_t) * nlist);
+      ok = cursor != nullptr;
+      if (ok) {
+        memcpy(cursor, listOffsets, sizeof(uint32_t) * nlist);
+        for (int i = 0; i < count; i++) {
+          order[cursor[assign[i]]++] = i;
+        }
+        free(cursor);
+      }
+    } else {
+      for (int i = 0; i < count; i++) {
+        order[i] = i;
+      }
+    }
+  }
+  if (ok) {
+    uint32_t textBytes = 0;
+    for (int i = 0; i < count; i++) {
+      textBytes += strlen(snippets[i]);
+    }
+    DoubaoVectorIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DOUBAO_VECTOR_INDEX_MAGIC, 4);
+    header.version = DOUBAO_VECTOR_INDEX_VERSION;
+    header.dim = dim;
+    header.count = count;
+    header.nlist = nlist;
+    header.textBytes = textBytes;
+    out.write((const uint8_t*)&header, sizeof(header));
+    for (int i = 0; i < count; i++) {
+      out.write((const uint8_t*)&scales[order[i]], sizeof(float));
+    }
+    uint32_t textOffset = 0;
+    for (int i = 0; i < count; i++) {
+      out.write((const uint8_t*)&textOffset, sizeof(uint32_t));
+      textOffset += strlen(snippets[order[i]]);
+    }
+    out.write((const uint8_t*)&textOffset, sizeof(uint32_t));
+    out.write((const uint8_t*)listOffsets, sizeof(uint32_t) * (nlist + 1));
+    out.write((const uint8_t*)centroidScales, sizeof(float) * nlist);
+    out.write((const uint8_t*)centroids, (size_t)nlist * dim);
+    writePadding(out, (size_t)nlist * dim);
+    for (int i = 0; i < count; i++) {
+      out.write((const uint8_t*)(vectors + (size_t)order[i] * dim), dim);
+    }
+    writePadding(out, (size_t)count * dim);
+    for (int i = 0; i < count; i++) {
+      out.write((const uint8_t*)snippets[order[i]], strlen(snippets[order[i]]));
+    }
+    Serial.printf("Vector index written: %d chunks, %d lists\n", count, nlist);
+  }
+  free(embedding);
+  free(vectors);
+  free(scales);
+  free(assign);
+  free(order);
+  free(listOffsets);
+  free(centroids);
+  free(centroidScales);
+  return ok;
+}
+
+String getGPTAnswerRAG(const DoubaoVectorIndex& index, const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, const String& embeddingModelId, int k) {
+  if (!validateConfig(apiKey, modelId, temp)) {
+    return ERROR_INVALID_INPUT;
+  }
+  if (inputText.length() == 0) {
+    Serial.println("Error: Input text is empty");
+    return ERROR_INVALID_INPUT;
+  }
+  int dim = index.dimensions();
+  if (dim == 0) {
+    Serial.println("Error: Vector index not loaded");
+    return ERROR_INVALID_INPUT;
+  }
+  float* embedding = (float*)malloc(sizeof(float) * dim);
+  if (embedding == nullptr) {
+    Serial.println("Error: Not enough memory for embedding");
+    return ERROR_INVALID_INPUT;
+  }
+  int ids[DOUBAO_VECTOR_INDEX_MAX_K];
+  int found = 0;
+  int embeddingDim = getEmbedding(inputText, apiKey, embeddingModelId, embedding, dim);
+  if (embeddingDim > 0) {
+    unsigned long start = micros();
+    found = index.search(embedding, embeddingDim, k, ids);
+    Serial.printf("Retrieved %d chunks in %lu us\n", found, micros() - start);
+  } else {
+    Serial.println("Embedding failed, sending without reference material");
+  }
+  free(embedding);
+  const char* snippets[DOUBAO_VECTOR_INDEX_MAX_K];
+  size_t lengths[DOUBAO_VECTOR_INDEX_MAX_K];
+  for (int i = 0; i < found; i++) {
+    snippets[i] = index.chunkText(ids[i], &lengths[i]);
+  }
+  return getGPTAnswerWithContext(inputText, apiKey, modelId, systemPrompt, temp, snippets, lengths, found);
+}
@@ -0,0 +1,135 @@
+#ifndef DOUBAO_VECTOR_INDEX_H
+#define DOUBAO_VECTOR_INDEX_H
+
+#include <Arduino.h>
+#include "doubao_api.h"
+#include "doubao_embeddings.h"
+
+#define DOUBAO_VECTOR_INDEX_MAGIC "DBVI"
+#define DOUBAO_VECTOR_INDEX_VERSION 1
+#define DOUBAO_VECTOR_INDEX_MAX_K 16
+
+/*
+ * Vector index blob layout (little-endian, every section 4-byte aligned so the
+ * blob can be used in place from a memory-mapped flash partition or a const array):
+ *
+ *   header            32 bytes, DoubaoVectorIndexHeader
+ *   scales            float[count]        quantization scale per chunk
+ *   textOffsets       uint32[count + 1]   chunk text ranges in the text section
+ *   listOffsets       uint32[nlist + 1]   IVF list ranges (chunks are stored grouped by list)
+ *   centroidScales    float[nlist]
+ *   centroids         int8[nlist * dim]
+ *   vectors           int8[count * dim]   normalized, quantized chunk embeddings
+ *   text              char[textBytes]     chunk texts, UTF-8, not NUL-terminated
+ *
+ * nlist == 0 selects a flat (exhaustive) search.
+ */
+struct DoubaoVectorIndexHeader {
+  char magic[4];
+  uint16_t version;
+  uint16_t dim;
+  uint32_t count;
+  uint32_t nlist;
+  uint32_t textBytes;
+  uint32_t reserved[3];
+};
+
+/**
+ * Read-only top-k search over a vector index blob
+ */
+class DoubaoVectorIndex {
+public:
+  DoubaoVectorIndex();
+  ~DoubaoVectorIndex();
+
+  /**
+   * Use an index blob in place (flash, PROGMEM array or RAM)
+   * @param data Blob start, 4-byte aligned
+   * @param length Blob length in bytes
+   * @return true if the blob is a valid index, false otherwise
+   */
+  bool begin(const uint8_t* data, size_t length);
+
+  /**
+   * Memory-map an index stored in a data partition
+   * @param partitionLabel Label of the data partition holding the blob
+   * @return true on success, false otherwise
+   */
+  bool beginPartition(const char* partitionLabel);
+
+  /**
+   * Release a mapped partition
+   */
+  void end();
+
+  /**
+   * Find the chunks most similar to a query embedding
+   * @param query Float query embedding
+   * @param dim Number of dimensions in query
+   * @param k Number of results wanted (max DOUBAO_VECTOR_INDEX_MAX_K)
+   * @param ids Output chunk ids, best first
+   * @param scores Output cosine similarities (optional)
+   * @param nprobe IVF lists to scan, ignored for flat indexes (default: 4)
+   * @return Number of results written
+   */
+  int search(const float* query, int dim, int k, int* ids, float* scores = nullptr, int nprobe = 4) const;
+
+  /**
+   * Get the text of a chunk
+   * @param id Chunk id
+   * @param length Output text length in bytes
+   * @return Pointer into the blob, not NUL-terminated
+   */
+  const char* chunkText(int id, size_t* length) const;
+
+  /**
+   * @return Number of chunks, 0 if no index is loaded
+   */
+  int size() const;
+
+  /**
+   * @return Embedding dimensions of the index
+   */
+  int dimensions() const;
+
+private:
+  const DoubaoVectorIndexHeader* header_;
+  const float* scales_;
+  const uint32_t* textOffsets_;
+  const uint32_t* listOffsets_;
+  const float* centroidScales_;
+  const int8_t* centroids_;
+  const int8_t* vectors_;
+  const char* text_;
+  uint32_t mapHandle_;
+  bool mapped_;
+};
+
+/**
+ * Embed snippets and write a vector index blob
+ * @param snippets Snippet texts
+ * @param count Number of snippets
+ * @param apiKey API key for authentication
+ * @param embeddingModelId Embedding model ID to use
+ * @param dim Dimensions to keep per embedding
+ * @param nlist IVF lists to cluster into, 0 for a flat index
+ * @param out Destination, e.g. a LittleFS file later flashed to a partition
+ * @return true on success, false otherwise
+ */
+bool buildVectorIndex(const char* const* snippets, int count, const char* apiKey, const String& embeddingModelId, int dim, int nlist, Print& out);
+
+/**
+ * Get GPT answer with the top-k relevant index chunks added to the system prompt
+ * @param index Loaded vector index
+ * @param inputText Text message to send
+ * @param apiKey API key for authentication
+ * @param modelId Model ID to use
+ * @param systemPrompt System prompt/role, without the reference material
+ * @param temp Temperature parameter
+ * @param embeddingModelId Embedding model ID used to build the index
+ * @param k Number of chunks to include (default: 3)
+ * @return AI response or error code
+ */
+String getGPTAnswerRAG(const DoubaoVectorIndex& index, const String& inputText, const char* apiKey, const String& modelId, const String& systemPrompt, float temp, const String& embeddingModelId, int k = 3);
+
+#endif // DOUBAO_VECTOR_INDEX_H
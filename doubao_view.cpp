@@ -0,0 +1,118 @@
+#include "doubao_view.h"
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+DoubaoBuffer::DoubaoBuffer() : data_(nullptr), length_(0), capacity_(0) {
+}
+
+DoubaoBuffer::~DoubaoBuffer() {
+  if (data_ != nullptr) {
+    allocator_.deallocate(data_);
+  }
+}
+
+DoubaoBuffer::DoubaoBuffer(DoubaoBuffer&& other) : data_(other.data_), length_(other.length_), capacity_(other.capacity_) {
+  other.data_ = nullptr;
+  other.length_ = 0;
+  other.capacity_ = 0;
+}
+
+DoubaoBuffer& DoubaoBuffer::operator=(DoubaoBuffer&& other) {
+  if (this != &other) {
+    if (data_ != nullptr) {
+      allocator_.deallocate(data_);
+    }
+    data_ = other.data_;
+    length_ = other.length_;
+    capacity_ = other.capacity_;
+    other.data_ = nullptr;
+    other.length_ = 0;
+    other.capacity_ = 0;
+  }
+  return *this;
+}
+
+bool DoubaoBuffer::reserve(size_t capacity) {
+  if (capacity <= capacity_ && data_ != nullptr) {
+    return true;
+  }
+  char* grown = (char*)(data_ == nullptr ? allocator_.allocate(capacity + 1) : allocator_.reallocate(data_, capacity + 1));
+  if (grown == nullptr) {
+    Serial.println("Error: Not enough memory for buffer");
+    return false;
+  }
+  data_ = grown;
+  capacity_ = capacity;
+  data_[length_] = '\0';
+  return true;
+}
+
+// Reallocation only happens when reserve() was too small; doubling keeps it rare
+bool DoubaoBuffer::grow(size_t needed) {
+  if (length_ + needed <= capacity_ && data_ != nullptr) {
+    return true;
+  }
+  size_t capacity = max(length_ + needed, capacity_ * 2);
+  return reserve(max(capacity, (size_t)64));
+}
+
+bool DoubaoBuffer::append(DoubaoStringView text) {
+  if (!grow(text.length)) {
+    return false;
+  }
+  memcpy(data_ + length_, text.data, text.length);
+  length_ += text.length;
+  data_[length_] = '\0';
+  return true;
+}
+
+bool DoubaoBuffer::appendBase64(const uint8_t* bytes, size_t length) {
+  if (!grow(doubaoBase64Length(length))) {
+    return false;
+  }
+  char* out = data_ + length_;
+  size_t i = 0;
+  for (; i + 2 < length; i += 3) {
+    uint32_t n = ((uint32_t)bytes[i] << 16) | ((uint32_t)bytes[i + 1] << 8) | bytes[i + 2];
+    *out++ = base64Alphabet[(n >> 18) & 0x3F];
+    *out++ = base64Alphabet[(n >> 12) & 0x3F];
+    *out++ = base64Alphabet[(n >> 6) & 0x3F];
+    *out++ = base64Alphabet[n & 0x3F];
+  }
+  if (i < length) {
+    uint32_t n = (uint32_t)bytes[i] << 16;
+    if (i + 1 < length) {
+      n |= (uint32_t)bytes[i + 1] << 8;
+    }
+    *out++ = base64Alphabet[(n >> 18) & 0x3F];
+    *out++ = base64Alphabet[(n >> 12) & 0x3F];
+    *out++ = i + 1 < length ? base64Alphabet[(n >> 6) & 0x3F] : '=';
+    *out++ = '=';
+  }
+  length_ = out - data_;
+  data_[length_] = '\0';
+  return true;
+}
+
+void DoubaoBuffer::clear() {
+  length_ = 0;
+  if (data_ != nullptr) {
+    data_[0] = '\0';
+  }
+}
+
+const char* DoubaoBuffer::data() const {
+  return data_ != nullptr ? data_ : "";
+}
+
+size_t DoubaoBuffer::length() const {
+  return length_;
+}
+
+size_t DoubaoBuffer::capacity() const {
+  return capacity_;
+}
+
+DoubaoStringView DoubaoBuffer::view() const {
+  return DoubaoStringView(data(), length_);
+}
@@ -0,0 +1,95 @@
+#ifndef DOUBAO_VIEW_H
+#define DOUBAO_VIEW_H
+
+#include <Arduino.h>
+#include "doubao_policies.h"
+
+/*
+ * Non-owning view of a character range. Built implicitly from a String or a C
+ * string, so functions taking a view accept either without copying. The
+ * viewed text must stay valid until the call returns; a view of a temporary
+ * String is fine as a call argument but must not be stored.
+ */
+struct DoubaoStringView {
+  const char* data;
+  size_t length;
+
+  DoubaoStringView() : data(""), length(0) {
+  }
+  DoubaoStringView(const char* text) : data(text != nullptr ? text : ""), length(text != nullptr ? strlen(text) : 0) {
+  }
+  DoubaoStringView(const char* text, size_t textLength) : data(text), length(textLength) {
+  }
+  DoubaoStringView(const String& text) : data(text.c_str()), length(text.length()) {
+  }
+
+  bool empty() const {
+    return length == 0;
+  }
+};
+
+/**
+ * Base64 encoded size of a byte range
+ * @param length Input bytes
+ * @return Encoded characters, without terminator
+ */
+inline size_t doubaoBase64Length(size_t length) {
+  return (length + 2) / 3 * 4;
+}
+
+/**
+ * Growable, NUL-terminated character buffer with a single owner.
+ * Move-only; memory comes from DoubaoCountingAllocator, so its allocations
+ * show up in doubaoAllocationStats().
+ */
+class DoubaoBuffer {
+public:
+  DoubaoBuffer();
+  ~DoubaoBuffer();
+  DoubaoBuffer(DoubaoBuffer&& other);
+  DoubaoBuffer& operator=(DoubaoBuffer&& other);
+  DoubaoBuffer(const DoubaoBuffer&) = delete;
+  DoubaoBuffer& operator=(const DoubaoBuffer&) = delete;
+
+  /**
+   * Make room for at least capacity characters in one allocation
+   * @param capacity Characters, excluding the terminator
+   * @return true on success, false if out of memory
+   */
+  bool reserve(size_t capacity);
+
+  /**
+   * Append text, growing the buffer if needed
+   * @param text Text to append
+   * @return true on success, false if out of memory
+   */
+  bool append(DoubaoStringView text);
+
+  /**
+   * Append bytes encoded as base64, written straight into the buffer
+   * @param bytes Data to encode
+   * @param length Number of bytes
+   * @return true on success, false if out of memory
+   */
+  bool appendBase64(const uint8_t* bytes, size_t length);
+
+  /**
+   * Empty the buffer, keeping its memory
+   */
+  void clear();
+
+  const char* data() const;
+  size_t length() const;
+  size_t capacity() const;
+  DoubaoStringView view() const;
+
+private:
+  bool grow(size_t needed);
+
+  char* data_;
+  size_t length_;
+  size_t capacity_;
+  DoubaoCountingAllocator<> allocator_;
+};
+
+#endif // DOUBAO_VIEW_H
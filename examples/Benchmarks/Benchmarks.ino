@@ -0,0 +1,400 @@
+/*
+ * Offline micro-benchmarks for the response handling code. No WiFi needed:
+ * everything runs on canned model output. Results are printed to Serial.
+ * Network impairment, timeouts and retry backoff run in virtual time, so they
+ * finish in moments too.
+ * With BENCH_WIFI_SSID defined, TLS peak heap is also measured online.
+ */
+#include <Arduino.h>
+#include <base64.h>
+#include "doubao_api.h"
+#include "doubao_client.h"
+#include "doubao_impair.h"
+#include "doubao_json_path.h"
+
+// Define both to also measure TLS peak heap against the real API host
+// #define BENCH_WIFI_SSID "your-ssid"
+// #define BENCH_WIFI_PASSWORD "your-password"
+#ifdef BENCH_WIFI_SSID
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include "doubao_tls.h"
+#endif
+
+#define ITERATIONS 1000
+
+// Structured answer as returned in message.content
+static const char* sampleOutput =
+    "{\"intent\":\"set_light\",\"room\":\"living room\",\"device\":\"ceiling lamp\","
+    "\"brightness\":70,\"confidence\":0.93,\"reason\":\"The user asked to make the living room "
+    "a bit brighter but not fully on, so the ceiling lamp is set to seventy percent.\"}";
+
+// Full chat completions response body
+static const char* sampleResponse =
+    "{\"id\":\"021718067849573f2b0a8c1a6e4a1c0e5f2d9b8c7a6\",\"object\":\"chat.completion\",\"created\":1718067850,"
+    "\"model\":\"doubao-1-5-pro-32k-250115\",\"service_tier\":\"default\",\"choices\":[{\"index\":0,"
+    "\"message\":{\"role\":\"assistant\",\"content\":\"The picture shows a wooden desk with a laptop, a mug of "
+    "coffee and a small potted plant next to a window. It is daytime and the room is well lit.\"},"
+    "\"logprobs\":{\"content\":[{\"token\":\"The\",\"logprob\":-0.0012,\"top_logprobs\":[]},"
+    "{\"token\":\" picture\",\"logprob\":-0.0391,\"top_logprobs\":[]},{\"token\":\" shows\",\"logprob\":-0.0023,"
+    "\"top_logprobs\":[]}]},\"finish_reason\":\"stop\"}],\"usage\":{\"prompt_tokens\":812,\"completion_tokens\":38,"
+    "\"total_tokens\":850,\"prompt_tokens_details\":{\"cached_tokens\":0},\"completion_tokens_details\":"
+    "{\"reasoning_tokens\":0}}}";
+
+static const char* fields[] = {"intent", "room", "device", "brightness"};
+
+// getChoice() before the JSON path extractor: one 512-byte DOM per call
+static String getChoiceDom(String msg_json, String msg_key) {
+  DynamicJsonDocument doc(512);
+  if (deserializeJson(doc, msg_json.c_str())) {
+    return "JSON syntax error";
+  }
+  return doc.containsKey(msg_key) ? doc[msg_key].as<String>() : "Parsing failed";
+}
+
+static void report(const char* name, unsigned long elapsedUs, uint32_t heapBefore, const String& check) {
+  Serial.printf("%-28s %7.1f us/iteration, heap delta %d, %s\n", name, (float)elapsedUs / ITERATIONS,
+                (int)(heapBefore - ESP.getFreeHeap()), check.c_str());
+}
+
+static void benchmarkFieldExtraction() {
+  String json = sampleOutput;
+  Serial.printf("Field extraction: %u byte document, %d fields\n", json.length(), 4);
+
+  uint32_t heap = ESP.getFreeHeap();
+  unsigned long start = micros();
+  String last;
+  for (int i = 0; i < ITERATIONS; i++) {
+    for (int f = 0; f < 4; f++) {
+      last = getChoiceDom(json, fields[f]);
+    }
+  }
+  report("DOM per field (old getChoice)", micros() - start, heap, last);
+
+  heap = ESP.getFreeHeap();
+  start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    for (int f = 0; f < 4; f++) {
+      last = getChoice(json, fields[f]);
+    }
+  }
+  report("getChoice", micros() - start, heap, last);
+
+  // Paths compiled once, all four fields in a single scan
+  DoubaoJsonExtractor extractor;
+  for (int f = 0; f < 4; f++) {
+    extractor.add((String("/") + fields[f]).c_str());
+  }
+  heap = ESP.getFreeHeap();
+  start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    extractor.extract(json);
+    last = extractor.value(3);
+  }
+  report("DoubaoJsonExtractor", micros() - start, heap, last);
+}
+
+// DoubaoClient::parse() before filtering: the whole body in a fixed 32 KB document
+static String parseFullDocument(const String& response, DoubaoResponseMeta* meta) {
+  DynamicJsonDocument jsonDoc(32768);
+  if (deserializeJson(jsonDoc, response)) {
+    return ERROR_JSON_PARSE;
+  }
+  meta->promptTokens = jsonDoc["usage"]["prompt_tokens"].as<int>();
+  meta->completionTokens = jsonDoc["usage"]["completion_tokens"].as<int>();
+  meta->finishReason = jsonDoc["choices"][0]["finish_reason"].as<String>();
+  return jsonDoc["choices"][0]["message"]["content"].as<String>();
+}
+
+static void benchmarkResponseParsing() {
+  String response = sampleResponse;
+  Serial.printf("Response parsing: %u byte body\n", response.length());
+  DoubaoResponseMeta meta;
+
+  unsigned long start = micros();
+  String content;
+  for (int i = 0; i < ITERATIONS; i++) {
+    content = parseFullDocument(response, &meta);
+  }
+  unsigned long elapsed = micros() - start;
+  DynamicJsonDocument full(32768);
+  deserializeJson(full, response);
+  Serial.printf("%-28s %7.1f us/iteration, document %u bytes (%u used)\n", "Full 32 KB document",
+                (float)elapsed / ITERATIONS, (unsigned)full.capacity(), (unsigned)full.memoryUsage());
+
+  // Same parse as DoubaoDefaultClient, with allocations counted
+  typedef DoubaoClient<DoubaoSharedTransport, DoubaoCountingAllocator<>, DoubaoMillisClock, DoubaoNullLogger> CountingClient;
+  doubaoAllocationStats().reset();
+  start = micros();
+  for (int i = 0; i < ITERATIONS; i++) {
+    content = CountingClient::parse(response, &meta);
+  }
+  elapsed = micros() - start;
+  Serial.printf("%-28s %7.1f us/iteration, document %u bytes, %d tokens, %s\n", "Filtered, sized from body",
+                (float)elapsed / ITERATIONS, (unsigned)doubaoAllocationStats().largest, meta.completionTokens,
+                meta.finishReason.c_str());
+}
+
+// buildPayloadInto() against the String builder: same bytes, one allocation per payload
+static void benchmarkPayloadAllocations() {
+  const size_t sizes[] = {4096, 16384};
+  Serial.println("Image payload allocations:");
+  for (size_t size : sizes) {
+    uint8_t* image = (uint8_t*)malloc(size);
+    if (image == nullptr) {
+      Serial.println("Out of memory");
+      return;
+    }
+    for (size_t i = 0; i < size; i++) {
+      image[i] = (uint8_t)(i * 131 + 7);
+    }
+    doubaoAllocationStats().reset();
+    DoubaoBuffer payload;
+    bool ok = buildPayloadInto(payload, "Describe the picture", "doubao-1-5-pro-32k-250115", "You are a helpful assistant", 0.7,
+                               image, size, "jpg");
+    uint32_t allocations = doubaoAllocationStats().count;
+    String reference = buildPayload("Describe the picture", "doubao-1-5-pro-32k-250115", "You are a helpful assistant", 0.7,
+                                    base64::encode(image, size), "jpg");
+    bool same = ok && payload.length() == reference.length() && memcmp(payload.data(), reference.c_str(), reference.length()) == 0;
+    Serial.printf("%6u byte image: %u allocation(s), %u byte payload, %s\n", (unsigned)size, (unsigned)allocations,
+                  (unsigned)payload.length(), same ? "matches buildPayload()" : "MISMATCH");
+    free(image);
+  }
+}
+
+#define CANNED_ANSWER_BYTES 12000
+
+// Response body with a long answer. Impairment draws its resets and stalls
+// once per KB received, so a short body like sampleResponse would hardly
+// ever meet one.
+static const String& cannedResponse() {
+  static String response;
+  if (response.length() == 0) {
+    String content;
+    content.reserve(CANNED_ANSWER_BYTES + 100);
+    while (content.length() < CANNED_ANSWER_BYTES) {
+      content += "The picture shows a wooden desk with a laptop, a mug of coffee and a small potted plant next to a window. ";
+    }
+    response = "{\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\",\"content\":\"" + content +
+               "\"},\"finish_reason\":\"stop\"}],\"usage\":{\"prompt_tokens\":812,\"completion_tokens\":2600,\"total_tokens\":3412}}";
+  }
+  return response;
+}
+
+// Stand-in server: answers every request with cannedResponse()
+class CannedServer {
+public:
+  int connect(const char* host, uint16_t port) {
+    open_ = true;
+    return 1;
+  }
+  size_t write(const uint8_t* buf, size_t size) {
+    if (!open_) {
+      return 0;
+    }
+    if (pos_ >= response_.length()) {
+      response_ = reply();
+      pos_ = 0;
+    }
+    return size;
+  }
+  int available() {
+    return open_ ? response_.length() - pos_ : 0;
+  }
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  int read(uint8_t* buf, size_t size) {
+    size_t n = min(size, response_.length() - pos_);
+    memcpy(buf, response_.c_str() + pos_, n);
+    pos_ += n;
+    return n;
+  }
+  uint8_t connected() {
+    return open_;
+  }
+  void stop() {
+    open_ = false;
+    response_ = "";
+    pos_ = 0;
+  }
+
+protected:
+  virtual String reply() {
+    return "HTTP/1.1 200 OK\r\nContent-Length: " + String(cannedResponse().length()) + "\r\n\r\n" + cannedResponse();
+  }
+
+private:
+  String response_;
+  size_t pos_ = 0;
+  bool open_ = false;
+};
+
+typedef DoubaoImpairedClient<CannedServer, DoubaoVirtualClock> ImpairedServer;
+typedef DoubaoClient<DoubaoKeepAliveTransport<ImpairedServer, DoubaoVirtualClock, DoubaoNullLogger>, DoubaoHeapAllocator,
+                     DoubaoVirtualClock, DoubaoNullLogger> ImpairedClient;
+
+#define IMPAIRED_REQUESTS 50
+
+static void benchmarkRetryUnderImpairment() {
+  struct Profile {
+    const char* name;
+    DoubaoImpairment impairment;
+  } profiles[] = {
+      {"good WiFi", doubaoImpairmentGoodWifi()},
+      {"busy WiFi", doubaoImpairmentBusyWifi()},
+      {"weak WiFi", doubaoImpairmentWeakWifi()},
+      {"slow-loris server", doubaoImpairmentSlowLoris()},
+  };
+  const int attempts[] = {1, 3};
+  String payload = buildPayload("Describe the picture", "doubao-1-5-pro-32k-250115", "You are a helpful assistant", 0.7);
+  Serial.printf("Retry under impairment: %d requests per row, virtual time\n", IMPAIRED_REQUESTS);
+  for (const Profile& profile : profiles) {
+    for (int maxRetries : attempts) {
+      ImpairedClient client;
+      client.begin("bench-key", "doubao-1-5-pro-32k-250115", "localhost", 80);
+      client.transport().client().setImpairment(profile.impairment);
+      DoubaoVirtualClock::reset();
+      int succeeded = 0;
+      unsigned long worst = 0;
+      for (int i = 0; i < IMPAIRED_REQUESTS; i++) {
+        unsigned long start = DoubaoVirtualClock::now();
+        if (!isErrorResponse(client.chatWithRetry(payload, maxRetries))) {
+          succeeded++;
+        }
+        worst = max(worst, DoubaoVirtualClock::now() - start);
+      }
+      const DoubaoImpairmentStats& stats = client.transport().client().stats();
+      Serial.printf("%-18s %d attempt(s): %2d/%d ok, mean %7lu ms, worst %7lu ms, %u stalls, %u resets\n", profile.name,
+                    maxRetries, succeeded, IMPAIRED_REQUESTS, DoubaoVirtualClock::now() / IMPAIRED_REQUESTS, worst,
+                    (unsigned)stats.stalls, (unsigned)stats.resets);
+    }
+  }
+}
+
+// Stand-in server that accepts every request and never answers
+class SilentServer : public CannedServer {
+protected:
+  String reply() override {
+    return "";
+  }
+};
+
+#define RATE_LIMIT_INTERVAL_MS 2500
+
+// Stand-in server allowing one request per RATE_LIMIT_INTERVAL_MS, HTTP 429 for the rest
+class RateLimitedServer : public CannedServer {
+public:
+  uint32_t rejected() const {
+    return rejected_;
+  }
+
+protected:
+  String reply() override {
+    unsigned long now = DoubaoVirtualClock::now();
+    if (served_ && now - lastServed_ < RATE_LIMIT_INTERVAL_MS) {
+      rejected_++;
+      return "HTTP/1.1 429 Too Many Requests\r\nContent-Length: 2\r\n\r\n{}";
+    }
+    served_ = true;
+    lastServed_ = now;
+    return CannedServer::reply();
+  }
+
+private:
+  unsigned long lastServed_ = 0;
+  bool served_ = false;
+  uint32_t rejected_ = 0;
+};
+
+template <class Server>
+using VirtualClient = DoubaoClient<DoubaoKeepAliveTransport<Server, DoubaoVirtualClock, DoubaoNullLogger>, DoubaoHeapAllocator,
+                                   DoubaoVirtualClock, DoubaoNullLogger>;
+
+#define RATE_LIMITED_REQUESTS 10
+
+// Timeout and retry backoff in virtual time: the numbers are exact, and minutes of waiting take no real time
+static void benchmarkVirtualTime() {
+  String payload = buildPayload("Describe the picture", "doubao-1-5-pro-32k-250115", "You are a helpful assistant", 0.7);
+  Serial.println("Virtual time scenarios:");
+  const int attempts[] = {1, 3};
+  for (int maxRetries : attempts) {
+    VirtualClient<SilentServer> client;
+    client.begin("bench-key", "doubao-1-5-pro-32k-250115", "localhost", 80);
+    DoubaoVirtualClock::reset();
+    String result = client.chatWithRetry(payload, maxRetries);
+    // Every attempt waits out the response timeout; attempt i is followed by an i s backoff
+    unsigned long expected = maxRetries * (unsigned long)DOUBAO_RESPONSE_TIMEOUT_MS + 500UL * maxRetries * (maxRetries - 1);
+    Serial.printf("silent server     %d attempt(s): %-14s after %7lu ms, expected %7lu ms\n", maxRetries, result.c_str(),
+                  DoubaoVirtualClock::now(), expected);
+  }
+  for (int maxRetries : attempts) {
+    VirtualClient<RateLimitedServer> client;
+    client.begin("bench-key", "doubao-1-5-pro-32k-250115", "localhost", 80);
+    DoubaoVirtualClock::reset();
+    int succeeded = 0;
+    for (int i = 0; i < RATE_LIMITED_REQUESTS; i++) {
+      if (!isErrorResponse(client.chatWithRetry(payload, maxRetries))) {
+        succeeded++;
+      }
+    }
+    Serial.printf("rate-limited server %d attempt(s): %2d/%d ok, %2u x HTTP 429, %7lu ms\n", maxRetries, succeeded,
+                  RATE_LIMITED_REQUESTS, (unsigned)client.transport().client().rejected(), DoubaoVirtualClock::now());
+  }
+}
+
+#ifdef BENCH_WIFI_SSID
+#define TLS_REQUESTS 3
+
+// Peak heap of one small request; the key is not valid, so the server answers 401
+template <class ClientT>
+static void reportTlsPeak(const char* name, ClientT& client, const String& payload) {
+  uint32_t worst = 0;
+  for (int i = 0; i < TLS_REQUESTS; i++) {
+    DoubaoResponseMeta meta;
+    sendApiRequestVia(client, DOUBAO_API_HOST, 443, DOUBAO_CHAT_PATH, payload, "bench-key", false, &meta);
+    worst = max(worst, meta.heapFreeBefore - meta.heapMinFree);
+  }
+  Serial.printf("%-34s peak heap %6u bytes\n", name, (unsigned)worst);
+}
+
+static void benchmarkTlsPeakHeap() {
+  WiFi.begin(BENCH_WIFI_SSID, BENCH_WIFI_PASSWORD);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+  }
+  String payload = buildPayload("Hi", "doubao-1-5-pro-32k-250115", "You are a helpful assistant", 0.7);
+  Serial.printf("TLS peak heap per request, worst of %d:\n", TLS_REQUESTS);
+  {
+    WiFiClientSecure before;
+    before.setInsecure();
+    reportTlsPeak("before: WiFiClientSecure", before, payload);
+  }
+  {
+    // A new client for the first request, so it starts with a full handshake
+    DoubaoTlsClient full;
+    DoubaoResponseMeta meta;
+    sendApiRequestVia(full, DOUBAO_API_HOST, 443, DOUBAO_CHAT_PATH, payload, "bench-key", false, &meta);
+    Serial.printf("%-34s peak heap %6u bytes\n", "after: DoubaoTlsClient, handshake", (unsigned)(meta.heapFreeBefore - meta.heapMinFree));
+    reportTlsPeak("after: DoubaoTlsClient, resumed", full, payload);
+  }
+  doubaoTlsConfig().printInfo(Serial);
+}
+#endif
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  benchmarkFieldExtraction();
+  benchmarkResponseParsing();
+  benchmarkPayloadAllocations();
+  benchmarkRetryUnderImpairment();
+  benchmarkVirtualTime();
+#ifdef BENCH_WIFI_SSID
+  benchmarkTlsPeakHeap();
+#endif
+}
+
+void loop() {
+}
@@ -0,0 +1,135 @@
+/*
+ * Concurrency stress test for the shared caches and pools. No WiFi needed.
+ * Several tasks on both cores hammer one DoubaoSemanticCache with exact and
+ * similarity lookups, inserts and clears, and one DoubaoKeyPool with
+ * acquire()/record(). Every hit is checked against the answer that belongs to
+ * its prompt, so a torn or mixed-up entry shows up as a mismatch.
+ */
+#include <Arduino.h>
+#include <atomic>
+#include "doubao_keys.h"
+#include "doubao_semantic_cache.h"
+
+#define STRESS_TASKS 4
+#define STRESS_OPS 5000        // Operations per task
+#define STRESS_PROMPTS 48      // Distinct prompts, more than the cache holds
+#define STRESS_DIM 64
+
+static DoubaoSemanticCache cache(16, STRESS_DIM, 0.92);
+static DoubaoKeyPool keys;
+static uint32_t context;
+
+static std::atomic<uint32_t> exactHits(0);
+static std::atomic<uint32_t> similarHits(0);
+static std::atomic<uint32_t> inserts(0);
+static std::atomic<uint32_t> mismatches(0);
+static std::atomic<uint32_t> acquired(0);
+static std::atomic<int> finished(0);
+
+// Each prompt's vector is near-orthogonal to the others: cosine 0.4 at most
+static void embed(int prompt, float* vector) {
+  for (int i = 0; i < STRESS_DIM; i++) {
+    vector[i] = 0;
+  }
+  vector[prompt % STRESS_DIM] = 1.0f;
+  vector[(prompt + 17) % STRESS_DIM] = 0.5f;
+}
+
+static void stressTask(void* arg) {
+  int id = (int)(intptr_t)arg;
+  uint32_t seed = 0x9e3779b9u * (id + 1);
+  float vector[STRESS_DIM];
+  String answer;
+  String usage = "{\"usage\":{\"total_tokens\":1}}";
+  DoubaoResponseMeta meta;
+  meta.status = 200;
+  for (int op = 0; op < STRESS_OPS; op++) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    int prompt = seed % STRESS_PROMPTS;
+    String text = "prompt " + String(prompt);
+    String expected = "answer " + String(prompt);
+    switch ((seed >> 8) % 8) {
+      case 0:
+      case 1:
+      case 2:
+        if (cache.lookupExact(text, context, answer)) {
+          exactHits++;
+          if (answer != expected) {
+            mismatches++;
+          }
+        }
+        break;
+      case 3:
+      case 4:
+        embed(prompt, vector);
+        if (cache.lookup(vector, STRESS_DIM, context, answer)) {
+          similarHits++;
+          if (answer != expected) {
+            mismatches++;
+          }
+        }
+        break;
+      case 5:
+      case 6:
+        embed(prompt, vector);
+        cache.insert(text, vector, STRESS_DIM, context, expected);
+        inserts++;
+        break;
+      default:
+        // Rare clears race with everything else
+        if (id == 0 && (seed >> 16) % 64 == 0) {
+          cache.clear();
+        }
+        break;
+    }
+    int key = keys.acquire();
+    if (key >= 0) {
+      acquired++;
+      keys.record(key, usage, meta);
+    }
+  }
+  finished++;
+  vTaskDelete(nullptr);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  if (!cache.begin()) {
+    return;
+  }
+  context = DoubaoSemanticCache::contextHash("doubao-1-5-pro-32k-250115", "You are a helpful assistant");
+  keys.add("key-a", 1e9, 1e9);
+  keys.add("key-b", 1e9, 1e9);
+
+  Serial.printf("Concurrency stress: %d tasks x %d operations\n", STRESS_TASKS, STRESS_OPS);
+  unsigned long start = millis();
+  for (int i = 0; i < STRESS_TASKS; i++) {
+    if (xTaskCreatePinnedToCore(stressTask, "stress", 6144, (void*)(intptr_t)i, 1, nullptr, i % 2) != pdPASS) {
+      Serial.println("Error: Cannot start stress task");
+      return;
+    }
+  }
+  while (finished < STRESS_TASKS) {
+    delay(10);
+  }
+  unsigned long elapsed = millis() - start;
+
+  uint32_t charged = 0;
+  uint32_t tokens = 0;
+  for (int i = 0; i < keys.size(); i++) {
+    DoubaoKeyState state = keys.state(i);
+    charged += state.requests;
+    tokens += state.tokens;
+  }
+  bool ok = mismatches == 0 && cache.size() <= 16 && charged == acquired && tokens == acquired;
+  Serial.printf("%lu ms, %u exact hits, %u similar hits, %u inserts, %u wrong answers\n", elapsed,
+                (unsigned)exactHits, (unsigned)similarHits, (unsigned)inserts, (unsigned)mismatches);
+  Serial.printf("Key pool: %u acquired, %u charged, %u tokens recorded\n", (unsigned)acquired, (unsigned)charged, (unsigned)tokens);
+  Serial.println(ok ? "PASS" : "FAIL");
+}
+
+void loop() {
+}
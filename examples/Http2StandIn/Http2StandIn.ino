@@ -0,0 +1,216 @@
+/*
+ * HTTP/2 timeout and cancel check against an in-memory stand-in server. No
+ * WiFi needed: the server is an nghttp2 server session behind a Client, and
+ * DoubaoHttp2Connection talks to it through setClient(). Requests to /stall
+ * are never answered, so request() times out and must reset the stream; the
+ * connection has to stay usable afterwards.
+ *
+ * Build with -DDOUBAO_ENABLE_HTTP2 (see the README).
+ */
+#include <Arduino.h>
+#include "doubao_http2.h"
+
+#ifndef DOUBAO_ENABLE_HTTP2
+#error "Build this example with -DDOUBAO_ENABLE_HTTP2"
+#endif
+
+#define STANDIN_STREAMS 16
+#define STANDIN_TIMEOUT_MS 1000
+
+// Stand-in HTTP/2 server: answers every request except those to /stall
+class StandInServer : public Client {
+public:
+  int connect(IPAddress ip, uint16_t port) override {
+    return connect("", port);
+  }
+  int connect(const char* host, uint16_t port) override {
+    stop();
+    nghttp2_session_callbacks* callbacks;
+    if (nghttp2_session_callbacks_new(&callbacks) != 0) {
+      return 0;
+    }
+    nghttp2_session_callbacks_set_send_callback(callbacks, onSend);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, onHeader);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, onFrame);
+    int rv = nghttp2_session_server_new(&session_, callbacks, this);
+    nghttp2_session_callbacks_del(callbacks);
+    if (rv != 0) {
+      session_ = nullptr;
+      return 0;
+    }
+    nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, nullptr, 0);
+    return 1;
+  }
+  size_t write(uint8_t b) override {
+    return write(&b, 1);
+  }
+  size_t write(const uint8_t* buf, size_t size) override {
+    if (session_ == nullptr || nghttp2_session_mem_recv(session_, buf, size) < 0) {
+      stop();
+      return 0;
+    }
+    nghttp2_session_send(session_);
+    return size;
+  }
+  int available() override {
+    return output_.length() - pos_;
+  }
+  int read() override {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+  }
+  int read(uint8_t* buf, size_t size) override {
+    size_t n = min(size, (size_t)(output_.length() - pos_));
+    memcpy(buf, output_.c_str() + pos_, n);
+    pos_ += n;
+    if (pos_ == output_.length()) {
+      output_ = "";
+      pos_ = 0;
+    }
+    return n;
+  }
+  int peek() override {
+    return available() > 0 ? (uint8_t)output_[pos_] : -1;
+  }
+  void stop() override {
+    if (session_ != nullptr) {
+      nghttp2_session_del(session_);
+      session_ = nullptr;
+    }
+    output_ = "";
+    pos_ = 0;
+  }
+  uint8_t connected() override {
+    return session_ != nullptr;
+  }
+  operator bool() override {
+    return connected();
+  }
+
+  uint32_t cancels() const {
+    return cancels_;
+  }
+  uint32_t answered() const {
+    return answered_;
+  }
+
+private:
+  struct Response {
+    String path;
+    String body;
+    size_t sent;
+  };
+
+  Response& response(int32_t streamId) {
+    return responses_[(streamId / 2) % STANDIN_STREAMS];
+  }
+
+  static ssize_t onSend(nghttp2_session* session, const uint8_t* data, size_t length, int flags, void* userData) {
+    StandInServer* self = (StandInServer*)userData;
+    self->output_.concat((const char*)data, length);
+    return length;
+  }
+
+  static int onHeader(nghttp2_session* session, const nghttp2_frame* frame, const uint8_t* name, size_t nameLength,
+                      const uint8_t* value, size_t valueLength, uint8_t flags, void* userData) {
+    StandInServer* self = (StandInServer*)userData;
+    if (frame->hd.type == NGHTTP2_HEADERS && nameLength == 5 && memcmp(name, ":path", 5) == 0) {
+      self->response(frame->hd.stream_id).path = String((const char*)value);
+    }
+    return 0;
+  }
+
+  static ssize_t onReadBody(nghttp2_session* session, int32_t streamId, uint8_t* buf, size_t length, uint32_t* dataFlags,
+                            nghttp2_data_source* source, void* userData) {
+    Response* r = (Response*)source->ptr;
+    size_t n = min(length, r->body.length() - r->sent);
+    memcpy(buf, r->body.c_str() + r->sent, n);
+    r->sent += n;
+    if (r->sent == r->body.length()) {
+      *dataFlags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    return n;
+  }
+
+  static int onFrame(nghttp2_session* session, const nghttp2_frame* frame, void* userData) {
+    StandInServer* self = (StandInServer*)userData;
+    if (frame->hd.type == NGHTTP2_RST_STREAM && frame->rst_stream.error_code == NGHTTP2_CANCEL) {
+      self->cancels_++;
+      return 0;
+    }
+    bool requestDone = (frame->hd.type == NGHTTP2_HEADERS || frame->hd.type == NGHTTP2_DATA) &&
+                       (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) != 0;
+    if (!requestDone) {
+      return 0;
+    }
+    Response& r = self->response(frame->hd.stream_id);
+    if (r.path == "/stall") {
+      return 0;
+    }
+    r.body = "{\"stream\":" + String(frame->hd.stream_id) + "}";
+    r.sent = 0;
+    nghttp2_nv status = {(uint8_t*)":status", (uint8_t*)"200", 7, 3, NGHTTP2_NV_FLAG_NONE};
+    nghttp2_data_provider provider;
+    provider.source.ptr = &r;
+    provider.read_callback = onReadBody;
+    nghttp2_submit_response(session, frame->hd.stream_id, &status, 1, &provider);
+    self->answered_++;
+    return 0;
+  }
+
+  nghttp2_session* session_ = nullptr;
+  String output_;
+  size_t pos_ = 0;
+  Response responses_[STANDIN_STREAMS];
+  uint32_t cancels_ = 0;
+  uint32_t answered_ = 0;
+};
+
+static StandInServer server;
+static DoubaoHttp2Connection connection("standin.local", 80);
+static int callbacks;
+
+static void countCallback(const String& result, const DoubaoResponseMeta& meta, void* context) {
+  callbacks++;
+}
+
+static bool check(const char* name, bool ok) {
+  Serial.printf("%-44s %s\n", name, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+  connection.setClient(server);
+  bool ok = true;
+
+  String answer = connection.request("/ok", "{}", "standin-key");
+  ok &= check("request answered", answer.startsWith("{\"stream\":"));
+
+  unsigned long start = millis();
+  answer = connection.request("/stall", "{}", "standin-key", nullptr, STANDIN_TIMEOUT_MS);
+  unsigned long elapsed = millis() - start;
+  ok &= check("unanswered request times out", answer == ERROR_TIMEOUT && elapsed >= STANDIN_TIMEOUT_MS);
+  connection.poll(100);
+  ok &= check("timed-out stream reset with CANCEL", server.cancels() == 1);
+  ok &= check("timed-out stream freed", connection.pending() == 0);
+
+  // The timed-out request's stack frame is gone; its stream must not call back into it
+  answer = connection.request("/ok", "{}", "standin-key");
+  ok &= check("connection usable after the timeout", answer.startsWith("{\"stream\":"));
+
+  int id = connection.submit("/stall", "{}", "standin-key", countCallback);
+  ok &= check("cancel() finds the stream", id > 0 && connection.cancel(id));
+  ok &= check("cancel() of a finished stream fails", !connection.cancel(id));
+  connection.poll(100);
+  connection.close();
+  ok &= check("cancelled stream never calls back", callbacks == 0);
+  ok &= check("cancelled stream reset with CANCEL", server.cancels() == 2);
+
+  Serial.printf("%u requests answered, %u streams cancelled\n", (unsigned)server.answered(), (unsigned)server.cancels());
+  Serial.println(ok ? "PASS" : "FAIL");
+}
+
+void loop() {
+}
@@ -0,0 +1,199 @@
+// Host-side builder for DoubaoBM25Index blobs (see doubao_bm25.h for the layout).
+//
+// Build:
+//   g++ -std=c++11 -O2 -I.. bm25_index_builder.cpp ../doubao_bm25.cpp -o bm25_index_builder
+//
+// Usage:
+//   bm25_index_builder <documents.txt> <index.bin> [query ...]
+//
+// Documents are separated by blank lines. Any queries given after the output
+// path are run against the freshly written index to report query latency.
+// Flash the result to a data partition and open it with beginPartition().
+
+#ifndef ARDUINO
+
+#include "doubao_bm25.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define BENCH_ITERATIONS 1000
+
+struct Posting {
+  uint32_t doc;
+  uint32_t tf;
+};
+
+static void countTerm(uint32_t hash, void* context) {
+  (*(std::unordered_map<uint32_t, uint32_t>*)context)[hash]++;
+}
+
+static void writeVarint(std::string& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back((char)((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back((char)value);
+}
+
+static void pad4(std::string& out) {
+  while (out.size() % 4 != 0) {
+    out.push_back('\0');
+  }
+}
+
+template <typename T>
+static void append(std::string& out, const T& value) {
+  out.append((const char*)&value, sizeof(T));
+}
+
+static std::vector<std::string> readDocuments(const char* path) {
+  std::ifstream in(path);
+  std::vector<std::string> docs;
+  std::string line;
+  std::string current;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.find_first_not_of(" \t") == std::string::npos) {
+      if (!current.empty()) {
+        docs.push_back(current);
+        current.clear();
+      }
+      continue;
+    }
+    if (!current.empty()) {
+      current += "\n";
+    }
+    current += line;
+  }
+  if (!current.empty()) {
+    docs.push_back(current);
+  }
+  return docs;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::fprintf(stderr, "usage: %s <documents.txt> <index.bin> [query ...]\n", argv[0]);
+    return 1;
+  }
+  std::vector<std::string> docs = readDocuments(argv[1]);
+  if (docs.empty()) {
+    std::fprintf(stderr, "error: no documents in %s\n", argv[1]);
+    return 1;
+  }
+
+  // Ordered by hash so the on-device engine can binary search the term table
+  std::map<uint32_t, std::vector<Posting> > postings;
+  std::vector<uint16_t> docLengths;
+  uint64_t totalLength = 0;
+  for (size_t d = 0; d < docs.size(); d++) {
+    std::unordered_map<uint32_t, uint32_t> tf;
+    size_t terms = bm25Tokenize(docs[d].data(), docs[d].size(), countTerm, &tf);
+    docLengths.push_back((uint16_t)(terms > 0xFFFF ? 0xFFFF : terms));
+    totalLength += terms;
+    for (std::unordered_map<uint32_t, uint32_t>::const_iterator it = tf.begin(); it != tf.end(); ++it) {
+      Posting p = {(uint32_t)d, it->second};
+      postings[it->first].push_back(p);
+    }
+  }
+
+  std::string postingBytes;
+  std::vector<DoubaoBM25Term> terms;
+  for (std::map<uint32_t, std::vector<Posting> >::const_iterator it = postings.begin(); it != postings.end(); ++it) {
+    DoubaoBM25Term term = {it->first, (uint32_t)postingBytes.size(), (uint32_t)it->second.size()};
+    terms.push_back(term);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < it->second.size(); i++) {
+      writeVarint(postingBytes, it->second[i].doc - previous);
+      writeVarint(postingBytes, it->second[i].tf);
+      previous = it->second[i].doc;
+    }
+  }
+
+  std::string text;
+  std::vector<uint32_t> textOffsets;
+  for (size_t d = 0; d < docs.size(); d++) {
+    textOffsets.push_back((uint32_t)text.size());
+    text += docs[d];
+  }
+  textOffsets.push_back((uint32_t)text.size());
+
+  DoubaoBM25Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, DOUBAO_BM25_MAGIC, 4);
+  header.version = DOUBAO_BM25_VERSION;
+  header.docCount = (uint32_t)docs.size();
+  header.termCount = (uint32_t)terms.size();
+  header.avgDocLength = (float)totalLength / docs.size();
+  header.postingsBytes = (uint32_t)postingBytes.size();
+  header.textBytes = (uint32_t)text.size();
+
+  std::string blob;
+  append(blob, header);
+  for (size_t i = 0; i < terms.size(); i++) {
+    append(blob, terms[i]);
+  }
+  for (size_t i = 0; i < textOffsets.size(); i++) {
+    append(blob, textOffsets[i]);
+  }
+  for (size_t i = 0; i < docLengths.size(); i++) {
+    append(blob, docLengths[i]);
+  }
+  pad4(blob);
+  blob += postingBytes;
+  pad4(blob);
+  blob += text;
+
+  std::ofstream out(argv[2], std::ios::binary);
+  out.write(blob.data(), blob.size());
+  if (!out) {
+    std::fprintf(stderr, "error: failed to write %s\n", argv[2]);
+    return 1;
+  }
+  out.close();
+
+  std::printf("documents: %u, terms: %u, avg length: %.1f\n", header.docCount, header.termCount, header.avgDocLength);
+  std::printf("index size: %u bytes (terms %u, postings %u, text %u, other %u)\n", (unsigned)blob.size(),
+              (unsigned)(terms.size() * sizeof(DoubaoBM25Term)), header.postingsBytes, header.textBytes,
+              (unsigned)(blob.size() - terms.size() * sizeof(DoubaoBM25Term) - header.postingsBytes - header.textBytes));
+
+  if (argc > 3) {
+    std::vector<uint32_t> aligned((blob.size() + 3) / 4);
+    std::memcpy(aligned.data(), blob.data(), blob.size());
+    DoubaoBM25Index index;
+    if (!index.begin((const uint8_t*)aligned.data(), blob.size())) {
+      std::fprintf(stderr, "error: failed to load the written index\n");
+      return 1;
+    }
+    for (int q = 3; q < argc; q++) {
+      int ids[3];
+      float scores[3];
+      int found = 0;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        found = index.search(argv[q], std::strlen(argv[q]), 3, ids, scores);
+      }
+      double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / BENCH_ITERATIONS;
+      std::printf("query \"%s\": %.2f us, %d hits\n", argv[q], us, found);
+      for (int i = 0; i < found; i++) {
+        size_t length = 0;
+        const char* doc = index.docText(ids[i], &length);
+        std::printf("  %.3f  %.*s\n", scores[i], (int)(length > 60 ? 60 : length), doc);
+      }
+    }
+  }
+  return 0;
+}
+
+#endif // ARDUINO